@@ -27,6 +27,7 @@
 #include "code_generator.hpp"
 #include "function_internal.hpp"
 #include <casadi_runtime_str.h>
+#include <cctype>
 #include <iomanip>
 
 using namespace std;
@@ -53,6 +54,12 @@ namespace casadi {
     bool prefix_set = false;
     this->prefix = "";
     avoid_stack_ = false;
+    this->split_size = 0;
+    this->split_files = 0;
+    this->loop_rolling = false;
+    this->with_batch = false;
+    this->blas = false;
+    this->sparse_unroll = 0;
     indent_ = 2;
 
     // Read options
@@ -94,6 +101,21 @@ namespace casadi {
         casadi_assert_dev(indent_>=0);
       } else if (e.first=="avoid_stack") {
         avoid_stack_ = e.second;
+      } else if (e.first=="split_size") {
+        this->split_size = e.second;
+        casadi_assert_dev(this->split_size>=0);
+      } else if (e.first=="loop_rolling") {
+        this->loop_rolling = e.second;
+      } else if (e.first=="with_batch") {
+        this->with_batch = e.second;
+      } else if (e.first=="blas") {
+        this->blas = e.second;
+      } else if (e.first=="sparse_unroll") {
+        this->sparse_unroll = e.second;
+        casadi_assert_dev(this->sparse_unroll>=0);
+      } else if (e.first=="split_files") {
+        this->split_files = e.second;
+        casadi_assert_dev(this->split_files>=0);
       } else if (e.first=="prefix") {
         this->prefix = e.second.to_string();
         prefix_set = true;
@@ -124,6 +146,10 @@ namespace casadi {
     // Start off without the need for thread-local memory
     needs_mem_ = false;
 
+    // No split functions yet
+    split_body_.resize(1+this->split_files);
+    n_split_ = 0;
+
     // Divide name into base and suffix (if any)
     string::size_type dotpos = name.rfind('.');
     if (dotpos==string::npos) {
@@ -292,6 +318,26 @@ namespace casadi {
     return fname;
   }
 
+  string CodeGenerator::add_batch_dependency(const Function& f) {
+    // Quick return if it already exists
+    for (auto&& e : added_batch_functions_) if (e.f==f) return e.codegen_name;
+
+    // Give it a name
+    casadi_assert(f->has_codegen_batch(),
+      "No batched code generation for " + f.class_name() + " '" + f.name() + "'");
+    string fname = shorthand("b" + str(added_batch_functions_.size()));
+
+    // Add to list of functions
+    added_batch_functions_.push_back({f, fname});
+
+    // Generate declarations
+    f->codegen_declarations(*this);
+
+    // Print to file
+    f->codegen_batch(*this, fname);
+    return fname;
+  }
+
     void CodeGenerator::add(const Function& f, bool with_jac_sparsity) {
     // Add if not already added
     string codegen_name = add_dependency(f);
@@ -301,6 +347,26 @@ namespace casadi {
           << "return " << codegen_name <<  "(arg, res, iw, w, mem);\n"
           << "}\n\n";
 
+    // Define the batched variant
+    if (this->with_batch && f->has_codegen_batch()) {
+      string batch_name = add_batch_dependency(f);
+      *this << declare(f->signature_batch(f.name() + "_batch")) << "{\n"
+            << "return " << batch_name <<  "(arg, res, iw, w, mem, n);\n"
+            << "}\n\n";
+
+      // Work vector lengths of the batched variant
+      *this << declare(
+          "int " + f.name() + "_work_batch(casadi_int *sz_arg, casadi_int* sz_res, "
+          "casadi_int *sz_iw, casadi_int *sz_w)")
+        << " {\n"
+        << "if (sz_arg) *sz_arg = " << f.sz_arg() << ";\n"
+        << "if (sz_res) *sz_res = " << f.sz_res() << ";\n"
+        << "if (sz_iw) *sz_iw = " << f.sz_iw() << ";\n"
+        << "if (sz_w) *sz_w = " << f->sz_w_batch() << ";\n"
+        << "return 0;\n"
+        << "}\n\n";
+    }
+
     // Generate meta information
     f->codegen_meta(*this);
 
@@ -420,9 +486,35 @@ namespace casadi {
     // Main entry point
     if (this->main) generate_main(s);
 
+    // Additional source files, named by a suffix to the main file name
+    std::vector<std::string> split_suffixes;
+    for (casadi_int k=1; k<split_body_.size(); ++k) {
+      if (split_body_[k].empty()) continue;
+      split_suffixes.push_back("_s" + str(k-1) + this->suffix);
+    }
+
+    // List them such that importers can compile and link them
+    if (!split_suffixes.empty()) {
+      s << "/*CASADIMETA\n:source_suffixes";
+      for (auto&& f : split_suffixes) s << " " << f;
+      s << "\n*/\n";
+    }
+
     // Finalize file
     file_close(s);
 
+    // Write the additional source files
+    split_sources_.clear();
+    for (casadi_int k=1; k<split_body_.size(); ++k) {
+      if (split_body_[k].empty()) continue;
+      split_sources_.push_back(prefix + this->name + "_s" + str(k-1) + this->suffix);
+      ofstream sk;
+      file_open(sk, split_sources_.back());
+      dump_preamble(sk, k);
+      sk << split_body_[k];
+      file_close(sk);
+    }
+
     // Generate header
     if (this->with_header) {
       // Create a header file
@@ -541,10 +633,7 @@ namespace casadi {
     return "casadi_ri" + str(size);
   }
 
-  void CodeGenerator::dump(std::ostream& s) {
-    // Consistency check
-    casadi_assert_dev(current_indent_ == 0);
-
+  void CodeGenerator::dump_preamble(std::ostream& s, casadi_int k) {
     // Prefix internal symbols to avoid symbol collisions
     s << "/* How to prefix internal symbols */\n"
       << "#ifdef CASADI_CODEGEN_PREFIX\n"
@@ -555,6 +644,12 @@ namespace casadi {
       << "  #define CASADI_PREFIX(ID) " << this->prefix << "_ ## ID\n"
       << "#endif\n\n";
 
+    // Symbols private to an additional source file
+    if (k>0) {
+      s << "/* How to prefix symbols local to this file */\n"
+        << "#define CASADI_LOCAL_PREFIX(ID) CASADI_PREFIX(s" << (k-1) << "_ ## ID)\n\n";
+    }
+
     s << this->includes.str();
     s << endl;
 
@@ -581,7 +676,9 @@ namespace casadi {
     if (!added_shorthands_.empty()) {
       s << "/* Add prefix to internal symbols */\n";
       for (auto&& i : added_shorthands_) {
-        s << "#define " << "casadi_" << i <<  " CASADI_PREFIX(" << i <<  ")\n";
+        bool local = k>0 && !split_names_.count(i);
+        s << "#define " << "casadi_" << i << (local ? " CASADI_LOCAL_PREFIX(" : " CASADI_PREFIX(")
+          << i <<  ")\n";
       }
       s << endl;
     }
@@ -598,6 +695,14 @@ namespace casadi {
 
     // Codegen auxiliary functions
     s << this->auxiliaries.str();
+  }
+
+  void CodeGenerator::dump(std::ostream& s) {
+    // Consistency check
+    casadi_assert_dev(current_indent_ == 0);
+
+    // Everything up to and including auxiliary functions
+    dump_preamble(s);
 
     // Print integer constants
     if (!integer_constants_.empty()) {
@@ -642,6 +747,10 @@ namespace casadi {
       s << endl << endl;
     }
 
+    // Split functions, defined here or declared
+    s << split_decl_;
+    s << split_body_.front();
+
     // Codegen body
     s << this->body.str();
 
@@ -760,6 +869,15 @@ namespace casadi {
     }
   }
 
+  string CodeGenerator::
+  operator()(const Function& f, const string& arg,
+             const string& res, const string& iw,
+             const string& w, const string& n) {
+    std::string name = add_batch_dependency(f);
+    return name + "(" + arg + ", " + res + ", "
+            + iw + ", " + w + ", 0, " + n + ")";
+  }
+
   void CodeGenerator::add_external(const string& new_external) {
     added_externals_.insert(new_external);
   }
@@ -975,6 +1093,9 @@ namespace casadi {
     case AUX_MTIMES:
       this->auxiliaries << sanitize_source(casadi_mtimes_str, inst);
       break;
+    case AUX_MTIMES_DENSE:
+      this->auxiliaries << sanitize_source(casadi_mtimes_dense_str, inst);
+      break;
     case AUX_PROJECT:
       this->auxiliaries << sanitize_source(casadi_project_str, inst);
       break;
@@ -1063,6 +1184,31 @@ namespace casadi {
     case AUX_LDL:
       this->auxiliaries << sanitize_source(casadi_ldl_str, inst);
       break;
+    case AUX_LDL_SN:
+      if (this->blas) {
+        // Dense supernode updates with BLAS
+        casadi_assert(casadi_real_type=="double", "BLAS requires casadi_real double");
+        shorthand("ldl_sn_gemm");
+        this->auxiliaries
+          << "void dgemm_(const char* transa, const char* transb, const int* m, "
+          << "const int* n, const int* k, const double* alpha, const double* a, "
+          << "const int* lda, const double* b, const int* ldb, const double* beta, "
+          << "double* c, const int* ldc);\n\n"
+          << "void casadi_ldl_sn_gemm(casadi_int m, casadi_int n, casadi_int k, "
+          << "const casadi_real* x, casadi_int ldx, const casadi_real* y, casadi_int ldy, "
+          << "casadi_real* z, casadi_int ldz) {\n"
+          << "  const char tx='N', ty='T';\n"
+          << "  const int m1=m, n1=n, k1=k, ldx1=ldx, ldy1=ldy, ldz1=ldz;\n"
+          << "  const double alpha=-1, beta=1;\n"
+          << "  if (m==0 || n==0 || k==0) return;\n"
+          << "  dgemm_(&tx, &ty, &m1, &n1, &k1, &alpha, x, &ldx1, y, &ldy1, &beta, "
+          << "z, &ldz1);\n"
+          << "}\n\n";
+      } else {
+        this->auxiliaries << sanitize_source(casadi_ldl_sn_gemm_str, inst);
+      }
+      this->auxiliaries << sanitize_source(casadi_ldl_sn_str, inst);
+      break;
     case AUX_NEWTON:
       add_auxiliary(AUX_COPY);
       add_auxiliary(AUX_AXPY);
@@ -1401,9 +1547,20 @@ namespace casadi {
   string CodeGenerator::trans(const string& x, const Sparsity& sp_x,
                                    const string& y, const Sparsity& sp_y,
                                    const string& iw) {
+    if (this->sparse_unroll>0 && sp_x.nnz()<=this->sparse_unroll) {
+      // Nonzero mapping resolved here
+      std::vector<casadi_int> mapping;
+      sp_x.transpose(mapping);
+      stringstream s;
+      for (casadi_int k=0; k<mapping.size(); ++k) {
+        if (k>0) s << "\n";
+        s << elem(y, k) << " = " << elem(x, mapping[k]) << ";";
+      }
+      return s.str();
+    }
     add_auxiliary(CodeGenerator::AUX_TRANS);
     return "casadi_trans(" + x + "," + sparsity(sp_x) + ", "
-            + y + ", " + sparsity(sp_y) + ", " + iw + ")";
+            + y + ", " + sparsity(sp_y) + ", " + iw + ");";
   }
 
   string CodeGenerator::declare(string s) {
@@ -1426,6 +1583,29 @@ namespace casadi {
     // If sparsity match, simple copy
     if (sp_arg==sp_res) return copy(arg, sp_arg.nnz(), res);
 
+    // Pattern-specialized
+    if (this->sparse_unroll>0 && sp_res.nnz()<=this->sparse_unroll) {
+      const casadi_int *colind_arg = sp_arg.colind(), *row_arg = sp_arg.row();
+      const casadi_int *colind_res = sp_res.colind(), *row_res = sp_res.row();
+      std::vector<casadi_int> ind(sp_arg.size1(), -1);
+      stringstream s;
+      for (casadi_int i=0; i<sp_res.size2(); ++i) {
+        for (casadi_int el=colind_arg[i]; el<colind_arg[i+1]; ++el) ind[row_arg[el]] = el;
+        for (casadi_int el=colind_res[i]; el<colind_res[i+1]; ++el) {
+          if (el>0) s << "\n";
+          s << elem(res, el) << " = ";
+          casadi_int k = ind[row_res[el]];
+          if (k<0) {
+            s << "0;";
+          } else {
+            s << elem(arg, k) << ";";
+          }
+        }
+        for (casadi_int el=colind_arg[i]; el<colind_arg[i+1]; ++el) ind[row_arg[el]] = -1;
+      }
+      return s.str();
+    }
+
     // Create call
     add_auxiliary(AUX_PROJECT);
     stringstream s;
@@ -1513,6 +1693,19 @@ namespace casadi {
 
   string CodeGenerator::mv(const string& x, const Sparsity& sp_x,
                                 const string& y, const string& z, bool tr) {
+    if (this->sparse_unroll>0 && sp_x.nnz()<=this->sparse_unroll) {
+      // One sum of products per entry of z, in the order of the runtime routine
+      const casadi_int *colind_x = sp_x.colind(), *row_x = sp_x.row();
+      std::vector<std::vector<casadi_int> > terms(tr ? sp_x.size2() : sp_x.size1());
+      for (casadi_int i=0; i<sp_x.size2(); ++i) {
+        for (casadi_int el=colind_x[i]; el<colind_x[i+1]; ++el) {
+          std::vector<casadi_int>& t = terms[tr ? i : row_x[el]];
+          t.push_back(el);
+          t.push_back(tr ? row_x[el] : i);
+        }
+      }
+      return sum_products(x, y, z, terms);
+    }
     add_auxiliary(AUX_MV);
     return "casadi_mv(" + x + ", " + sparsity(sp_x) + ", " + y + ", "
            + z + ", " +  (tr ? "1" : "0") + ");";
@@ -1529,11 +1722,114 @@ namespace casadi {
                                     const string& y, const Sparsity& sp_y,
                                     const string& z, const Sparsity& sp_z,
                                     const string& w, bool tr) {
+    // Number of multiplications
+    casadi_int n_mul = 0;
+    if (this->sparse_unroll>0) {
+      const casadi_int *colind_x = sp_x.colind(), *row_y = sp_y.row();
+      for (casadi_int kk=0; kk<sp_y.nnz(); ++kk) {
+        // Upper bound for tr
+        n_mul += tr ? sp_x.size2() : colind_x[row_y[kk]+1]-colind_x[row_y[kk]];
+      }
+    }
+    if (this->sparse_unroll>0 && n_mul<=this->sparse_unroll) {
+      // One sum of products per nonzero of z, in the order of the runtime routine
+      const casadi_int *colind_x = sp_x.colind(), *row_x = sp_x.row();
+      const casadi_int *colind_y = sp_y.colind(), *row_y = sp_y.row();
+      const casadi_int *colind_z = sp_z.colind(), *row_z = sp_z.row();
+      std::vector<std::vector<casadi_int> > terms(sp_z.nnz());
+      std::vector<casadi_int> ind(tr ? sp_y.size1() : sp_z.size1(), -1);
+      for (casadi_int cc=0; cc<sp_z.size2(); ++cc) {
+        if (tr) {
+          // Nonzeros of the column of y
+          for (casadi_int kk=colind_y[cc]; kk<colind_y[cc+1]; ++kk) ind[row_y[kk]] = kk;
+          for (casadi_int kk=colind_z[cc]; kk<colind_z[cc+1]; ++kk) {
+            casadi_int rr = row_z[kk];
+            for (casadi_int kk1=colind_x[rr]; kk1<colind_x[rr+1]; ++kk1) {
+              casadi_int k = ind[row_x[kk1]];
+              if (k<0) continue;
+              terms[kk].push_back(kk1);
+              terms[kk].push_back(k);
+            }
+          }
+          for (casadi_int kk=colind_y[cc]; kk<colind_y[cc+1]; ++kk) ind[row_y[kk]] = -1;
+        } else {
+          // Nonzeros of the column of z
+          for (casadi_int kk=colind_z[cc]; kk<colind_z[cc+1]; ++kk) ind[row_z[kk]] = kk;
+          for (casadi_int kk=colind_y[cc]; kk<colind_y[cc+1]; ++kk) {
+            casadi_int rr = row_y[kk];
+            for (casadi_int kk1=colind_x[rr]; kk1<colind_x[rr+1]; ++kk1) {
+              casadi_int k = ind[row_x[kk1]];
+              if (k<0) continue;
+              terms[k].push_back(kk1);
+              terms[k].push_back(kk);
+            }
+          }
+          for (casadi_int kk=colind_z[cc]; kk<colind_z[cc+1]; ++kk) ind[row_z[kk]] = -1;
+        }
+      }
+      return sum_products(x, y, z, terms);
+    }
     add_auxiliary(AUX_MTIMES);
     return "casadi_mtimes(" + x + ", " + sparsity(sp_x) + ", " + y + ", " + sparsity(sp_y) + ", "
       + z + ", " + sparsity(sp_z) + ", " + w + ", " +  (tr ? "1" : "0") + ");";
   }
 
+  string CodeGenerator::mtimes(const string& x, casadi_int nrow_x, casadi_int ncol_x,
+                               const string& y, casadi_int ncol_y, const string& z) {
+    add_auxiliary(AUX_MTIMES_DENSE);
+    return "casadi_mtimes_dense(" + x + ", " + str(nrow_x) + ", " + str(ncol_x) + ", "
+      + y + ", " + str(ncol_y) + ", " + z + ");";
+  }
+
+  string CodeGenerator::gemm(const string& x, casadi_int nrow_x, casadi_int ncol_x,
+                             const string& y, casadi_int ncol_y, const string& z) {
+    casadi_assert(casadi_real_type=="double", "BLAS requires casadi_real double");
+    add_external("void dgemm_(const char* transa, const char* transb, const int* m, "
+                 "const int* n, const int* k, const double* alpha, const double* a, "
+                 "const int* lda, const double* b, const int* ldb, const double* beta, "
+                 "double* c, const int* ldc);");
+    stringstream s;
+    s << "{const char tr='N'; const int m=" << nrow_x << ", k=" << ncol_x << ", n=" << ncol_y
+      << "; const double one=1; dgemm_(&tr, &tr, &m, &n, &k, &one, " << x << ", &m, "
+      << y << ", &k, &one, " << z << ", &m);}";
+    return s.str();
+  }
+
+  string CodeGenerator::elem(const string& p, casadi_int i) {
+    // Parenthesize unless an identifier, a member or (&wN)
+    bool simple = p.front()=='(' && p.back()==')' && p.find(')')==p.size()-1;
+    if (!simple) {
+      simple = true;
+      for (char c : p) {
+        if (!(isalnum(c) || c=='_' || c=='.')) {
+          simple = false;
+          break;
+        }
+      }
+    }
+    if (simple) return p + "[" + str(i) + "]";
+    return "(" + p + ")[" + str(i) + "]";
+  }
+
+  string CodeGenerator::sum_products(const string& x, const string& y, const string& z,
+                                     const std::vector<std::vector<casadi_int> >& terms) {
+    // Left to right, as the runtime routines accumulate
+    stringstream s;
+    bool first = true;
+    for (casadi_int k=0; k<terms.size(); ++k) {
+      const std::vector<casadi_int>& t = terms[k];
+      if (t.empty()) continue;
+      if (!first) s << "\n";
+      first = false;
+      s << elem(z, k) << " = " << elem(z, k);
+      for (casadi_int i=0; i<t.size(); i+=2) {
+        s << "+" << elem(x, t[i]) << "*" << elem(y, t[i+1]);
+      }
+      s << ";";
+    }
+    return s.str();
+  }
+
   void CodeGenerator::print_formatted(const string& s) {
     // Quick return if empty
     if (s.empty()) return;
@@ -1613,6 +1909,23 @@ namespace casadi {
     }
   }
 
+  std::string CodeGenerator::add_split(const std::string& name, const std::string& body) {
+    std::string fname = shorthand(name);
+    split_names_.insert(name);
+    std::string sig = "void " + fname + "(const casadi_real** arg, casadi_real** res, "
+                      "casadi_real* w)";
+    // Distribute over the additional files, if any
+    casadi_int k = this->split_files==0 ? 0 : 1 + n_split_ % this->split_files;
+    n_split_++;
+    if (k==0) {
+      split_body_[k] += "static " + sig + " {\n" + body + "}\n\n";
+    } else {
+      split_decl_ += sig + ";\n";
+      split_body_[k] += sig + " {\n" + body + "}\n\n";
+    }
+    return fname;
+  }
+
   void CodeGenerator::init_local(const string& name, const string& def) {
     bool inserted = local_default_.insert(make_pair(name, def)).second;
     casadi_assert(inserted, name + " already defined");
@@ -1770,6 +2083,18 @@ namespace casadi {
            + beta + ", " + prinv + ", " + pc + ", " + w + ");";
   }
 
+  string CodeGenerator::
+  qr_solve_panel(const string& x, casadi_int nrhs, bool tr,
+                 const string& sp_v, const string& v,
+                 const string& sp_r, const string& r,
+                 const string& beta, const string& prinv,
+                 const string& pc, const string& w) {
+    add_auxiliary(CodeGenerator::AUX_QR);
+    return "casadi_qr_solve_panel(" + x + ", " + str(nrhs) + ", " + (tr ? "1" : "0") + ", "
+           + sp_v + ", " + v + ", " + sp_r + ", " + r + ", "
+           + beta + ", " + prinv + ", " + pc + ", " + w + ");";
+  }
+
   string CodeGenerator::
   lsqr_solve(const std::string& A, const std::string&x,
              casadi_int nrhs, bool tr, const std::string& sp, const std::string& w) {
@@ -1796,6 +2121,42 @@ namespace casadi {
            + lt + ", " + d + ", " + p + ", " + w + ");";
   }
 
+  std::string CodeGenerator::
+  ldl_solve_panel(const std::string& x, casadi_int nrhs,
+    const std::string& sp_lt, const std::string& lt, const std::string& d,
+    const std::string& p, const std::string& w) {
+    add_auxiliary(CodeGenerator::AUX_LDL);
+    return "casadi_ldl_solve_panel(" + x + ", " + str(nrhs) + ", " + sp_lt + ", "
+           + lt + ", " + d + ", " + p + ", " + w + ");";
+  }
+
+  std::string CodeGenerator::
+  ldl_sn(const std::string& sp_a, const std::string& a,
+         const std::string& sn, const std::string& l, const std::string& d,
+         const std::string& p, const std::string& iw, const std::string& w) {
+    add_auxiliary(CodeGenerator::AUX_LDL_SN);
+    return "casadi_ldl_sn(" + sp_a + ", " + a + ", " + sn + ", " + l + ", "
+           + d + ", " + p + ", " + iw + ", " + w + ");";
+  }
+
+  std::string CodeGenerator::
+  ldl_sn_solve(const std::string& x, casadi_int nrhs,
+               const std::string& sn, const std::string& l, const std::string& d,
+               const std::string& p, const std::string& w) {
+    add_auxiliary(CodeGenerator::AUX_LDL_SN);
+    return "casadi_ldl_sn_solve(" + x + ", " + str(nrhs) + ", " + sn + ", "
+           + l + ", " + d + ", " + p + ", " + w + ");";
+  }
+
+  std::string CodeGenerator::
+  ldl_sn_solve_panel(const std::string& x, casadi_int nrhs,
+                     const std::string& sn, const std::string& l, const std::string& d,
+                     const std::string& p, const std::string& w) {
+    add_auxiliary(CodeGenerator::AUX_LDL_SN);
+    return "casadi_ldl_sn_solve_panel(" + x + ", " + str(nrhs) + ", " + sn + ", "
+           + l + ", " + d + ", " + p + ", " + w + ");";
+  }
+
   std::string CodeGenerator::
   fmax(const std::string& x, const std::string& y) {
     add_auxiliary(CodeGenerator::AUX_FMAX);
@@ -68,6 +68,9 @@ namespace casadi {
     /// Add a function dependency
     std::string add_dependency(const Function& f);
 
+    /// Add the batched variant of a function dependency, cf. FunctionInternal::eval_batch
+    std::string add_batch_dependency(const Function& f);
+
     /// Add an external function declaration
     void add_external(const std::string& new_external);
 
@@ -118,6 +121,11 @@ namespace casadi {
                            const std::string& res, const std::string& iw,
                            const std::string& w);
 
+    /** \brief Generate a call to the batched variant of a function for n points */
+    std::string operator()(const Function& f, const std::string& arg,
+                           const std::string& res, const std::string& iw,
+                           const std::string& w, const std::string& n);
+
     /** \brief Print a string to buffer  */
     CodeGenerator& operator<<(const std::string& s);
 
@@ -157,7 +165,16 @@ namespace casadi {
     void unindent() {current_indent_--;}
 
     /** \brief Avoid stack? */
-    bool avoid_stack() { return avoid_stack_;}
+    bool avoid_stack() const { return avoid_stack_;}
+
+    /** \brief Add a function split off from a large function body
+     *
+     * The function has the signature
+     * void name(const casadi_real** arg, casadi_real** res, casadi_real* w)
+     * and is defined in the main source file or, if split_files>0, in one of the
+     * additional source files written by generate(). Returns the function name.
+     */
+    std::string add_split(const std::string& name, const std::string& body);
 
     /** \brief Print a constant in a lossless but compact manner */
     std::string constant(double v);
@@ -196,6 +213,14 @@ namespace casadi {
                        const std::string& z, const Sparsity& sp_z,
                        const std::string& w, bool tr);
 
+    /** \brief Codegen dense matrix-matrix multiplication */
+    std::string mtimes(const std::string& x, casadi_int nrow_x, casadi_int ncol_x,
+                       const std::string& y, casadi_int ncol_y, const std::string& z);
+
+    /** \brief Codegen dense matrix-matrix multiplication with BLAS: z += x*y */
+    std::string gemm(const std::string& x, casadi_int nrow_x, casadi_int ncol_x,
+                     const std::string& y, casadi_int ncol_y, const std::string& z);
+
     /** \brief Codegen bilinear form */
     std::string bilin(const std::string& A, const Sparsity& sp_A,
                       const std::string& x, const std::string& y);
@@ -237,6 +262,13 @@ namespace casadi {
                          const std::string& beta, const std::string& prinv,
                          const std::string& pc, const std::string& w);
 
+    /** \brief QR solve, right-hand-sides in panels of four */
+    std::string qr_solve_panel(const std::string& x, casadi_int nrhs, bool tr,
+                               const std::string& sp_v, const std::string& v,
+                               const std::string& sp_r, const std::string& r,
+                               const std::string& beta, const std::string& prinv,
+                               const std::string& pc, const std::string& w);
+
     /** \\brief LSQR solve */
     std::string lsqr_solve(const std::string& A, const std::string&x,
                           casadi_int nrhs, bool tr, const std::string& sp, const std::string& w);
@@ -253,6 +285,30 @@ namespace casadi {
                          const std::string& d, const std::string& p,
                          const std::string& w);
 
+    /** \brief LDL solve, right-hand-sides in panels of four */
+    std::string ldl_solve_panel(const std::string& x, casadi_int nrhs,
+                                const std::string& sp_lt, const std::string& lt,
+                                const std::string& d, const std::string& p,
+                                const std::string& w);
+
+    /** \brief Supernodal LDL factorization */
+    std::string ldl_sn(const std::string& sp_a, const std::string& a,
+                       const std::string& sn, const std::string& l,
+                       const std::string& d, const std::string& p,
+                       const std::string& iw, const std::string& w);
+
+    /** \brief Supernodal LDL solve */
+    std::string ldl_sn_solve(const std::string& x, casadi_int nrhs,
+                             const std::string& sn, const std::string& l,
+                             const std::string& d, const std::string& p,
+                             const std::string& w);
+
+    /** \brief Supernodal LDL solve, right-hand-sides in panels of four */
+    std::string ldl_sn_solve_panel(const std::string& x, casadi_int nrhs,
+                                   const std::string& sn, const std::string& l,
+                                   const std::string& d, const std::string& p,
+                                   const std::string& w);
+
     /** \brief fmax */
     std::string fmax(const std::string& x, const std::string& y);
 
@@ -327,6 +383,7 @@ namespace casadi {
       AUX_MV,
       AUX_MV_DENSE,
       AUX_MTIMES,
+      AUX_MTIMES_DENSE,
       AUX_PROJECT,
       AUX_TRI_PROJECT,
       AUX_DENSIFY,
@@ -348,6 +405,7 @@ namespace casadi {
       AUX_NLP,
       AUX_SQPMETHOD,
       AUX_LDL,
+      AUX_LDL_SN,
       AUX_NEWTON,
       AUX_TO_DOUBLE,
       AUX_TO_INT,
@@ -485,9 +543,25 @@ namespace casadi {
     // Generate export symbol macros
     void generate_export_symbol(std::ostream &s) const;
 
+    /* Generate everything up to and including the auxiliary functions
+     * For an additional source file (k>0), internal symbols other than the split functions
+     * get a file-specific prefix such that the files can be linked together
+     */
+    void dump_preamble(std::ostream& s, casadi_int k=0);
+
     // Generate import symbol macros
     void generate_import_symbol(std::ostream &s) const;
 
+    // Nonzero i of an array given by a pointer expression
+    static std::string elem(const std::string& p, casadi_int i);
+
+    /* Pattern-specialized z <- z + sum of products, one statement per nonzero of z,
+     * with the terms as index pairs into x and y, cf. sparse_unroll
+     */
+    static std::string sum_products(const std::string& x, const std::string& y,
+                                    const std::string& z,
+                                    const std::vector<std::vector<casadi_int> >& terms);
+
     //  private:
   public:
     /// \cond INTERNAL
@@ -530,6 +604,45 @@ namespace casadi {
 
     std::string infinity, nan, real_min;
 
+    /** \brief Split large functions
+     * Maximum number of elementary operations per generated function,
+     * larger function bodies are split into several functions. 0: no splitting
+     */
+    casadi_int split_size;
+
+    /** \brief Number of additional source files
+     * Split functions are distributed over this many additional source files,
+     * which can be compiled in parallel. 0: keep them in the main file
+     */
+    casadi_int split_files;
+
+    /** \brief Roll loops
+     * Emit repeated blocks of SX operations, that only differ in their work vector,
+     * input and output indices, as loops over index tables
+     */
+    bool loop_rolling;
+
+    /** \brief Batched variants
+     * Generate a variant fname_batch(arg, res, iw, w, mem, n) evaluating n points,
+     * laid out as for Map, with inner loops over a block of points that the
+     * C compiler can vectorize. Used by serial maps.
+     */
+    bool with_batch;
+
+    /** \brief Pattern-specialized sparse kernels
+     * Sparse products, transposes and projections with at most this many
+     * nonzero operations are emitted as straight-line code with the sparsity
+     * pattern resolved at code generation time, instead of calling the runtime
+     * routines with the pattern as an integer array. 0: always call the runtime
+     */
+    casadi_int sparse_unroll;
+
+    /** \brief BLAS
+     * Call dgemm for large dense matrix products.
+     * The generated code must then be linked against BLAS.
+     */
+    bool blas;
+
     /** \brief Codegen scalar
      * Use the work vector for storing work vector elements of length 1
      * (typically scalar) instead of using local variables
@@ -586,6 +699,9 @@ namespace casadi {
     };
     std::vector<FunctionMeta> added_functions_;
 
+    // Added batched variants of functions
+    std::vector<FunctionMeta> added_batch_functions_;
+
     // Constants
     std::vector<std::vector<double> > double_constants_;
     std::vector<std::vector<casadi_int> > integer_constants_;
@@ -593,6 +709,21 @@ namespace casadi {
     // Does any function need thread-local memory?
     bool needs_mem_;
 
+    // Definitions of split functions, for the main file and each additional file
+    std::vector<std::string> split_body_;
+
+    // Declarations of split functions defined in additional files
+    std::string split_decl_;
+
+    // Number of split functions
+    casadi_int n_split_;
+
+    // Shorthands of split functions
+    std::set<std::string> split_names_;
+
+    // Additional source files created by generate()
+    std::vector<std::string> split_sources_;
+
     // Hash a vector
     static size_t hash(const std::vector<double>& v);
     static size_t hash(const std::vector<casadi_int>& v);
@@ -36,8 +36,73 @@
 #include <unordered_map>
 #define CACHING_MAP std::unordered_map
 
+#ifdef CASADI_WITH_THREAD
+#ifdef CASADI_WITH_THREAD_MINGW
+#include <mingw.mutex.h>
+#else // CASADI_WITH_THREAD_MINGW
+#include <mutex>
+#endif // CASADI_WITH_THREAD_MINGW
+#endif // CASADI_WITH_THREAD
+
 namespace casadi {
 
+/** \brief Cache of the constant nodes currently allocated, safe for concurrent use
+
+  The nodes are distributed over n_shard hash maps by the hash of their value,
+  each protected by its own mutex, so that threads creating different
+  constants rarely contend. The cache does not own the nodes: a node removes
+  itself on destruction.
+*/
+template<typename Value, typename Node>
+class ConstantCache {
+  public:
+    /// Get the node for a value, creating it if needed. The caller receives one reference.
+    Node* acquire(Value value) {
+      Shard& s = shard(value);
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(s.mtx);
+#endif // CASADI_WITH_THREAD
+      typename CACHING_MAP<Value, Node*>::iterator it = s.map.find(value);
+      if (it!=s.map.end()) {
+        // Reuse, unless it is already being destroyed by another thread
+        if (it->second->count_up_if_alive()) return it->second;
+        it->second = new Node(value);
+        it->second->count++;
+        return it->second;
+      }
+      Node* n = new Node(value);
+      n->count++;
+      s.map.insert(it, std::make_pair(value, n));
+      return n;
+    }
+
+    /// Remove a node that is being destroyed
+    void release(Value value, const Node* n) {
+      Shard& s = shard(value);
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(s.mtx);
+#endif // CASADI_WITH_THREAD
+      typename CACHING_MAP<Value, Node*>::iterator it = s.map.find(value);
+      // The entry may already refer to a replacement
+      if (it!=s.map.end() && it->second==n) s.map.erase(it);
+    }
+
+    /// Number of shards
+    static const size_t n_shard = 64;
+
+  private:
+    struct Shard {
+#ifdef CASADI_WITH_THREAD
+      std::mutex mtx;
+#endif // CASADI_WITH_THREAD
+      CACHING_MAP<Value, Node*> map;
+    };
+    Shard& shard(Value value) {
+      return shards_[(std::hash<Value>()(value)*0x9E3779B97F4A7C15ull >> 32) % n_shard];
+    }
+    Shard shards_[n_shard];
+};
+
 /** \brief Represents a constant SX
   \author Joel Andersson
   \date 2010
@@ -84,6 +149,7 @@ std::string print(const std::string& arg1, const std::string& arg2) const overri
   \date 2010
 */
 class RealtypeSX : public ConstantSX {
+  friend class ConstantCache<double, RealtypeSX>;
   private:
     /// Constructor is private, use "create" below
     explicit RealtypeSX(double value) : value(value) {}
@@ -92,29 +158,15 @@ class RealtypeSX : public ConstantSX {
 
     /// Destructor
     ~RealtypeSX() override {
-      size_t num_erased = cached_constants_.erase(value);
-      assert(num_erased==1);
-      (void)num_erased;
+      cached_constants().release(value, this);
     }
 
-    /// Static creator function (use instead of constructor)
-    inline static RealtypeSX* create(double value) {
-      // Try to find the constant
-      CACHING_MAP<double, RealtypeSX*>::iterator it = cached_constants_.find(value);
-
-      // If not found, add it,
-      if (it==cached_constants_.end()) {
-        // Allocate a new object
-        RealtypeSX* n = new RealtypeSX(value);
-
-        // Add to hash_table
-        cached_constants_.insert(it, std::make_pair(value, n));
+    /** \brief Static creator function (use instead of constructor)
 
-        // Return it to caller
-        return n;
-      } else { // Else, returned the object
-        return it->second;
-      }
+        The returned node has already been counted for the caller.
+    */
+    inline static RealtypeSX* create(double value) {
+      return cached_constants().acquire(value);
     }
 
     ///@{
@@ -132,8 +184,8 @@ class RealtypeSX : public ConstantSX {
 
   protected:
     /** \brief Hash map of all constants currently allocated
-     * (storage is allocated for it in sx_element.cpp) */
-    static CACHING_MAP<double, RealtypeSX*> cached_constants_;
+     * (storage is allocated for it in sx_elem.cpp) */
+    static ConstantCache<double, RealtypeSX>& cached_constants();
 
     /** \brief  Data members */
     double value;
@@ -145,6 +197,7 @@ class RealtypeSX : public ConstantSX {
   \date 2010
 */
 class IntegerSX : public ConstantSX {
+  friend class ConstantCache<casadi_int, IntegerSX>;
   private:
     /// Constructor is private, use "create" below
     explicit IntegerSX(casadi_int value) : value(static_cast<int>(value)) {
@@ -156,29 +209,15 @@ class IntegerSX : public ConstantSX {
 
     /// Destructor
     ~IntegerSX() override {
-      size_t num_erased = cached_constants_.erase(value);
-      assert(num_erased==1);
-      (void)num_erased;
+      cached_constants().release(value, this);
     }
 
-    /// Static creator function (use instead of constructor)
-    inline static IntegerSX* create(casadi_int value) {
-      // Try to find the constant
-      CACHING_MAP<casadi_int, IntegerSX*>::iterator it = cached_constants_.find(value);
-
-      // If not found, add it,
-      if (it==cached_constants_.end()) {
-        // Allocate a new object
-        IntegerSX* n = new IntegerSX(value);
-
-        // Add to hash_table
-        cached_constants_.insert(it, std::make_pair(value, n));
+    /** \brief Static creator function (use instead of constructor)
 
-        // Return it to caller
-        return n;
-      } else { // Else, returned the object
-        return it->second;
-      }
+        The returned node has already been counted for the caller.
+    */
+    inline static IntegerSX* create(casadi_int value) {
+      return cached_constants().acquire(value);
     }
 
     ///@{
@@ -198,8 +237,8 @@ class IntegerSX : public ConstantSX {
   protected:
 
     /** \brief Hash map of all constants currently allocated
-     * (storage is allocated for it in sx_element.cpp) */
-    static CACHING_MAP<casadi_int, IntegerSX*> cached_constants_;
+     * (storage is allocated for it in sx_elem.cpp) */
+    static ConstantCache<casadi_int, IntegerSX>& cached_constants();
 
     /** \brief  Data members */
     int value;
@@ -392,27 +431,26 @@ public:
 
 };
 
-inline SXNode* ConstantSX_deserialize(DeserializingStream& s) {
+inline SXElem ConstantSX_deserialize(DeserializingStream& s) {
   char type;
   s.unpack("ConstantSX::type", type);
   switch (type) {
-    case '1': return casadi_limits<SXElem>::one.get();
-    case '0': return casadi_limits<SXElem>::zero.get();
+    case '1': return casadi_limits<SXElem>::one;
+    case '0': return casadi_limits<SXElem>::zero;
     case 'r': {
       double value;
       s.unpack("ConstantSX::value", value);
-      return RealtypeSX::create(value);
+      return SXElem(value);
     }
     case 'i': {
       int value;
       s.unpack("ConstantSX::value", value);
-      if (value==2) return casadi_limits<SXElem>::two.get();
-      return IntegerSX::create(value);
+      return SXElem(static_cast<double>(value));
     }
-    case 'n': return casadi_limits<SXElem>::nan.get();
-    case 'f': return casadi_limits<SXElem>::minus_inf.get();
-    case 'F': return casadi_limits<SXElem>::inf.get();
-    case 'm': return casadi_limits<SXElem>::minus_one.get();
+    case 'n': return casadi_limits<SXElem>::nan;
+    case 'f': return casadi_limits<SXElem>::minus_inf;
+    case 'F': return casadi_limits<SXElem>::inf;
+    case 'm': return casadi_limits<SXElem>::minus_one;
     default: casadi_error("ConstantSX::deserialize error");
   }
 }
@@ -394,20 +394,16 @@ namespace casadi {
 
   template<typename D>
   void Function::call_gen(vector<const D*> arg, vector<D*> res) const {
-    // Input buffer
     casadi_assert_dev(arg.size()>=n_in());
-    arg.resize(sz_arg());
-
-    // Output buffer
     casadi_assert_dev(res.size()>=n_out());
-    res.resize(sz_res());
 
     // Work vectors
-    vector<casadi_int> iw(sz_iw());
-    vector<D> w(sz_w());
+    CallBuffer<D> buf(*get());
+    copy_n(arg.begin(), min(arg.size(), sz_arg()), buf.arg);
+    copy_n(res.begin(), min(res.size(), sz_res()), buf.res);
 
     // Evaluate memoryless
-    (*this)(get_ptr(arg), get_ptr(res), get_ptr(iw), get_ptr(w), 0);
+    (*this)(buf.arg, buf.res, buf.iw, buf.w, 0);
   }
 
 
@@ -579,6 +575,14 @@ namespace casadi {
   Function Function::map(const string& name, const std::string& parallelization, casadi_int n,
       const vector<casadi_int>& reduce_in, const vector<casadi_int>& reduce_out,
         const Dict& opts) const {
+    // Parallel evaluation with private accumulators
+    if (parallelization=="thread" || parallelization=="openmp") {
+      vector<bool> reduce_in_bool(n_in(), false), reduce_out_bool(n_out(), false);
+      for (casadi_int i : reduce_in) reduce_in_bool.at(i) = true;
+      for (casadi_int i : reduce_out) reduce_out_bool.at(i) = true;
+      return MapSum::create(name, parallelization, *this, n,
+                            reduce_in_bool, reduce_out_bool, opts);
+    }
     // Wrap in an MXFunction
     Function f = map(n, parallelization);
     // Start with the fully mapped inputs
@@ -615,6 +619,11 @@ namespace casadi {
     // No need for logic when we are not saturating the limit
     if (n<=max_num_threads) return map(n, parallelization);
 
+    // Thread pool handles the limit by itself
+    if (parallelization=="thread") {
+      return map(n, parallelization, Dict{{"max_workers", max_num_threads}});
+    }
+
     // Floored division
     casadi_int d = n/max_num_threads;
     if (d*max_num_threads==n) {
@@ -677,6 +686,19 @@ namespace casadi {
     }
   }
 
+  Function
+  Function::map(casadi_int n, const std::string& parallelization, const Dict& opts) const {
+    // Make sure not degenerate
+    casadi_assert(n>0, "Degenerate map operation");
+    // Options only apply to the Map classes
+    if (opts.empty()) return map(n, parallelization);
+    try {
+      return (*this)->map(n, parallelization, opts);
+    } catch (exception& e) {
+      THROW_ERROR("map", e.what());
+    }
+  }
+
   Function Function::
   slice(const std::string& name, const std::vector<casadi_int>& order_in,
         const std::vector<casadi_int>& order_out, const Dict& opts) const {
@@ -1303,6 +1325,8 @@ namespace casadi {
 
   void Function::call(const DMDict& arg, DMDict& res,
                       bool always_inline, bool never_inline) const {
+    // Without converting the arguments, if possible
+    if (!never_inline && (*this)->call_direct(arg, res)) return;
     return call_gen(arg, res, always_inline, never_inline);
   }
 
@@ -1699,14 +1723,13 @@ namespace casadi {
     iw_.resize(f_.sz_iw());
     arg_.resize(f_.sz_arg());
     res_.resize(f_.sz_res());
-    mem_ = f_->checkout();
-    mem_internal_ = f.memory(mem_);
     f_node_ = f.operator->();
+    checkout();
   }
 
   FunctionBuffer::~FunctionBuffer() {
-    if (f_->release_) {
-      f_->release_(mem_);
+    if (eval_) {
+      if (release_) release_(mem_);
     } else {
       f_.release(mem_);
     }
@@ -1720,14 +1743,22 @@ namespace casadi {
     f_ = f.f_;
     w_ = f.w_; iw_ = f.iw_; arg_ = f.arg_; res_ = f.res_; f_node_ = f.f_node_;
     // Checkout fresh memory
-    if (f_->checkout_) {
-      mem_ = f_->checkout_();
+    checkout();
+    return *this;
+  }
+
+  void FunctionBuffer::checkout() {
+    // Stick to the code being used now, even if compiled code is swapped in later
+    eval_ = f_node_->eval_.load(std::memory_order_acquire);
+    if (eval_) {
+      release_ = f_node_->release_;
+      mem_ = f_node_->checkout_ ? f_node_->checkout_() : 0;
+      mem_internal_ = nullptr;
     } else {
-      mem_ = f_.checkout();
+      release_ = nullptr;
+      mem_ = f_->checkout();
       mem_internal_ = f_.memory(mem_);
     }
-
-    return *this;
   }
 
   void FunctionBuffer::set_arg(casadi_int i, const double* a, casadi_int size) {
@@ -1743,8 +1774,8 @@ namespace casadi {
     res_.at(i) = a;
   }
   void FunctionBuffer::_eval() {
-    if (f_node_->eval_) {
-      ret_ = f_node_->eval_(get_ptr(arg_), get_ptr(res_), get_ptr(iw_), get_ptr(w_), mem_);
+    if (eval_) {
+      ret_ = eval_(get_ptr(arg_), get_ptr(res_), get_ptr(iw_), get_ptr(w_), mem_);
     } else {
       ret_ = f_node_->eval(get_ptr(arg_), get_ptr(res_), get_ptr(iw_), get_ptr(w_), mem_internal_);
     }
@@ -592,11 +592,13 @@ namespace casadi {
                 s_(N-1) <- f(a_(N-1), p_(N-1))
         \endverbatim
 
-        \param parallelization Type of parallelization used: unroll|serial|openmp
+        \param parallelization Type of parallelization used: unroll|serial|openmp|thread
     */
     Function map(casadi_int n, const std::string& parallelization="serial") const;
     Function map(casadi_int n, const std::string& parallelization,
       casadi_int max_num_threads) const;
+    Function map(casadi_int n, const std::string& parallelization,
+      const Dict& opts) const;
 
     ///@{
     /** \brief Map with reduction
@@ -1035,9 +1037,12 @@ class CASADI_EXPORT FunctionBuffer {
   std::vector<const double*> arg_;
   std::vector<double*> res_;
   FunctionInternal* f_node_;
+  eval_t eval_;
+  casadi_release_t release_;
   casadi_int mem_;
   void *mem_internal_;
   int ret_;
+  void checkout();
 public:
   /** \brief Main constructor */
   FunctionBuffer(const Function& f);
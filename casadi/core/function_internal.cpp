@@ -41,8 +41,12 @@
 #include "conic_impl.hpp"
 #include "integrator_impl.hpp"
 #include "external_impl.hpp"
+#include "importer_internal.hpp"
+#include "thread_pool.hpp"
 
 #include <cctype>
+#include <chrono>
+#include <memory>
 #include <typeinfo>
 #ifdef WITH_DL
 #include <cstdlib>
@@ -59,6 +63,9 @@ namespace casadi {
     verbose_ = false;
     print_time_ = false;
     record_time_ = false;
+    for (auto&& b : mem_) b = nullptr;
+    n_mem_ = 0;
+    unused_ = 0;
   }
 
   FunctionInternal::FunctionInternal(const std::string& name) : ProtoFunction(name) {
@@ -85,6 +92,12 @@ namespace casadi {
     jit_cleanup_ = true;
     jit_base_name_ = "jit_tmp";
     jit_temp_suffix_ = true;
+    jit_lowered_ = false;
+    jit_tiered_ = false;
+    jit_threshold_ = 10;
+    jit_calls_ = 0;
+    jit_tier_ = 0;
+    t_jit_ = 0;
     compiler_plugin_ = "clang";
 
     eval_ = nullptr;
@@ -113,16 +126,23 @@ namespace casadi {
   }
 
   ProtoFunction::~ProtoFunction() {
-    for (void* m : mem_) {
-      if (m!=nullptr) casadi_warning("Memory object has not been properly freed");
+    for (int i=0; i<n_mem_; ++i) {
+      if (mem_slot(i).mem!=nullptr) casadi_warning("Memory object has not been properly freed");
     }
-    mem_.clear();
+    for (auto&& b : mem_) delete[] b.load();
   }
 
   FunctionInternal::~FunctionInternal() {
-    if (jit_cleanup_ && jit_) {
+#ifdef CASADI_WITH_THREAD
+    // Wait for a background compilation, which only touches members of this class
+    if (jit_thread_.joinable()) jit_thread_.join();
+#endif // CASADI_WITH_THREAD
+    if (jit_cleanup_ && jit_ && !jit_lowered_ && !jit_name_.empty()) {
       std::string jit_name = jit_name_ + ".c";
       if (remove(jit_name.c_str())) casadi_warning("Failed to remove " + jit_name);
+      for (auto&& f : jit_sources_) {
+        if (remove(f.c_str())) casadi_warning("Failed to remove " + f);
+      }
     }
   }
 
@@ -243,6 +263,18 @@ namespace casadi {
       {"jit_options",
        {OT_DICT,
         "Options to be passed to the jit compiler."}},
+      {"jit_codegen_options",
+       {OT_DICT,
+        "Options to be passed to the code generator for jit, "
+        "e.g. 'split_size' and 'split_files' for large functions."}},
+      {"jit_tiered",
+       {OT_BOOL,
+        "With 'jit', start in the interpreter and compile in a background thread "
+        "once the function has been called 'jit_threshold' times. "
+        "The compiled code is swapped in when ready. Default: false"}},
+      {"jit_threshold",
+       {OT_INT,
+        "Number of interpreted calls before compiling, cf. 'jit_tiered'. Default: 10"}},
       {"derivative_of",
        {OT_FUNCTION,
         "The function is a derivative of another function. "
@@ -346,6 +378,9 @@ namespace casadi {
     opts["jit_cleanup"] = jit_cleanup_;
     opts["compiler"] = compiler_plugin_;
     opts["jit_options"] = jit_options_;
+    opts["jit_codegen_options"] = jit_codegen_options_;
+    opts["jit_tiered"] = jit_tiered_;
+    opts["jit_threshold"] = jit_threshold_;
     opts["jit_name"] = jit_name_;
     opts["jit_temp_suffix"] = jit_temp_suffix_;
     opts["derivative_of"] = derivative_of_;
@@ -405,6 +440,13 @@ namespace casadi {
         compiler_plugin_ = op.second.to_string();
       } else if (op.first=="jit_options") {
         jit_options_ = op.second;
+      } else if (op.first=="jit_codegen_options") {
+        jit_codegen_options_ = op.second;
+      } else if (op.first=="jit_tiered") {
+        jit_tiered_ = op.second;
+      } else if (op.first=="jit_threshold") {
+        jit_threshold_ = op.second;
+        casadi_assert(jit_threshold_>=0, "Option 'jit_threshold' must be nonnegative");
       } else if (op.first=="jit_name") {
         jit_base_name_ = op.second.to_string();
       } else if (op.first=="jit_temp_suffix") {
@@ -550,30 +592,11 @@ namespace casadi {
 
   void FunctionInternal::finalize() {
     if (jit_) {
-      jit_name_ = jit_base_name_;
-      if (jit_temp_suffix_) {
-        jit_name_ = temporary_file(jit_name_, ".c");
-        jit_name_ = std::string(jit_name_.begin(), jit_name_.begin()+jit_name_.size()-2);
-      }
-      if (has_codegen()) {
-        if (verbose_) casadi_message("Codegenerating function '" + name_ + "'.");
-        // JIT everything
-        Dict opts;
-        // Override the default to avoid random strings in the generated code
-        opts["prefix"] = "jit";
-        CodeGenerator gen(jit_name_, opts);
-        gen.add(self());
-        if (verbose_) casadi_message("Compiling function '" + name_ + "'..");
-        compiler_ = Importer(gen.generate(), compiler_plugin_, jit_options_);
-        if (verbose_) casadi_message("Compiling function '" + name_ + "' done.");
-        // Try to load
-        eval_ = (eval_t) compiler_.get_function(name_);
-        checkout_ = (casadi_checkout_t) compiler_.get_function(name_ + "checkout");
-        release_ = (casadi_release_t) compiler_.get_function(name_ + "release");
-        casadi_assert(eval_!=nullptr, "Cannot load JIT'ed function.");
+      if (jit_tiered_ && has_codegen()) {
+        // Start in the interpreter, cf. jit_tier_up
+        if (jit_threshold_==0) jit_tier_up();
       } else {
-        // Just jit dependencies
-        jit_dependencies(jit_name_);
+        jit_compile();
       }
     }
 
@@ -584,6 +607,168 @@ namespace casadi {
     if (dump_) dump();
   }
 
+  void FunctionInternal::jit_compile() {
+    if (ImporterInternal::has_lowering(compiler_plugin_)) {
+      // Compile the expression graph directly, without C code
+      if (verbose_) casadi_message("Compiling function '" + name_ + "' in memory..");
+      Importer compiler(jit_base_name_, compiler_plugin_, jit_options_);
+      compiler->lower(self(), name_);
+      if (verbose_) casadi_message("Compiling function '" + name_ + "' done.");
+      jit_publish(jit_base_name_, std::vector<std::string>(), true, compiler);
+    } else if (has_codegen()) {
+      std::string jit_name;
+      std::vector<std::string> jit_sources;
+      std::string jit_source = jit_generate(jit_name, jit_sources);
+      if (verbose_) casadi_message("Compiling function '" + name_ + "'..");
+      Importer compiler(jit_source, compiler_plugin_, jit_options_);
+      if (verbose_) casadi_message("Compiling function '" + name_ + "' done.");
+      jit_publish(jit_name, jit_sources, false, compiler);
+    } else {
+      // Just jit dependencies
+      jit_name_ = jit_base_name_;
+      jit_dependencies(jit_name_);
+    }
+  }
+
+  std::string FunctionInternal::jit_generate(std::string& jit_name,
+      std::vector<std::string>& jit_sources) const {
+    jit_name = jit_base_name_;
+    if (jit_temp_suffix_) {
+      jit_name = temporary_file(jit_name, ".c");
+      jit_name = std::string(jit_name.begin(), jit_name.begin()+jit_name.size()-2);
+    }
+    if (verbose_) casadi_message("Codegenerating function '" + name_ + "'.");
+    // JIT everything
+    Dict opts = jit_codegen_options_;
+    // Override the default to avoid random strings in the generated code
+    opts["prefix"] = "jit";
+    CodeGenerator gen(jit_name, opts);
+    gen.add(self());
+    std::string jit_source = gen.generate();
+    jit_sources = gen.split_sources_;
+    return jit_source;
+  }
+
+  void FunctionInternal::jit_publish(const std::string& jit_name,
+      const std::vector<std::string>& jit_sources, bool jit_lowered, Importer& compiler) {
+    // Load before publishing anything
+    eval_t eval = (eval_t) compiler.get_function(name_);
+    casadi_assert(eval!=nullptr, "Cannot load JIT'ed function.");
+    casadi_checkout_t checkout = nullptr;
+    casadi_release_t release = nullptr;
+    if (!jit_lowered) {
+      checkout = (casadi_checkout_t) compiler.get_function(name_ + "checkout");
+      release = (casadi_release_t) compiler.get_function(name_ + "release");
+    }
+    {
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(mtx_);
+#endif // CASADI_WITH_THREAD
+      jit_name_ = jit_name;
+      jit_sources_ = jit_sources;
+      jit_lowered_ = jit_lowered;
+      compiler_ = compiler;
+      checkout_ = checkout;
+      release_ = release;
+    }
+    // Redirect evaluation last, as it may be running concurrently
+    eval_.store(eval, std::memory_order_release);
+  }
+
+  void FunctionInternal::jit_tier_up() const {
+    // Only once
+    int tier = 0;
+    if (!jit_tier_.compare_exchange_strong(tier, 1)) return;
+    if (verbose_) casadi_message("Compiling '" + name_ + "' after "
+                                 + str(jit_calls_.load()) + " interpreted calls.");
+    FunctionInternal* node = const_cast<FunctionInternal*>(this);
+    auto t0 = std::chrono::steady_clock::now();
+
+    // Reading the expression graph is not thread-safe: code generation and
+    // in-memory compilation run in the calling thread, only external compilers in the background
+    std::string jit_name, jit_source;
+    std::vector<std::string> jit_sources;
+    bool lowered = false;
+    try {
+      lowered = ImporterInternal::has_lowering(compiler_plugin_);
+      if (lowered) {
+        node->jit_compile();
+      } else {
+        jit_source = jit_generate(jit_name, jit_sources);
+      }
+    } catch (std::exception& e) {
+      jit_fail(e.what(), t0);
+      return;
+    }
+    if (lowered) {
+      jit_done(t0);
+      return;
+    }
+    {
+      // Clean up the sources even if compilation fails
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(mtx_);
+#endif // CASADI_WITH_THREAD
+      node->jit_name_ = jit_name;
+      node->jit_sources_ = jit_sources;
+    }
+
+    // The destructor joins the thread, which only touches members of this class
+    auto compile = [node, jit_name, jit_sources, jit_source, t0]() {
+      try {
+        Importer compiler(jit_source, node->compiler_plugin_, node->jit_options_);
+        node->jit_publish(jit_name, jit_sources, false, compiler);
+      } catch (std::exception& e) {
+        node->jit_fail(e.what(), t0);
+        return;
+      }
+      node->jit_done(t0);
+    };
+#ifdef CASADI_WITH_THREAD
+    jit_thread_ = std::thread(compile);
+#else // CASADI_WITH_THREAD
+    compile();
+#endif // CASADI_WITH_THREAD
+  }
+
+  void FunctionInternal::jit_done(std::chrono::steady_clock::time_point t0) const {
+    {
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(mtx_);
+#endif // CASADI_WITH_THREAD
+      t_jit_ = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    }
+    jit_tier_ = 2;
+  }
+
+  void FunctionInternal::jit_fail(const std::string& msg,
+      std::chrono::steady_clock::time_point t0) const {
+    {
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(mtx_);
+#endif // CASADI_WITH_THREAD
+      t_jit_ = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+      jit_error_ = msg;
+    }
+    // Reported by the next evaluation, cf. jit_report
+    jit_tier_ = 3;
+  }
+
+  void FunctionInternal::jit_report() const {
+    // Only once
+    int tier = 3;
+    if (!jit_tier_.compare_exchange_strong(tier, 4)) return;
+    std::string msg;
+    {
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(mtx_);
+#endif // CASADI_WITH_THREAD
+      msg = jit_error_;
+    }
+    casadi_warning("Compilation of '" + name_ + "' failed, "
+                   "continuing in the interpreter: " + msg);
+  }
+
   void ProtoFunction::finalize() {
     // Create memory object
     int mem = checkout();
@@ -681,6 +866,69 @@ namespace casadi {
     return 0;
   }
 
+  // Numerical work vectors on this thread, one per nesting level of calls
+  struct NumericWork {
+    std::vector<const double*> arg;
+    std::vector<double*> res;
+    std::vector<casadi_int> iw;
+    std::vector<double> w;
+  };
+  static thread_local std::vector<std::unique_ptr<NumericWork> > numeric_work;
+  static thread_local size_t numeric_work_depth = 0;
+
+  CallBuffer<double>::CallBuffer(const FunctionInternal& f) {
+    if (numeric_work_depth==numeric_work.size()) {
+      numeric_work.push_back(std::unique_ptr<NumericWork>(new NumericWork()));
+    }
+    // Reallocates only if larger than any earlier call at this level
+    NumericWork& b = *numeric_work[numeric_work_depth];
+    b.arg.assign(f.sz_arg(), nullptr);
+    b.res.assign(f.sz_res(), nullptr);
+    b.iw.resize(f.sz_iw());
+    b.w.resize(f.sz_w());
+    arg = get_ptr(b.arg);
+    res = get_ptr(b.res);
+    iw = get_ptr(b.iw);
+    w = get_ptr(b.w);
+    numeric_work_depth++;
+  }
+
+  CallBuffer<double>::~CallBuffer() {
+    numeric_work_depth--;
+  }
+
+  bool FunctionInternal::call_direct(const DMDict& arg, DMDict& res) const {
+    if (res.size()!=n_out_) return false;
+    CallBuffer<double> buf(*this);
+    // Inputs
+    for (auto&& e : arg) {
+      auto it = std::find(name_in_.begin(), name_in_.end(), e.first);
+      if (it==name_in_.end()) return false;
+      casadi_int i = it - name_in_.begin();
+      if (e.second.sparsity()!=sparsity_in_[i]) return false;
+      buf.arg[i] = get_ptr(e.second);
+    }
+    // Missing inputs are passed as null, i.e. zero
+    for (casadi_int i=0; i<n_in_; ++i) {
+      if (!buf.arg[i] && nnz_in(i)>0 && get_default_in(i)!=0) return false;
+    }
+    // Outputs, written in place
+    for (casadi_int i=0; i<n_out_; ++i) {
+      auto it = res.find(name_out_[i]);
+      if (it==res.end() || it->second.sparsity()!=sparsity_out_[i]) return false;
+      buf.res[i] = get_ptr(it->second);
+    }
+    if (eval_gen(buf.arg, buf.res, buf.iw, buf.w, memory(0))) {
+      casadi_error("Evaluation failed");
+    }
+    return true;
+  }
+
+  bool FunctionInternal::can_eval_batch() const {
+    return has_eval_batch() && !jit_ && !dump_ && !dump_in_ && !dump_out_
+      && !print_in_ && !print_out_ && !record_time_;
+  }
+
   int FunctionInternal::
   eval_gen(const double** arg, double** res, casadi_int* iw, double* w, void* mem) const {
     casadi_int dump_id = (dump_in_ || dump_out_ || dump_) ? get_dump_id() : 0;
@@ -705,7 +953,8 @@ namespace casadi {
     for (auto&& s : m->fstats) s.second.reset();
     if (m->t_total) m->t_total->tic();
     int ret;
-    if (eval_) {
+    eval_t eval_c = eval_.load(std::memory_order_acquire);
+    if (eval_c) {
       int mem = 0;
       if (checkout_) {
 #ifdef CASADI_WITH_THREAD
@@ -713,7 +962,7 @@ namespace casadi {
 #endif //CASADI_WITH_THREAD
         mem = checkout_();
       }
-      ret = eval_(arg, res, iw, w, mem);
+      ret = eval_c(arg, res, iw, w, mem);
       if (release_) {
 #ifdef CASADI_WITH_THREAD
     std::lock_guard<std::mutex> lock(mtx_);
@@ -721,6 +970,11 @@ namespace casadi {
         release_(mem);
       }
     } else {
+      // Compile in the background once hot
+      if (jit_tiered_) {
+        if (jit_calls_++ >= jit_threshold_ && jit_tier_==0) jit_tier_up();
+        if (jit_tier_==3) jit_report();
+      }
       ret = eval(arg, res, iw, w, mem);
     }
     if (m->t_total) m->t_total->toc();
@@ -819,9 +1073,10 @@ namespace casadi {
     }
   }
 
-  Function FunctionInternal::map(casadi_int n, const std::string& parallelization) const {
+  Function FunctionInternal::map(casadi_int n, const std::string& parallelization,
+                                 const Dict& opts) const {
     Function f;
-    if (parallelization=="serial") {
+    if (parallelization=="serial" && opts.empty()) {
       // Serial maps are cached
       string fname = "map" + str(n) + "_" + name_;
       if (!incache(fname, f)) {
@@ -833,7 +1088,7 @@ namespace casadi {
       }
     } else {
       // Non-serial maps are not cached
-      f = Map::create(parallelization, self(), n);
+      f = Map::create(parallelization, self(), n, opts);
     }
     return f;
   }
@@ -898,6 +1153,47 @@ namespace casadi {
     r = 0;
     for (casadi_int i=begin; i<end; ++i) r |= s[i];
   }
+
+  // Number of threads sharing nsweep sparsity sweeps
+  casadi_int sparsity_threads(casadi_int nsweep) {
+    casadi_int n_thread = GlobalOptions::sparsity_threads;
+    if (n_thread<=0) n_thread = ThreadPool::target_size() + 1;
+    return std::max(std::min(n_thread, nsweep-1), casadi_int(1));
+  }
+
+  // Carry out sweeps 0, ..., nsweep-1 by calling sweep(s, slot), slot < n_thread
+  void run_sweeps(casadi_int nsweep, casadi_int n_thread,
+                  const std::function<void(casadi_int, casadi_int)>& sweep) {
+    if (n_thread==1) {
+      for (casadi_int s=0; s<nsweep; ++s) sweep(s, 0);
+      return;
+    }
+    // The first sweep is made by the calling thread alone, such that any
+    // lazily initialized data (e.g. Jacobian sparsity of called functions)
+    // is in place before the remaining sweeps are made concurrently
+    if (nsweep>0) sweep(0, 0);
+    std::vector<std::string> err(n_thread);
+    ThreadPool::instance().run(nsweep-1, n_thread, 1,
+      [&](casadi_int task, casadi_int slot) {
+        if (!err[slot].empty()) return;
+        try {
+          sweep(task+1, slot);
+        } catch (std::exception& e) {
+          err[slot] = e.what();
+        }
+      });
+    for (const std::string& e : err) {
+      casadi_assert(e.empty(), "Sparsity propagation failed: " + e);
+    }
+  }
+
+  // A sweep of the hierarchical sparsity algorithms, deferred until all seeds are known
+  struct HierarchicalSweep {
+    // Seed toggles, as (begin, end, bit) triplets
+    std::vector<casadi_int> toggle;
+    // Lookup table
+    IM lookup;
+  };
   /// \endcond
 
   // Traits
@@ -906,9 +1202,9 @@ namespace casadi {
     typedef const bvec_t* arg_t;
     static inline void sp(const FunctionInternal *f,
                           const bvec_t** arg, bvec_t** res,
-                          casadi_int* iw, bvec_t* w, void* mem) {
+                          casadi_int* iw, bvec_t* w, void* mem, casadi_int nw=1) {
       std::vector<const bvec_t*> argm(f->sz_arg(), nullptr);
-      std::vector<bvec_t> wm(f->nnz_in(), bvec_t(0));
+      std::vector<bvec_t> wm(nw*f->nnz_in(), bvec_t(0));
       bvec_t* wp = get_ptr(wm);
 
       for (casadi_int i=0;i<f->n_in_;++i) {
@@ -916,12 +1212,16 @@ namespace casadi {
           argm[i] = arg[i];
         } else  {
           argm[i] = arg[i] ? wp : nullptr;
-          wp += f->nnz_in(i);
+          wp += nw*f->nnz_in(i);
         }
       }
-      f->sp_forward(get_ptr(argm), res, iw, w, mem);
+      if (nw==1) {
+        f->sp_forward(get_ptr(argm), res, iw, w, mem);
+      } else {
+        f->sp_forward_wide(get_ptr(argm), res, iw, w, mem, nw);
+      }
       for (casadi_int i=0;i<f->n_out_;++i) {
-        if (!f->is_diff_out_[i] && res[i]) casadi_clear(res[i], f->nnz_out(i));
+        if (!f->is_diff_out_[i] && res[i]) casadi_clear(res[i], nw*f->nnz_out(i));
       }
     }
   };
@@ -929,13 +1229,17 @@ namespace casadi {
     typedef bvec_t* arg_t;
     static inline void sp(const FunctionInternal *f,
                           bvec_t** arg, bvec_t** res,
-                          casadi_int* iw, bvec_t* w, void* mem) {
+                          casadi_int* iw, bvec_t* w, void* mem, casadi_int nw=1) {
       for (casadi_int i=0;i<f->n_out_;++i) {
-        if (!f->is_diff_out_[i] && res[i]) casadi_clear(res[i], f->nnz_out(i));
+        if (!f->is_diff_out_[i] && res[i]) casadi_clear(res[i], nw*f->nnz_out(i));
+      }
+      if (nw==1) {
+        f->sp_reverse(arg, res, iw, w, mem);
+      } else {
+        f->sp_reverse_wide(arg, res, iw, w, mem, nw);
       }
-      f->sp_reverse(arg, res, iw, w, mem);
       for (casadi_int i=0;i<f->n_in_;++i) {
-        if (!f->is_diff_in_[i] && arg[i]) casadi_clear(arg[i], f->nnz_in(i));
+        if (!f->is_diff_in_[i] && arg[i]) casadi_clear(arg[i], nw*f->nnz_in(i));
       }
     }
   };
@@ -948,62 +1252,71 @@ namespace casadi {
     casadi_int nz_in = nnz_in(iind);
     casadi_int nz_out = nnz_out(oind);
 
-    // Evaluation buffers
-    vector<typename JacSparsityTraits<fwd>::arg_t> arg(sz_arg(), nullptr);
-    vector<bvec_t*> res(sz_res(), nullptr);
-    vector<casadi_int> iw(sz_iw());
-    vector<bvec_t> w(sz_w(), 0);
+    // Number of bvec_t words propagated per nonzero
+    casadi_int nw = has_sp_wide() ? std::max(GlobalOptions::sparsity_lanes, casadi_int(1)) : 1;
 
-    // Seeds and sensitivities
-    vector<bvec_t> seed(nz_in, 0);
-    arg[iind] = get_ptr(seed);
-    vector<bvec_t> sens(nz_out, 0);
-    res[oind] = get_ptr(sens);
-    if (!fwd) std::swap(seed, sens);
+    // Number of directions
+    casadi_int ndir = fwd ? nz_in : nz_out;
+
+    // Number of directions per sweep
+    casadi_int ndir_sweep = nw*bvec_size;
 
     // Number of forward sweeps we must make
-    casadi_int nsweep = seed.size() / bvec_size;
-    if (seed.size() % bvec_size) nsweep++;
+    casadi_int nsweep = ndir / ndir_sweep;
+    if (ndir % ndir_sweep) nsweep++;
+
+    // Number of threads sharing the sweeps
+    casadi_int n_thread = sparsity_threads(nsweep);
 
     // Print
     if (verbose_) {
       casadi_message(str(nsweep) + string(fwd ? " forward" : " reverse") + " sweeps "
-                     "needed for " + str(seed.size()) + " directions");
+                     "needed for " + str(ndir) + " directions");
+      if (n_thread>1) casadi_message("Distributing sweeps over " + str(n_thread) + " threads");
     }
 
-    // Progress
-    casadi_int progress = -10;
-
-    // Temporary vectors
-    std::vector<casadi_int> jcol, jrow;
-
-    // Loop over the variables, bvec_size variables at a time
-    for (casadi_int s=0; s<nsweep; ++s) {
+    // Evaluation buffers and pattern triplets of a thread
+    struct SweepData {
+      vector<typename JacSparsityTraits<fwd>::arg_t> arg;
+      vector<bvec_t*> res;
+      vector<casadi_int> iw;
+      vector<bvec_t> w, seed, sens;
+      std::vector<casadi_int> jcol, jrow;
+    };
+    vector<SweepData> sd(n_thread);
+    for (SweepData& d : sd) {
+      d.arg.resize(sz_arg(), nullptr);
+      d.res.resize(sz_res(), nullptr);
+      d.iw.resize(sz_iw());
+      d.w.resize(nw*sz_w(), 0);
+      // Seeds and sensitivities
+      d.seed.resize(nw*nz_in, 0);
+      d.arg[iind] = get_ptr(d.seed);
+      d.sens.resize(nw*nz_out, 0);
+      d.res[oind] = get_ptr(d.sens);
+      if (!fwd) std::swap(d.seed, d.sens);
+    }
 
-      // Print progress
-      if (verbose_) {
-        casadi_int progress_new = (s*100)/nsweep;
-        // Print when entering a new decade
-        if (progress_new / 10 > progress / 10) {
-          progress = progress_new;
-          casadi_message(str(progress) + " %");
-        }
-      }
+    // Carry out sweep s using the buffers d
+    auto sweep = [&](SweepData& d, casadi_int s) {
+      vector<bvec_t>& seed = d.seed;
+      vector<bvec_t>& sens = d.sens;
 
       // Nonzero offset
-      casadi_int offset = s*bvec_size;
+      casadi_int offset = s*ndir_sweep;
 
       // Number of local seed directions
-      casadi_int ndir_local = seed.size()-offset;
-      ndir_local = std::min(static_cast<casadi_int>(bvec_size), ndir_local);
+      casadi_int ndir_local = ndir-offset;
+      ndir_local = std::min(ndir_sweep, ndir_local);
 
+      // Direction i is bit i % bvec_size of word i / bvec_size
       for (casadi_int i=0; i<ndir_local; ++i) {
-        seed[offset+i] |= bvec_t(1)<<i;
+        seed[nw*(offset+i) + i/bvec_size] |= bvec_t(1)<<(i%bvec_size);
       }
 
       // Propagate the dependencies
-      JacSparsityTraits<fwd>::sp(this, get_ptr(arg), get_ptr(res),
-                                  get_ptr(iw), get_ptr(w), memory(0));
+      JacSparsityTraits<fwd>::sp(this, get_ptr(d.arg), get_ptr(d.res),
+                                  get_ptr(d.iw), get_ptr(d.w), memory(0), nw);
 
       // Loop over the nonzeros of the output
       for (casadi_int el=0; el<sens.size(); ++el) {
@@ -1019,14 +1332,19 @@ namespace casadi {
         // If there is a dependency in any of the directions
         if (spsens!=0) {
 
+          // Directions represented by this word
+          casadi_int q = el % nw;
+          casadi_int i_begin = q*bvec_size;
+          casadi_int i_end = std::min(i_begin+bvec_size, ndir_local);
+
           // Loop over seed directions
-          for (casadi_int i=0; i<ndir_local; ++i) {
+          for (casadi_int i=i_begin; i<i_end; ++i) {
 
             // If dependents on the variable
-            if ((bvec_t(1) << i) & spsens) {
+            if ((bvec_t(1) << (i-i_begin)) & spsens) {
               // Add to pattern
-              jcol.push_back(el);
-              jrow.push_back(i+offset);
+              d.jcol.push_back(el / nw);
+              d.jrow.push_back(i+offset);
             }
           }
         }
@@ -1034,8 +1352,32 @@ namespace casadi {
 
       // Remove the seeds
       for (casadi_int i=0; i<ndir_local; ++i) {
-        seed[offset+i] = 0;
+        seed[nw*(offset+i) + i/bvec_size] = 0;
       }
+    };
+
+    // Progress
+    casadi_int progress = -10;
+
+    // Loop over the variables, ndir_sweep variables at a time
+    run_sweeps(nsweep, n_thread, [&](casadi_int s, casadi_int slot) {
+      // Print progress
+      if (verbose_ && n_thread==1) {
+        casadi_int progress_new = (s*100)/nsweep;
+        // Print when entering a new decade
+        if (progress_new / 10 > progress / 10) {
+          progress = progress_new;
+          casadi_message(str(progress) + " %");
+        }
+      }
+      sweep(sd[slot], s);
+    });
+
+    // Merge the pattern triplets
+    std::vector<casadi_int> jcol, jrow;
+    for (SweepData& d : sd) {
+      jcol.insert(jcol.end(), d.jcol.begin(), d.jcol.end());
+      jrow.insert(jrow.end(), d.jrow.begin(), d.jrow.end());
     }
 
     // Construct sparsity pattern and return
@@ -1056,19 +1398,16 @@ namespace casadi {
     casadi_int nz = nnz_in(iind);
     casadi_assert_dev(nz==nnz_out(oind));
 
-    // Evaluation buffers
-    vector<const bvec_t*> arg(sz_arg(), nullptr);
-    vector<bvec_t*> res(sz_res(), nullptr);
-    vector<casadi_int> iw(sz_iw());
-    vector<bvec_t> w(sz_w());
-
-    // Seeds
-    vector<bvec_t> seed(nz, 0);
-    arg[iind] = get_ptr(seed);
-
-    // Sensitivities
-    vector<bvec_t> sens(nz, 0);
-    res[oind] = get_ptr(sens);
+    // Seeds, sensitivities, evaluation buffers and sparsity triplets of a thread
+    struct SweepData {
+      vector<const bvec_t*> arg;
+      vector<bvec_t*> res;
+      vector<casadi_int> iw;
+      vector<bvec_t> w;
+      vector<bvec_t> seed, sens;
+      std::vector<casadi_int> jcol, jrow;
+    };
+    vector<SweepData> sd;
 
     // Sparsity triplet accumulator
     std::vector<casadi_int> jcol, jrow;
@@ -1108,8 +1447,9 @@ namespace casadi {
           + str(D.size2()) + " <-> " + str(D.size1()));
       }
 
-      // Clear the seeds
-      fill(seed.begin(), seed.end(), 0);
+      // Sweeps of this level
+      std::vector<HierarchicalSweep> sweeps;
+      std::vector<casadi_int> toggle;
 
       // Subdivide the coarse block
       for (casadi_int k=0; k<coarse.size()-1; ++k) {
@@ -1181,8 +1521,9 @@ namespace casadi {
               }
 
               // Toggle on seeds
-              bvec_toggle(get_ptr(seed), fine[fci+fci_start], fine[fci+fci_start+1],
-                          bvec_i+bvec_i_mod);
+              toggle.push_back(fine[fci+fci_start]);
+              toggle.push_back(fine[fci+fci_start+1]);
+              toggle.push_back(bvec_i+bvec_i_mod);
               bvec_i_mod++;
             }
           }
@@ -1192,7 +1533,7 @@ namespace casadi {
 
           // Check if bvec buffer is full
           if (bvec_i==bvec_size || csd==D.size2()-1) {
-            // Calculate sparsity for bvec_size directions at once
+            // Sparsity for bvec_size directions will be calculated at once
 
             // Statistics
             nsweeps+=1;
@@ -1210,41 +1551,10 @@ namespace casadi {
             duplicates = sparsify(duplicates);
             lookup(duplicates.sparsity()) = -bvec_size;
 
-            // Propagate the dependencies
-            JacSparsityTraits<true>::sp(this, get_ptr(arg), get_ptr(res),
-              get_ptr(iw), get_ptr(w), nullptr);
-
-            // Temporary bit work vector
-            bvec_t spsens;
-
-            // Loop over the cols of coarse blocks
-            for (casadi_int cri=0; cri<coarse.size()-1; ++cri) {
-
-              // Loop over the cols of fine blocks within the current coarse block
-              for (casadi_int fri=fine_lookup[coarse[cri]];fri<fine_lookup[coarse[cri+1]];++fri) {
-                // Lump individual sensitivities together into fine block
-                bvec_or(get_ptr(sens), spsens, fine[fri], fine[fri+1]);
-
-                // Loop over all bvec_bits
-                for (casadi_int bvec_i=0;bvec_i<bvec_size;++bvec_i) {
-                  if (spsens & (bvec_t(1) << bvec_i)) {
-                    // if dependency is found, add it to the new sparsity pattern
-                    casadi_int ind = lookup.sparsity().get_nz(bvec_i, cri);
-                    if (ind==-1) continue;
-                    casadi_int lk = lookup->at(ind);
-                    if (lk>-bvec_size) {
-                      jrow.push_back(bvec_i+lk);
-                      jcol.push_back(fri);
-                      jrow.push_back(fri);
-                      jcol.push_back(bvec_i+lk);
-                    }
-                  }
-                }
-              }
-            }
-
-            // Clear the forward seeds/adjoint sensitivities, ready for next bvec sweep
-            fill(seed.begin(), seed.end(), 0);
+            // Defer the sweep
+            sweeps.push_back(HierarchicalSweep());
+            sweeps.back().toggle.swap(toggle);
+            sweeps.back().lookup = lookup;
 
             // Clean lookup table
             lookup_col.clear();
@@ -1262,6 +1572,75 @@ namespace casadi {
         }
       }
 
+      // Carry out the sweeps, possibly in parallel
+      casadi_int n_thread = sparsity_threads(sweeps.size());
+      while (sd.size()<n_thread) {
+        // Buffers of an additional thread, moving keeps the pointers into them valid
+        sd.push_back(SweepData());
+        SweepData& d = sd.back();
+        d.arg.resize(sz_arg(), nullptr);
+        d.res.resize(sz_res(), nullptr);
+        d.iw.resize(sz_iw());
+        d.w.resize(sz_w());
+        d.seed.resize(nz, 0);
+        d.arg[iind] = get_ptr(d.seed);
+        d.sens.resize(nz, 0);
+        d.res[oind] = get_ptr(d.sens);
+      }
+      run_sweeps(sweeps.size(), n_thread, [&](casadi_int s, casadi_int slot) {
+        SweepData& d = sd[slot];
+        const HierarchicalSweep& sw = sweeps[s];
+
+        // Toggle on seeds
+        for (casadi_int k=0; k<sw.toggle.size(); k+=3) {
+          bvec_toggle(get_ptr(d.seed), sw.toggle[k], sw.toggle[k+1], sw.toggle[k+2]);
+        }
+
+        // Propagate the dependencies
+        JacSparsityTraits<true>::sp(this, get_ptr(d.arg), get_ptr(d.res),
+          get_ptr(d.iw), get_ptr(d.w), nullptr);
+
+        // Temporary bit work vector
+        bvec_t spsens;
+
+        // Loop over the cols of coarse blocks
+        for (casadi_int cri=0; cri<coarse.size()-1; ++cri) {
+
+          // Loop over the cols of fine blocks within the current coarse block
+          for (casadi_int fri=fine_lookup[coarse[cri]];fri<fine_lookup[coarse[cri+1]];++fri) {
+            // Lump individual sensitivities together into fine block
+            bvec_or(get_ptr(d.sens), spsens, fine[fri], fine[fri+1]);
+
+            // Loop over all bvec_bits
+            for (casadi_int bvec_i=0;bvec_i<bvec_size;++bvec_i) {
+              if (spsens & (bvec_t(1) << bvec_i)) {
+                // if dependency is found, add it to the new sparsity pattern
+                casadi_int ind = sw.lookup.sparsity().get_nz(bvec_i, cri);
+                if (ind==-1) continue;
+                casadi_int lk = sw.lookup->at(ind);
+                if (lk>-bvec_size) {
+                  d.jrow.push_back(bvec_i+lk);
+                  d.jcol.push_back(fri);
+                  d.jrow.push_back(fri);
+                  d.jcol.push_back(bvec_i+lk);
+                }
+              }
+            }
+          }
+        }
+
+        // Clear the forward seeds/adjoint sensitivities, ready for next bvec sweep
+        fill(d.seed.begin(), d.seed.end(), 0);
+      });
+
+      // Merge the sparsity triplets
+      for (SweepData& d : sd) {
+        jcol.insert(jcol.end(), d.jcol.begin(), d.jcol.end());
+        jrow.insert(jrow.end(), d.jrow.begin(), d.jrow.end());
+        d.jcol.clear();
+        d.jrow.clear();
+      }
+
       // Construct fine sparsity pattern
       r = Sparsity::triplet(fine.size()-1, fine.size()-1, jrow, jcol);
 
@@ -1291,18 +1670,17 @@ namespace casadi {
     // Number of nonzero outputs
     casadi_int nz_out = nnz_out(oind);
 
-    // Seeds and sensitivities
-    vector<bvec_t> s_in(nz_in, 0);
-    vector<bvec_t> s_out(nz_out, 0);
-
-    // Evaluation buffers
-    vector<const bvec_t*> arg_fwd(sz_arg(), nullptr);
-    vector<bvec_t*> arg_adj(sz_arg(), nullptr);
-    arg_fwd[iind] = arg_adj[iind] = get_ptr(s_in);
-    vector<bvec_t*> res(sz_res(), nullptr);
-    res[oind] = get_ptr(s_out);
-    vector<casadi_int> iw(sz_iw());
-    vector<bvec_t> w(sz_w());
+    // Seeds, sensitivities, evaluation buffers and sparsity triplets of a thread
+    struct SweepData {
+      vector<bvec_t> s_in, s_out;
+      vector<const bvec_t*> arg_fwd;
+      vector<bvec_t*> arg_adj;
+      vector<bvec_t*> res;
+      vector<casadi_int> iw;
+      vector<bvec_t> w;
+      std::vector<casadi_int> jcol, jrow;
+    };
+    vector<SweepData> sd;
 
     // Sparsity triplet accumulator
     std::vector<casadi_int> jcol, jrow;
@@ -1381,16 +1759,13 @@ namespace casadi {
             "(fwd cost: " + str(fwd_cost) + ", adj cost: " + str(adj_cost) + ")");
       }
 
-      // Get seeds and sensitivities
-      bvec_t* seed_v = use_fwd ? get_ptr(s_in) : get_ptr(s_out);
-      bvec_t* sens_v = use_fwd ? get_ptr(s_out) : get_ptr(s_in);
-
       // The number of zeros in the seed and sensitivity directions
       casadi_int nz_seed = use_fwd ? nz_in  : nz_out;
       casadi_int nz_sens = use_fwd ? nz_out : nz_in;
 
-      // Clear the seeds
-      for (casadi_int i=0; i<nz_seed; ++i) seed_v[i]=0;
+      // Sweeps of this level
+      std::vector<HierarchicalSweep> sweeps;
+      std::vector<casadi_int> toggle;
 
       // Choose the active jacobian coloring scheme
       Sparsity D = use_fwd ? D1 : D2;
@@ -1481,8 +1856,9 @@ namespace casadi {
               }
 
               // Toggle on seeds
-              bvec_toggle(seed_v, fine_row[fci+fci_start], fine_row[fci+fci_start+1],
-                          bvec_i+bvec_i_mod);
+              toggle.push_back(fine_row[fci+fci_start]);
+              toggle.push_back(fine_row[fci+fci_start+1]);
+              toggle.push_back(bvec_i+bvec_i_mod);
               bvec_i_mod++;
             }
           }
@@ -1492,58 +1868,16 @@ namespace casadi {
 
           // Check if bvec buffer is full
           if (bvec_i==bvec_size || csd==D.size2()-1) {
-            // Calculate sparsity for bvec_size directions at once
+            // Sparsity for bvec_size directions will be calculated at once
 
             // Statistics
             nsweeps+=1;
 
-            // Construct lookup table
-            IM lookup = IM::triplet(lookup_row, lookup_col, lookup_value, bvec_size,
-                                    coarse_col.size());
-
-            // Propagate the dependencies
-            if (use_fwd) {
-              JacSparsityTraits<true>::sp(this, get_ptr(arg_fwd), get_ptr(res),
-                get_ptr(iw), get_ptr(w), memory(0));
-            } else {
-              fill(w.begin(), w.end(), 0);
-              JacSparsityTraits<false>::sp(this, get_ptr(arg_adj), get_ptr(res),
-                get_ptr(iw), get_ptr(w), memory(0));
-            }
-
-            // Temporary bit work vector
-            bvec_t spsens;
-
-            // Loop over the cols of coarse blocks
-            for (casadi_int cri=0;cri<coarse_col.size()-1;++cri) {
-
-              // Loop over the cols of fine blocks within the current coarse block
-              for (casadi_int fri=fine_col_lookup[coarse_col[cri]];
-                   fri<fine_col_lookup[coarse_col[cri+1]];++fri) {
-                // Lump individual sensitivities together into fine block
-                bvec_or(sens_v, spsens, fine_col[fri], fine_col[fri+1]);
-
-                // Next iteration if no sparsity
-                if (!spsens) continue;
-
-                // Loop over all bvec_bits
-                for (casadi_int bvec_i=0;bvec_i<bvec_size;++bvec_i) {
-                  if (spsens & bvec_lookup[bvec_i]) {
-                    // if dependency is found, add it to the new sparsity pattern
-                    casadi_int ind = lookup.sparsity().get_nz(bvec_i, cri);
-                    if (ind==-1) continue;
-                    jrow.push_back(bvec_i+lookup->at(ind));
-                    jcol.push_back(fri);
-                  }
-                }
-              }
-            }
-
-            // Clear the forward seeds/adjoint sensitivities, ready for next bvec sweep
-            fill(s_in.begin(), s_in.end(), 0);
-
-            // Clear the adjoint seeds/forward sensitivities, ready for next bvec sweep
-            fill(s_out.begin(), s_out.end(), 0);
+            // Defer the sweep
+            sweeps.push_back(HierarchicalSweep());
+            sweeps.back().toggle.swap(toggle);
+            sweeps.back().lookup = IM::triplet(lookup_row, lookup_col, lookup_value, bvec_size,
+                                               coarse_col.size());
 
             // Clean lookup table
             lookup_col.clear();
@@ -1563,6 +1897,88 @@ namespace casadi {
 
       }
 
+      // Carry out the sweeps, possibly in parallel
+      casadi_int n_thread = sparsity_threads(sweeps.size());
+      while (sd.size()<n_thread) {
+        // Buffers of an additional thread, moving keeps the pointers into them valid
+        sd.push_back(SweepData());
+        SweepData& d = sd.back();
+        d.s_in.resize(nz_in, 0);
+        d.s_out.resize(nz_out, 0);
+        d.arg_fwd.resize(sz_arg(), nullptr);
+        d.arg_adj.resize(sz_arg(), nullptr);
+        d.arg_fwd[iind] = d.arg_adj[iind] = get_ptr(d.s_in);
+        d.res.resize(sz_res(), nullptr);
+        d.res[oind] = get_ptr(d.s_out);
+        d.iw.resize(sz_iw());
+        d.w.resize(sz_w());
+      }
+      run_sweeps(sweeps.size(), n_thread, [&](casadi_int s, casadi_int slot) {
+        SweepData& d = sd[slot];
+        const HierarchicalSweep& sw = sweeps[s];
+
+        // Get seeds and sensitivities
+        bvec_t* seed_v = use_fwd ? get_ptr(d.s_in) : get_ptr(d.s_out);
+        bvec_t* sens_v = use_fwd ? get_ptr(d.s_out) : get_ptr(d.s_in);
+
+        // Toggle on seeds
+        for (casadi_int k=0; k<sw.toggle.size(); k+=3) {
+          bvec_toggle(seed_v, sw.toggle[k], sw.toggle[k+1], sw.toggle[k+2]);
+        }
+
+        // Propagate the dependencies
+        if (use_fwd) {
+          JacSparsityTraits<true>::sp(this, get_ptr(d.arg_fwd), get_ptr(d.res),
+            get_ptr(d.iw), get_ptr(d.w), memory(0));
+        } else {
+          fill(d.w.begin(), d.w.end(), 0);
+          JacSparsityTraits<false>::sp(this, get_ptr(d.arg_adj), get_ptr(d.res),
+            get_ptr(d.iw), get_ptr(d.w), memory(0));
+        }
+
+        // Temporary bit work vector
+        bvec_t spsens;
+
+        // Loop over the cols of coarse blocks
+        for (casadi_int cri=0;cri<coarse_col.size()-1;++cri) {
+
+          // Loop over the cols of fine blocks within the current coarse block
+          for (casadi_int fri=fine_col_lookup[coarse_col[cri]];
+               fri<fine_col_lookup[coarse_col[cri+1]];++fri) {
+            // Lump individual sensitivities together into fine block
+            bvec_or(sens_v, spsens, fine_col[fri], fine_col[fri+1]);
+
+            // Next iteration if no sparsity
+            if (!spsens) continue;
+
+            // Loop over all bvec_bits
+            for (casadi_int bvec_i=0;bvec_i<bvec_size;++bvec_i) {
+              if (spsens & bvec_lookup[bvec_i]) {
+                // if dependency is found, add it to the new sparsity pattern
+                casadi_int ind = sw.lookup.sparsity().get_nz(bvec_i, cri);
+                if (ind==-1) continue;
+                d.jrow.push_back(bvec_i+sw.lookup->at(ind));
+                d.jcol.push_back(fri);
+              }
+            }
+          }
+        }
+
+        // Clear the forward seeds/adjoint sensitivities, ready for next bvec sweep
+        fill(d.s_in.begin(), d.s_in.end(), 0);
+
+        // Clear the adjoint seeds/forward sensitivities, ready for next bvec sweep
+        fill(d.s_out.begin(), d.s_out.end(), 0);
+      });
+
+      // Merge the sparsity triplets
+      for (SweepData& d : sd) {
+        jcol.insert(jcol.end(), d.jcol.begin(), d.jcol.end());
+        jrow.insert(jrow.end(), d.jrow.begin(), d.jrow.end());
+        d.jcol.clear();
+        d.jrow.clear();
+      }
+
       // Swap results if adjoint mode was used
       if (use_fwd) {
         // Construct fine sparsity pattern
@@ -1821,6 +2237,11 @@ namespace casadi {
     casadi_error("'eval_sx' not defined for " + class_name());
   }
 
+  int FunctionInternal::eval_batch(const double** arg, double** res, casadi_int* iw, double* w,
+                                   void* mem, casadi_int n) const {
+    casadi_error("'eval_batch' not defined for " + class_name());
+  }
+
   Function FunctionInternal::forward(casadi_int nfwd) const {
     casadi_assert_dev(nfwd>=0);
     // Used wrapped function if forward not available
@@ -2126,6 +2547,38 @@ namespace casadi {
                             "casadi_int* iw, casadi_real* w, int mem)";
   }
 
+  void FunctionInternal::codegen_batch(CodeGenerator& g, const std::string& fname) const {
+    // Define function
+    g << "/* " << definition() << ", batched */\n";
+    g << "static " << signature_batch(fname) << " {\n";
+
+    // Reset local variables, flush buffer
+    g.flush(g.body);
+
+    g.scope_enter();
+
+    // Generate function body (to buffer)
+    codegen_batch_body(g);
+
+    g.scope_exit();
+
+    // Finalize the function
+    g << "return 0;\n";
+    g << "}\n\n";
+
+    // Flush to function body
+    g.flush(g.body);
+  }
+
+  std::string FunctionInternal::signature_batch(const std::string& fname) const {
+    return "int " + fname + "(const casadi_real** arg, casadi_real** res, "
+                            "casadi_int* iw, casadi_real* w, int mem, casadi_int n)";
+  }
+
+  void FunctionInternal::codegen_batch_body(CodeGenerator& g) const {
+    casadi_error("'codegen_batch_body' not defined for " + class_name());
+  }
+
   void FunctionInternal::codegen_init_mem(CodeGenerator& g) const {
     g << "return 0;\n";
   }
@@ -2231,8 +2684,7 @@ namespace casadi {
     codegen_sparsities(g);
 
     // Determine work vector size
-    casadi_int sz_w_codegen = sz_w();
-    if (is_a("SXFunction", true) && !g.avoid_stack()) sz_w_codegen = 0;
+    casadi_int sz_w_codegen = codegen_sz_w(g);
 
     // Function that returns work vector lengths
     g << g.declare(
@@ -2501,6 +2953,76 @@ namespace casadi {
     return 0;
   }
 
+  int FunctionInternal::
+  sp_forward_wide(const bvec_t** arg, bvec_t** res, casadi_int* iw, bvec_t* w, void* mem,
+                  casadi_int nw) const {
+    // Loop over outputs
+    for (casadi_int oind=0; oind<n_out_; ++oind) {
+      // Skip if nothing to assign
+      if (res[oind]==nullptr || nnz_out(oind)==0) continue;
+
+      // Clear result
+      casadi_clear(res[oind], nw*nnz_out(oind));
+
+      // Loop over inputs
+      for (casadi_int iind=0; iind<n_in_; ++iind) {
+        // Skip if no seeds
+        if (arg[iind]==nullptr || nnz_in(iind)==0) continue;
+
+        // Get the sparsity of the Jacobian block
+        Sparsity sp = sparsity_jac(iind, oind, true, false);
+        if (sp.is_null() || sp.nnz() == 0) continue; // Skip if zero
+
+        // Carry out the sparse matrix-vector multiplication, word by word
+        casadi_int d1 = sp.size2();
+        const casadi_int *colind = sp.colind(), *row = sp.row();
+        for (casadi_int cc=0; cc<d1; ++cc) {
+          for (casadi_int el = colind[cc]; el < colind[cc+1]; ++el) {
+            bvec_t* r = res[oind] + nw*row[el];
+            const bvec_t* a = arg[iind] + nw*cc;
+            for (casadi_int q=0; q<nw; ++q) r[q] |= a[q];
+          }
+        }
+      }
+    }
+    return 0;
+  }
+
+  int FunctionInternal::
+  sp_reverse_wide(bvec_t** arg, bvec_t** res, casadi_int* iw, bvec_t* w, void* mem,
+                  casadi_int nw) const {
+    // Loop over outputs
+    for (casadi_int oind=0; oind<n_out_; ++oind) {
+      // Skip if nothing to assign
+      if (res[oind]==nullptr || nnz_out(oind)==0) continue;
+
+      // Loop over inputs
+      for (casadi_int iind=0; iind<n_in_; ++iind) {
+        // Skip if no seeds
+        if (arg[iind]==nullptr || nnz_in(iind)==0) continue;
+
+        // Get the sparsity of the Jacobian block
+        Sparsity sp = sparsity_jac(iind, oind, true, false);
+        if (sp.is_null() || sp.nnz() == 0) continue; // Skip if zero
+
+        // Carry out the sparse matrix-vector multiplication, word by word
+        casadi_int d1 = sp.size2();
+        const casadi_int *colind = sp.colind(), *row = sp.row();
+        for (casadi_int cc=0; cc<d1; ++cc) {
+          for (casadi_int el = colind[cc]; el < colind[cc+1]; ++el) {
+            bvec_t* a = arg[iind] + nw*cc;
+            const bvec_t* r = res[oind] + nw*row[el];
+            for (casadi_int q=0; q<nw; ++q) a[q] |= r[q];
+          }
+        }
+      }
+
+      // Clear seeds
+      casadi_clear(res[oind], nw*nnz_out(oind));
+    }
+    return 0;
+  }
+
   void FunctionInternal::sz_work(size_t& sz_arg, size_t& sz_res,
                                  size_t& sz_iw, size_t& sz_w) const {
     sz_arg = this->sz_arg();
@@ -2563,6 +3085,21 @@ namespace casadi {
     return stats;
   }
 
+  Dict FunctionInternal::get_stats(void* mem) const {
+    Dict stats = ProtoFunction::get_stats(mem);
+    // Tier transitions
+    if (jit_tiered_) {
+      const char* tiers[] = {"interpreted", "compiling", "compiled", "failed", "failed"};
+      stats["jit_tier"] = std::string(tiers[jit_tier_]);
+      stats["n_call_interpreted"] = jit_calls_.load();
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(mtx_);
+#endif // CASADI_WITH_THREAD
+      stats["t_jit"] = t_jit_;
+    }
+    return stats;
+  }
+
   bool FunctionInternal::has_derivative() const {
     return enable_forward_ || enable_reverse_ || enable_jacobian_ || enable_fd_;
   }
@@ -3121,10 +3658,13 @@ namespace casadi {
   }
 
   void ProtoFunction::clear_mem() {
-    for (auto&& i : mem_) {
-      if (i!=nullptr) free_mem(i);
+    for (int i=0; i<n_mem_; ++i) {
+      void*& m = mem_slot(i).mem;
+      if (m!=nullptr) free_mem(m);
+      m = nullptr;
     }
-    mem_.clear();
+    n_mem_ = 0;
+    unused_ = 0;
   }
 
   size_t FunctionInternal::get_n_in() {
@@ -3199,38 +3739,65 @@ namespace casadi {
     return Sparsity::scalar();
   }
 
+  ProtoFunction::MemSlot& ProtoFunction::mem_slot(int ind) const {
+    // Block k holds the entries 16*(2^k-1) to 16*(2^(k+1)-1)-1
+    unsigned int b = (static_cast<unsigned int>(ind) >> 4) + 1;
+    int k = 0;
+    while (b >> (k+1)) k++;
+    return mem_[k].load(std::memory_order_acquire)[ind + 16 - (16 << k)];
+  }
+
   void* ProtoFunction::memory(int ind) const {
-#ifdef CASADI_WITH_THREAD
-    std::lock_guard<std::mutex> lock(mtx_);
-#endif //CASADI_WITH_THREAD
-    return mem_.at(ind);
+    casadi_assert(ind>=0 && ind<n_mem_.load(std::memory_order_acquire),
+      "Memory object " + str(ind) + " does not exist");
+    return mem_slot(ind).mem;
   }
 
   int ProtoFunction::checkout() const {
+    // Pop an unused memory object off the free list
+    uint64_t top = unused_.load(std::memory_order_acquire);
+    while (top & 0xffffffff) {
+      int ind = static_cast<int>(top & 0xffffffff) - 1;
+      uint64_t next = ((top >> 32) + 1) << 32
+        | static_cast<uint32_t>(mem_slot(ind).next.load(std::memory_order_relaxed) + 1);
+      if (unused_.compare_exchange_weak(top, next,
+          std::memory_order_acquire, std::memory_order_acquire)) return ind;
+    }
+    // Allocate a new memory object
+    void* m = alloc_mem();
+    int ind;
+    {
 #ifdef CASADI_WITH_THREAD
-    std::lock_guard<std::mutex> lock(mtx_);
+      std::lock_guard<std::mutex> lock(mtx_);
 #endif //CASADI_WITH_THREAD
-    if (unused_.empty()) {
-      // Allocate a new memory object
-      void* m = alloc_mem();
-      mem_.push_back(m);
-      if (init_mem(m)) {
-        casadi_error("Failed to create or initialize memory object");
-      }
-      return mem_.size()-1;
-    } else {
-      // Use an unused memory object
-      casadi_int m = unused_.top();
-      unused_.pop();
-      return m;
+      ind = n_mem_.load(std::memory_order_relaxed);
+      // Allocate a new block, if needed
+      unsigned int b = (static_cast<unsigned int>(ind) >> 4) + 1;
+      int k = 0;
+      while (b >> (k+1)) k++;
+      casadi_assert(k<n_mem_block, "Too many memory objects");
+      if (mem_[k].load(std::memory_order_relaxed)==nullptr) {
+        mem_[k].store(new MemSlot[16 << k], std::memory_order_release);
+      }
+      mem_slot(ind).mem = m;
+      n_mem_.store(ind+1, std::memory_order_release);
     }
+    if (init_mem(m)) {
+      casadi_error("Failed to create or initialize memory object");
+    }
+    return ind;
   }
 
   void ProtoFunction::release(int mem) const {
-#ifdef CASADI_WITH_THREAD
-    std::lock_guard<std::mutex> lock(mtx_);
-#endif //CASADI_WITH_THREAD
-    unused_.push(mem);
+    // Push onto the free list
+    MemSlot& s = mem_slot(mem);
+    uint64_t top = unused_.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+      s.next.store(static_cast<int>(top & 0xffffffff) - 1, std::memory_order_relaxed);
+      next = ((top >> 32) + 1) << 32 | static_cast<uint32_t>(mem + 1);
+    } while (!unused_.compare_exchange_weak(top, next,
+             std::memory_order_release, std::memory_order_relaxed));
   }
 
   Function FunctionInternal::
@@ -3511,6 +4078,9 @@ namespace casadi {
 
     s.unpack("ProtoFunction::print_time", print_time_);
     s.unpack("ProtoFunction::record_time", record_time_);
+    for (auto&& b : mem_) b = nullptr;
+    n_mem_ = 0;
+    unused_ = 0;
   }
 
   void FunctionInternal::serialize_type(SerializingStream &s) const {
@@ -3519,7 +4089,7 @@ namespace casadi {
 
   void FunctionInternal::serialize_body(SerializingStream& s) const {
     ProtoFunction::serialize_body(s);
-    s.version("FunctionInternal", 1);
+    s.version("FunctionInternal", 3);
     s.pack("FunctionInternal::is_diff_in", is_diff_in_);
     s.pack("FunctionInternal::is_diff_out", is_diff_out_);
     s.pack("FunctionInternal::sp_in", sparsity_in_);
@@ -3532,6 +4102,9 @@ namespace casadi {
     s.pack("FunctionInternal::jit_temp_suffix", jit_temp_suffix_);
     s.pack("FunctionInternal::jit_base_name", jit_base_name_);
     s.pack("FunctionInternal::jit_options", jit_options_);
+    s.pack("FunctionInternal::jit_codegen_options", jit_codegen_options_);
+    s.pack("FunctionInternal::jit_tiered", jit_tiered_);
+    s.pack("FunctionInternal::jit_threshold", jit_threshold_);
     s.pack("FunctionInternal::compiler_plugin", compiler_plugin_);
     s.pack("FunctionInternal::has_refcount", has_refcount_);
 
@@ -3583,7 +4156,7 @@ namespace casadi {
   }
 
   FunctionInternal::FunctionInternal(DeserializingStream& s) : ProtoFunction(s) {
-    s.version("FunctionInternal", 1);
+    s.version("FunctionInternal", 3);
     s.unpack("FunctionInternal::is_diff_in", is_diff_in_);
     s.unpack("FunctionInternal::is_diff_out", is_diff_out_);
     s.unpack("FunctionInternal::sp_in", sparsity_in_);
@@ -3596,6 +4169,9 @@ namespace casadi {
     s.unpack("FunctionInternal::jit_temp_suffix", jit_temp_suffix_);
     s.unpack("FunctionInternal::jit_base_name", jit_base_name_);
     s.unpack("FunctionInternal::jit_options", jit_options_);
+    s.unpack("FunctionInternal::jit_codegen_options", jit_codegen_options_);
+    s.unpack("FunctionInternal::jit_tiered", jit_tiered_);
+    s.unpack("FunctionInternal::jit_threshold", jit_threshold_);
     s.unpack("FunctionInternal::compiler_plugin", compiler_plugin_);
     s.unpack("FunctionInternal::has_refcount", has_refcount_);
 
@@ -3651,6 +4227,10 @@ namespace casadi {
 
     n_in_ = sparsity_in_.size();
     n_out_ = sparsity_out_.size();
+    jit_lowered_ = false;
+    jit_calls_ = 0;
+    jit_tier_ = 0;
+    t_jit_ = 0;
     eval_ = nullptr;
     checkout_ = nullptr;
     release_ = nullptr;
@@ -42,6 +42,16 @@
 #include <mutex>
 #endif // CASADI_WITH_THREAD_MINGW
 #endif //CASADI_WITH_THREAD
+#ifdef CASADI_WITH_THREAD
+#ifdef CASADI_WITH_THREAD_MINGW
+#include <mingw.thread.h>
+#else // CASADI_WITH_THREAD_MINGW
+#include <thread>
+#endif // CASADI_WITH_THREAD_MINGW
+#endif //CASADI_WITH_THREAD
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
 // This macro is for documentation purposes
 #define INPUTSCHEME(name)
@@ -190,11 +200,28 @@ namespace casadi {
 #endif // CASADI_WITH_THREAD
 
   private:
-    /// Memory objects
-    mutable std::vector<void*> mem_;
+    /// Memory object entry, linked into the free list when unused
+    struct MemSlot {
+      void* mem;
+      std::atomic<int> next;
+    };
+
+    /// Number of memory blocks, block k holds 16*2^k memory objects
+    static const int n_mem_block = 27;
+
+    /// Get a memory object entry
+    MemSlot& mem_slot(int ind) const;
+
+    /// Memory objects, in blocks that never move so that lookup is lock-free
+    mutable std::atomic<MemSlot*> mem_[n_mem_block];
 
-    /// Unused memory objects
-    mutable std::stack<casadi_int> unused_;
+    /// Number of memory objects
+    mutable std::atomic<int> n_mem_;
+
+    /** \brief Unused memory objects
+        Lock-free stack: index+1 of the top in the lower 32 bits (0 if empty)
+        and a counter in the upper 32 bits guarding against ABA */
+    mutable std::atomic<uint64_t> unused_;
   };
 
   /** \brief Internal class for Function
@@ -228,6 +255,31 @@ namespace casadi {
     /** \brief Finalize the object creation */
     void finalize() override;
 
+    /** \brief Just-in-time compile the function, redirecting evaluation to the result */
+    void jit_compile();
+
+    /** \brief Generate the C code for jit_compile, with the file names used */
+    std::string jit_generate(std::string& jit_name, std::vector<std::string>& jit_sources) const;
+
+    /** \brief Redirect evaluation to a compiled function, thread-safe */
+    void jit_publish(const std::string& jit_name, const std::vector<std::string>& jit_sources,
+                     bool jit_lowered, Importer& compiler);
+
+    /** \brief Start compiling in the background, cf. 'jit_tiered' */
+    void jit_tier_up() const;
+
+    ///@{
+    /** \brief End of a tiered compilation, cf. jit_tier_up */
+    void jit_done(std::chrono::steady_clock::time_point t0) const;
+    void jit_fail(const std::string& msg, std::chrono::steady_clock::time_point t0) const;
+    ///@}
+
+    /** \brief Warn about a failed tiered compilation, once */
+    void jit_report() const;
+
+    /// Get all statistics
+    Dict get_stats(void* mem) const override;
+
     /** \brief Get a public class instance */
     Function self() const { return shared_from_this<Function>();}
 
@@ -283,6 +335,25 @@ namespace casadi {
     virtual bool has_eval_dm() const { return false;}
     ///@}
 
+    ///@{
+    /** \brief Evaluate numerically at a batch of points
+
+        The nonzeros of each point are stored consecutively, as for Map:
+        nonzero k of input i at point j is found at arg[i][j*nnz_in(i)+k].
+        The work vector must have length sz_w_batch().
+    */
+    virtual int eval_batch(const double** arg, double** res, casadi_int* iw, double* w,
+                           void* mem, casadi_int n) const;
+    virtual bool has_eval_batch() const { return false;}
+    virtual size_t sz_w_batch() const { return 0;}
+    ///@}
+
+    /** \brief Can eval_batch replace a call to eval_gen per point
+
+        Not if eval_gen redirects the evaluation (jit) or adds to it (dump, print, timing).
+    */
+    bool can_eval_batch() const;
+
     ///@{
     /** \brief Evaluate a function, overloaded */
     int eval_gen(const SXElem** arg, SXElem** res, casadi_int* iw, SXElem* w, void* mem) const {
@@ -293,6 +364,14 @@ namespace casadi {
     }
     ///@}
 
+    /** \brief Evaluate numerically with dict arguments, without converting them
+     *
+     * Requires inputs with the exact input sparsity, or missing with default zero,
+     * and results already allocated with all outputs, e.g. by an earlier call.
+     * Returns false, without evaluating, otherwise.
+     */
+    bool call_direct(const DMDict& arg, DMDict& res) const;
+
     ///@{
     /** \brief Call a function, overloaded */
     void call_gen(const MXVector& arg, MXVector& res, casadi_int npar,
@@ -606,12 +685,27 @@ namespace casadi {
     /** \brief Code generate the function  */
     std::string signature(const std::string& fname) const;
 
+    /** \brief Code generate the batched variant of the function, cf. eval_batch */
+    void codegen_batch(CodeGenerator& g, const std::string& fname) const;
+
+    /** \brief Signature of the batched variant of the function */
+    std::string signature_batch(const std::string& fname) const;
+
+    /** \brief Generate code for the body of the batched variant */
+    virtual void codegen_batch_body(CodeGenerator& g) const;
+
+    /** \brief Is codegen of a batched variant supported? */
+    virtual bool has_codegen_batch() const { return false;}
+
     /** \brief Generate code for the declarations of the C function */
     virtual void codegen_declarations(CodeGenerator& g) const;
 
     /** \brief Generate code for the function body */
     virtual void codegen_body(CodeGenerator& g) const;
 
+    /** \brief Work vector length in generated code */
+    virtual casadi_int codegen_sz_w(const CodeGenerator& g) const { return sz_w();}
+
     /** \brief Thread-local memory object type */
     virtual std::string codegen_mem_type() const { return ""; }
 
@@ -796,6 +890,18 @@ namespace casadi {
     /** \brief  Propagate sparsity backwards */
     virtual int sp_reverse(bvec_t** arg, bvec_t** res, casadi_int* iw, bvec_t* w, void* mem) const;
 
+    ///@{
+    /** \brief  Propagate sparsity with nw consecutive bvec_t words per nonzero
+
+        The work vector must have length nw*sz_w().
+    */
+    virtual int sp_forward_wide(const bvec_t** arg, bvec_t** res,
+                                casadi_int* iw, bvec_t* w, void* mem, casadi_int nw) const;
+    virtual int sp_reverse_wide(bvec_t** arg, bvec_t** res,
+                                casadi_int* iw, bvec_t* w, void* mem, casadi_int nw) const;
+    virtual bool has_sp_wide() const { return false;}
+    ///@}
+
     /** \brief Get number of temporary variables needed */
     void sz_work(size_t& sz_arg, size_t& sz_res, size_t& sz_iw, size_t& sz_w) const;
 
@@ -847,7 +953,8 @@ namespace casadi {
     virtual Dict info() const;
 
     /** \brief Generate/retrieve cached serial map */
-    Function map(casadi_int n, const std::string& parallelization) const;
+    Function map(casadi_int n, const std::string& parallelization,
+                 const Dict& opts=Dict()) const;
 
     /** \brief Export an input file that can be passed to generate C code with a main */
     void generate_in(const std::string& fname, const double** arg) const;
@@ -881,8 +988,39 @@ namespace casadi {
     /** \brief Use a temporary name */
     bool jit_temp_suffix_;
 
-    /** \brief Numerical evaluation redirected to a C function */
-    eval_t eval_;
+    /** \brief Additional jit source files, e.g. split function bodies */
+    std::vector<std::string> jit_sources_;
+
+    /** \brief Compiled in memory, without C sources to clean up */
+    bool jit_lowered_;
+
+    /** \brief Start in the interpreter, compile in the background when hot */
+    bool jit_tiered_;
+
+    /** \brief Number of interpreted calls before compiling, cf. 'jit_tiered' */
+    casadi_int jit_threshold_;
+
+    /** \brief Number of interpreted calls, cf. 'jit_tiered' */
+    mutable std::atomic<casadi_int> jit_calls_;
+
+    /** \brief Tiered compilation: 0 interpreted, 1 compiling, 2 compiled, 3 failed,
+        4 failed and reported */
+    mutable std::atomic<int> jit_tier_;
+
+    /** \brief Wall time of the background compilation [s], guarded by mtx_ */
+    mutable double t_jit_;
+
+    /** \brief Error message of a failed background compilation, guarded by mtx_ */
+    mutable std::string jit_error_;
+
+#ifdef CASADI_WITH_THREAD
+    /** \brief Background compilation, cf. 'jit_tiered' */
+    mutable std::thread jit_thread_;
+#endif // CASADI_WITH_THREAD
+
+    /** \brief Numerical evaluation redirected to a C function,
+        may be swapped in by a background compilation */
+    std::atomic<eval_t> eval_;
 
     /** \brief Checkout redirected to a C function */
     casadi_checkout_t checkout_;
@@ -915,6 +1053,7 @@ namespace casadi {
     std::string compiler_plugin_;
     Importer compiler_;
     Dict jit_options_;
+    Dict jit_codegen_options_;
 
     /// Penalty factor for using a complete Jacobian to calculate directional derivatives
     double jac_penalty_;
@@ -1024,7 +1163,56 @@ namespace casadi {
     size_t sz_arg_tmp_, sz_res_tmp_, sz_iw_tmp_, sz_w_tmp_;
   };
 
+  /** \brief Work vectors for a call, with zeroed argument and result pointers */
+  template<typename D>
+  class CallBuffer {
+  public:
+    /** \brief Allocate for a function */
+    explicit CallBuffer(const FunctionInternal& f);
+
+    /// Work vectors
+    const D** arg;
+    D** res;
+    casadi_int* iw;
+    D* w;
+  private:
+    std::vector<const D*> arg_;
+    std::vector<D*> res_;
+    std::vector<casadi_int> iw_;
+    std::vector<D> w_;
+  };
+
+  /** \brief Numerical work vectors for a call, reused between calls on the same thread
+   *
+   * Calls are allocation-free once the buffers have grown to the largest function
+   * called. Nested calls, e.g. from callbacks, get a buffer of their own.
+   */
+  template<>
+  class CASADI_EXPORT CallBuffer<double> {
+  public:
+    /** \brief Check out for a function */
+    explicit CallBuffer(const FunctionInternal& f);
+
+    /** \brief Release */
+    ~CallBuffer();
+
+    /// Work vectors
+    const double** arg;
+    double** res;
+    casadi_int* iw;
+    double* w;
+  };
+
   // Template implementations
+  template<typename D>
+  CallBuffer<D>::CallBuffer(const FunctionInternal& f)
+    : arg_(f.sz_arg()), res_(f.sz_res()), iw_(f.sz_iw()), w_(f.sz_w()) {
+    arg = get_ptr(arg_);
+    res = get_ptr(res_);
+    iw = get_ptr(iw_);
+    w = get_ptr(w_);
+  }
+
   template<typename MatType>
   bool FunctionInternal::purgable(const std::vector<MatType>& v) {
     for (auto i=v.begin(); i!=v.end(); ++i) {
@@ -1183,13 +1371,19 @@ namespace casadi {
   call_gen(const std::vector<Matrix<D> >& arg, std::vector<Matrix<D> >& res,
            casadi_int npar, bool always_inline, bool never_inline) const {
     casadi_assert(!never_inline, "Call-nodes only possible in MX expressions");
-    std::vector< Matrix<D> > arg2 = project_arg(arg, npar);
 
-    // Which arguments require mapped evaluation
-    std::vector<bool> mapped(n_in_);
-    for (casadi_int i=0; i<n_in_; ++i) {
-      mapped[i] = arg[i].size2()!=size2_in(i);
+    // Project inputs, copying them only if needed
+    bool project = false;
+    for (casadi_int i=0; i<n_in_ && !project; ++i) {
+      if (arg[i].size2()!=size2_in(i)) {
+        project = !arg[i].sparsity().is_stacked(sparsity_in(i), npar);
+      } else {
+        project = arg[i].sparsity()!=sparsity_in(i);
+      }
     }
+    std::vector< Matrix<D> > arg_proj;
+    if (project) arg_proj = project_arg(arg, npar);
+    const std::vector< Matrix<D> >& arg2 = project ? arg_proj : arg;
 
     // Allocate results
     res.resize(n_out_);
@@ -1199,29 +1393,27 @@ namespace casadi {
       }
     }
 
-    // Allocate temporary memory if needed
-    std::vector<casadi_int> iw_tmp(sz_iw());
-    std::vector<D> w_tmp(sz_w());
+    // Work vectors
+    CallBuffer<D> buf(*this);
 
     // Get pointers to input arguments
-    std::vector<const D*> argp(sz_arg());
-    for (casadi_int i=0; i<n_in_; ++i) argp[i]=get_ptr(arg2[i]);
+    for (casadi_int i=0; i<n_in_; ++i) buf.arg[i]=get_ptr(arg2[i]);
 
     // Get pointers to output arguments
-    std::vector<D*> resp(sz_res());
-    for (casadi_int i=0; i<n_out_; ++i) resp[i]=get_ptr(res[i]);
+    for (casadi_int i=0; i<n_out_; ++i) buf.res[i]=get_ptr(res[i]);
 
     // For all parallel calls
     for (casadi_int p=0; p<npar; ++p) {
       // Call memory-less
-      if (eval_gen(get_ptr(argp), get_ptr(resp),
-                   get_ptr(iw_tmp), get_ptr(w_tmp), memory(0))) {
+      if (eval_gen(buf.arg, buf.res, buf.iw, buf.w, memory(0))) {
         casadi_error("Evaluation failed");
       }
       // Update offsets
       if (p==npar-1) break;
-      for (casadi_int i=0; i<n_in_; ++i) if (mapped[i]) argp[i] += nnz_in(i);
-      for (casadi_int i=0; i<n_out_; ++i) resp[i] += nnz_out(i);
+      for (casadi_int i=0; i<n_in_; ++i) {
+        if (arg[i].size2()!=size2_in(i)) buf.arg[i] += nnz_in(i);
+      }
+      for (casadi_int i=0; i<n_out_; ++i) buf.res[i] += nnz_out(i);
     }
   }
 
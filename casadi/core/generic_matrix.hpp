@@ -745,6 +745,20 @@ namespace casadi {
       shared(ex_output, v, vdef, v_prefix, v_suffix);
     }
 
+    ///@{
+    /** \brief Common subexpression elimination
+
+        Structurally equal subexpressions are merged into a single node,
+        taking commutativity of e.g. addition and multiplication into account.
+    */
+    inline friend MatType cse(const MatType& e) {
+      return MatType::cse(e);
+    }
+    inline friend std::vector<MatType> cse(const std::vector<MatType>& e) {
+      return MatType::cse(e);
+    }
+    ///@}
+
     /** \brief Given a repeated matrix, computes the sum of repeated parts
      */
     inline friend MatType repsum(const MatType &A, casadi_int n, casadi_int m=1) {
@@ -39,4 +39,15 @@ namespace casadi {
   // By default, use zero-based indexing
   casadi_int GlobalOptions::start_index = 0;
 
+  // Size of the thread pool, 0 for automatic
+  casadi_int GlobalOptions::thread_pool_size = 0;
+
+  bool GlobalOptions::thread_pool_bind = false;
+
+  // Number of bvec_t words per nonzero in Jacobian sparsity sweeps
+  casadi_int GlobalOptions::sparsity_lanes = 4;
+
+  // Number of threads for Jacobian sparsity sweeps, 0 for automatic
+  casadi_int GlobalOptions::sparsity_threads = 1;
+
 } // namespace casadi
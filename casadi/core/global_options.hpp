@@ -68,6 +68,14 @@ namespace casadi {
 
       static casadi_int start_index;
 
+      static casadi_int thread_pool_size;
+
+      static bool thread_pool_bind;
+
+      static casadi_int sparsity_lanes;
+
+      static casadi_int sparsity_threads;
+
 #endif //SWIG
       // Setter and getter for simplification_on_the_fly
       static void setSimplificationOnTheFly(bool flag) { simplification_on_the_fly = flag; }
@@ -86,6 +94,35 @@ namespace casadi {
       static void setMaxNumDir(casadi_int ndir) { max_num_dir=ndir; }
       static casadi_int getMaxNumDir() { return max_num_dir; }
 
+      /** \brief Number of worker threads in the persistent pool used by "thread" maps
+      * The pool grows lazily to this size, it never shrinks.
+      * Default: 0 (one less than the number of hardware threads)
+      */
+      static void setThreadPoolSize(casadi_int n) { thread_pool_size=n; }
+      static casadi_int getThreadPoolSize() { return thread_pool_size; }
+
+      /** \brief Bind pool worker threads to cores (Linux only)
+      * Only affects workers spawned after the call.
+      * Default: false
+      */
+      static void setThreadPoolBind(bool flag) { thread_pool_bind=flag; }
+      static bool getThreadPoolBind() { return thread_pool_bind; }
+
+      /** \brief Number of bvec_t words propagated per sweep in Jacobian sparsity detection
+      * Only used by functions supporting wide propagation, e.g. SXFunction.
+      * Default: 4 (256 directions per sweep)
+      */
+      static void setSparsityLanes(casadi_int n) { sparsity_lanes=n; }
+      static casadi_int getSparsityLanes() { return sparsity_lanes; }
+
+      /** \brief Number of threads sharing the sweeps of Jacobian sparsity detection
+      * 0 means the calling thread plus the workers of the thread pool.
+      * With more than one thread, called functions propagate sparsity concurrently.
+      * Default: 1 (calling thread only)
+      */
+      static void setSparsityThreads(casadi_int n) { sparsity_threads=n; }
+      static casadi_int getSparsityThreads() { return sparsity_threads; }
+
   };
 
 } // namespace casadi
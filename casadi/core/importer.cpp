@@ -97,6 +97,10 @@ namespace casadi {
     return (*this)->body(symname);
   }
 
+  Dict Importer::stats() const {
+    return (*this)->get_stats();
+  }
+
   void Importer::serialize(SerializingStream &s) const {
     return (*this)->serialize(s);
   }
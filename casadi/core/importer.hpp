@@ -138,6 +138,9 @@ namespace casadi {
     /// Get the function body, if inlined
     std::string body(const std::string& symname) const;
 
+    /// Get compilation statistics, e.g. hits and misses of a compiler cache
+    Dict stats() const;
+
 #ifndef SWIG
     /** Convert indexed command */
     static inline std::string indexed(const std::string& cmd, casadi_int ind) {
@@ -35,6 +35,15 @@ namespace casadi {
   ImporterInternal::~ImporterInternal() {
   }
 
+  bool ImporterInternal::has_lowering(const std::string& compiler) {
+    if (compiler=="none" || compiler=="dll") return false;
+    return getPlugin(compiler).exposed.lowers;
+  }
+
+  void ImporterInternal::lower(const Function& f, const std::string& symname) {
+    casadi_error("'lower' not defined for " + class_name());
+  }
+
   void ImporterInternal::disp(ostream &stream, bool more) const {
   }
 
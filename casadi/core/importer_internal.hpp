@@ -76,8 +76,15 @@ namespace casadi {
 
     virtual void finalize() {}
 
-    // No static functions exposed
-    struct Exposed{ };
+    // Exposed static properties
+    struct Exposed{
+      /// Compiles expression graphs in memory, cf. lower(), rather than C sources
+      bool lowers;
+      Exposed() : lowers(false) {}
+    };
+
+    /// Does a compiler plugin compile expression graphs in memory?
+    static bool has_lowering(const std::string& compiler);
 
     /// Collection of solvers
     static std::map<std::string, Plugin> solvers_;
@@ -97,6 +104,9 @@ namespace casadi {
     /// Get a function pointer for numerical evaluation
     bool has_function(const std::string& symname) const;
 
+    /// Compile a function directly from its expression graph, without generating C code
+    virtual void lower(const Function& f, const std::string& symname);
+
     /** \brief Does an entry exist? */
     bool has_meta(const std::string& cmd, casadi_int ind=-1) const;
 
@@ -119,6 +129,9 @@ namespace casadi {
     /// Can meta information be read?
     virtual bool can_have_meta() const { return true;}
 
+    /// Get compilation statistics
+    virtual Dict get_stats() const { return Dict();}
+
     /** \brief Get entry as a text */
     std::string to_text(const std::string& cmd, casadi_int ind=-1) const;
 
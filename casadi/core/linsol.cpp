@@ -111,6 +111,9 @@ namespace casadi {
     if (A==nullptr) return 1;
     auto m = static_cast<LinsolMemory*>((*this)->memory(mem));
 
+    // Keep the current factorization if it can be reused
+    if ((*this)->can_reuse(m, A)) return 0;
+
     // Factorization will be needed after this step
     m->is_sfact = m->is_nfact = false;
 
@@ -138,11 +141,16 @@ namespace casadi {
       if (sfact(A, mem)) return 1;
     }
 
-    m->is_nfact = false;
+    // Reuse the current factorization, refining the solutions unless A is unchanged
+    if ((*this)->can_reuse(m, A)) {
+      m->is_stale = !std::equal(A, A + (*this)->nnz(), m->A_fact.begin());
+      m->n_reuse++;
+      return 0;
+    }
+
     if (m->t_total) m->fstats.at("nfact").tic();
-    if ((*this)->nfact(m, A)) return 1;
+    if ((*this)->refactor(m, A)) return 1;
     if (m->t_total) m->fstats.at("nfact").toc();
-    m->is_nfact = true;
     return 0;
   }
 
@@ -172,7 +180,8 @@ namespace casadi {
     auto m = static_cast<LinsolMemory*>((*this)->memory(mem));
     casadi_assert(m->is_nfact, "Linear system has not been factorized");
     if (m->t_total) m->fstats.at("solve").tic();
-    int ret = (*this)->solve(m, A, x, nrhs, tr);
+    int ret = m->is_stale ? (*this)->solve_refine(m, A, x, nrhs, tr)
+                          : (*this)->solve(m, A, x, nrhs, tr);
     if (m->t_total) m->fstats.at("solve").toc();
     return ret;
   }
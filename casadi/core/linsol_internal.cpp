@@ -30,15 +30,42 @@ namespace casadi {
 
   LinsolInternal::LinsolInternal(const std::string& name, const Sparsity& sp)
    : ProtoFunction(name), sp_(sp) {
+    refactor_tol_ = -1;
+    max_refine_ = 5;
   }
 
   LinsolInternal::~LinsolInternal() {
   }
 
+  const Options LinsolInternal::options_
+  = {{&ProtoFunction::options_},
+     {{"refactor_tol",
+       {OT_DOUBLE,
+        "Keep the current factorization if the nonzeros of the matrix differ from those "
+        "of the factorized matrix by at most refactor_tol, relative to its largest entry, "
+        "and refine the solutions iteratively instead, refactorizing if the refinement "
+        "does not converge. Zero only skips the factorization of identical matrices, a "
+        "negative value disables reuse. Note that neig and rank refer to the factorized "
+        "matrix [default: -1]"}},
+      {"max_refine",
+       {OT_INT,
+        "Maximum number of iterative refinement steps when solving with the factorization "
+        "of a different matrix [default: 5]"}}
+     }
+  };
+
   void LinsolInternal::init(const Dict& opts) {
     // Call the base class initializer
     ProtoFunction::init(opts);
 
+    // Read options
+    for (auto&& op : opts) {
+      if (op.first=="refactor_tol") {
+        refactor_tol_ = op.second;
+      } else if (op.first=="max_refine") {
+        max_refine_ = op.second;
+      }
+    }
   }
 
   void LinsolInternal::disp(ostream &stream, bool more) const {
@@ -70,6 +97,110 @@ namespace casadi {
     casadi_error("'solve' not defined for " + class_name());
   }
 
+  bool LinsolInternal::can_reuse(void* mem, const double* A) const {
+    auto m = static_cast<LinsolMemory*>(mem);
+    if (!m->is_nfact || m->A_fact.empty()) return false;
+    // Largest change relative to the largest entry of the factorized matrix
+    const double* A0 = get_ptr(m->A_fact);
+    casadi_int nnz = this->nnz();
+    double dmax = 0, amax = 0;
+    for (casadi_int k=0; k<nnz; ++k) {
+      dmax = std::max(dmax, fabs(A[k] - A0[k]));
+      amax = std::max(amax, fabs(A0[k]));
+    }
+    return dmax <= refactor_tol_ * amax;
+  }
+
+  int LinsolInternal::refactor(void* mem, const double* A) const {
+    auto m = static_cast<LinsolMemory*>(mem);
+    m->is_nfact = false;
+    if (nfact(mem, A)) return 1;
+    m->is_nfact = true;
+    m->is_stale = false;
+    m->n_nfact++;
+    if (refactor_tol_>=0) m->A_fact.assign(A, A + nnz());
+    return 0;
+  }
+
+  double LinsolInternal::backward_error(void* mem, const double* A, const double* x,
+                                        casadi_int nrhs, bool tr) const {
+    auto m = static_cast<LinsolMemory*>(mem);
+    casadi_int n = nrow();
+    const casadi_int *colind = this->colind(), *row = this->row();
+    // Residual r = op(A)*x - b, componentwise backward error max |r| / (|op(A)|*|x| + |b|)
+    double berr = 0;
+    for (casadi_int j=0; j<nrhs; ++j) {
+      const double *xj = x + j*n, *bj = get_ptr(m->b) + j*n;
+      double *rj = get_ptr(m->r) + j*n, *s = get_ptr(m->s);
+      for (casadi_int i=0; i<n; ++i) {
+        rj[i] = -bj[i];
+        s[i] = fabs(bj[i]);
+      }
+      for (casadi_int c=0; c<n; ++c) {
+        if (tr) {
+          for (casadi_int k=colind[c]; k<colind[c+1]; ++k) {
+            double e = A[k]*xj[row[k]];
+            rj[c] += e;
+            s[c] += fabs(e);
+          }
+        } else {
+          for (casadi_int k=colind[c]; k<colind[c+1]; ++k) {
+            double e = A[k]*xj[c];
+            rj[row[k]] += e;
+            s[row[k]] += fabs(e);
+          }
+        }
+      }
+      for (casadi_int i=0; i<n; ++i) {
+        if (s[i]>0) {
+          berr = std::max(berr, fabs(rj[i])/s[i]);
+        } else if (rj[i]!=0) {
+          berr = numeric_limits<double>::infinity();
+        }
+      }
+    }
+    return berr;
+  }
+
+  int LinsolInternal::solve_refine(void* mem, const double* A, double* x, casadi_int nrhs,
+                                   bool tr) const {
+    auto m = static_cast<LinsolMemory*>(mem);
+    casadi_int n = nrow();
+    // Keep the right-hand-sides
+    m->b.assign(x, x + n*nrhs);
+    m->r.resize(n*nrhs);
+    m->s.resize(n);
+    if (solve(mem, A, x, nrhs, tr)) return 1;
+    // Best iterate so far
+    double berr_best = numeric_limits<double>::infinity();
+    for (casadi_int iter=0; ; ++iter) {
+      double berr = backward_error(mem, A, x, nrhs, tr);
+      bool improved = berr < berr_best;
+      if (improved && iter<max_refine_) {
+        m->x_best.assign(x, x + n*nrhs);
+      } else if (!improved) {
+        std::copy(m->x_best.begin(), m->x_best.end(), x);
+      }
+      // Stop at machine precision, if the refinement stagnates or after max_refine steps
+      bool stagnates = berr > 0.5*berr_best;
+      if (improved) berr_best = berr;
+      if (berr_best <= numeric_limits<double>::epsilon() || stagnates || iter==max_refine_) break;
+      // Correct with the solution of op(A_fact)*dx = r
+      if (solve(mem, A, get_ptr(m->r), nrhs, tr)) return 1;
+      for (casadi_int k=0; k<n*nrhs; ++k) x[k] -= m->r[k];
+      m->n_refine++;
+    }
+    // Refactorize if the refinement did not converge, cf. LAPACK's DSGESV
+    if (berr_best > sqrt(static_cast<double>(std::max(n, casadi_int(1))))
+                    * numeric_limits<double>::epsilon()) {
+      if (refactor(mem, A)) return 1;
+      std::copy(m->b.begin(), m->b.end(), x);
+      return solve(mem, A, x, nrhs, tr);
+    }
+    return 0;
+  }
+
+
 #if 0
   casadi_int LinsolInternal::factorize(void* mem, const double* A) const {
     // Symbolic factorization, if needed
@@ -96,6 +227,15 @@ namespace casadi {
   }
 #endif
 
+  Dict LinsolInternal::get_stats(void* mem) const {
+    Dict stats = ProtoFunction::get_stats(mem);
+    auto m = static_cast<LinsolMemory*>(mem);
+    stats["n_nfact"] = m->n_nfact;
+    stats["n_reuse"] = m->n_reuse;
+    stats["n_refine"] = m->n_refine;
+    return stats;
+  }
+
   int LinsolInternal::nfact(void* mem, const double* A) const {
     casadi_error("'nfact' not defined for " + class_name());
   }
@@ -125,11 +265,17 @@ namespace casadi {
 
   void LinsolInternal::serialize_body(SerializingStream &s) const {
     ProtoFunction::serialize_body(s);
+    s.version("LinsolInternal", 1);
     s.pack("LinsolInternal::sp", sp_);
+    s.pack("LinsolInternal::refactor_tol", refactor_tol_);
+    s.pack("LinsolInternal::max_refine", max_refine_);
   }
 
   LinsolInternal::LinsolInternal(DeserializingStream& s) : ProtoFunction(s) {
+    s.version("LinsolInternal", 1);
     s.unpack("LinsolInternal::sp", sp_);
+    s.unpack("LinsolInternal::refactor_tol", refactor_tol_);
+    s.unpack("LinsolInternal::max_refine", max_refine_);
   }
 
   ProtoFunction* LinsolInternal::deserialize(DeserializingStream& s) {
@@ -38,8 +38,21 @@ namespace casadi {
     // Current state of factorization
     bool is_sfact, is_nfact;
 
+    // The factorization is of a different matrix, solves need iterative refinement
+    bool is_stale;
+
+    // Matrix of the current factorization, if it may be reused
+    std::vector<double> A_fact;
+
+    // Right-hand-sides, residuals, scaling and best iterate for iterative refinement
+    std::vector<double> b, r, s, x_best;
+
+    // Number of factorizations, reused factorizations and refinement steps
+    casadi_int n_nfact, n_reuse, n_refine;
+
     // Constructor
-    LinsolMemory() : is_sfact(false), is_nfact(false) {}
+    LinsolMemory() : is_sfact(false), is_nfact(false), is_stale(false),
+      n_nfact(0), n_reuse(0), n_refine(0) {}
   };
 
   /** Internal class
@@ -57,6 +70,12 @@ namespace casadi {
     /** \brief Display object */
     void disp(std::ostream& stream, bool more) const override;
 
+    ///@{
+    /** \brief Options */
+    static const Options options_;
+    const Options& get_options() const override { return options_;}
+    ///@}
+
     /** \brief  Print more */
     virtual void disp_more(std::ostream& stream) const {}
 
@@ -72,6 +91,9 @@ namespace casadi {
     /** \brief Free memory block */
     void free_mem(void *mem) const override { delete static_cast<LinsolMemory*>(mem);}
 
+    /** \brief Get all statistics */
+    Dict get_stats(void* mem) const override;
+
     /// Evaluate SX, possibly transposed
     virtual void linsol_eval_sx(const SXElem** arg, SXElem** res,
                                 casadi_int* iw, SXElem* w, void* mem,
@@ -97,6 +119,23 @@ namespace casadi {
     // Solve numerically
     virtual int solve(void* mem, const double* A, double* x, casadi_int nrhs, bool tr) const;
 
+    /// Can the current factorization be used for A, cf. refactor_tol
+    bool can_reuse(void* mem, const double* A) const;
+
+    /// Numeric factorization, updating the state used for reuse
+    int refactor(void* mem, const double* A) const;
+
+    /// Componentwise backward error of x, residuals in the refinement memory
+    double backward_error(void* mem, const double* A, const double* x,
+                          casadi_int nrhs, bool tr) const;
+
+    /** \brief Solve with a factorization of a different matrix, with iterative refinement
+
+        Returns the iterate with the smallest backward error. The matrix is refactorized if
+        the refinement does not converge.
+    */
+    int solve_refine(void* mem, const double* A, double* x, casadi_int nrhs, bool tr) const;
+
     /// Number of negative eigenvalues
     virtual casadi_int neig(void* mem, const double* A) const;
 
@@ -140,6 +179,12 @@ namespace casadi {
     // Sparsity pattern of the linear system
     Sparsity sp_;
 
+    ///@{
+    // Options
+    double refactor_tol_;
+    casadi_int max_refine_;
+    ///@}
+
   protected:
     /** \brief Deserializing constructor */
     explicit LinsolInternal(DeserializingStream& s);
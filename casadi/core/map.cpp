@@ -25,41 +25,37 @@
 
 #include "map.hpp"
 #include "serializing_stream.hpp"
-
-#ifdef CASADI_WITH_THREAD
-#ifdef CASADI_WITH_THREAD_MINGW
-#include <mingw.thread.h>
-#else // CASADI_WITH_THREAD_MINGW
-#include <thread>
-#endif // CASADI_WITH_THREAD_MINGW
-#endif // CASADI_WITH_THREAD
+#include "thread_pool.hpp"
 
 using namespace std;
 
 namespace casadi {
 
-  Function Map::create(const std::string& parallelization, const Function& f, casadi_int n) {
+  Function Map::create(const std::string& parallelization, const Function& f, casadi_int n,
+                       const Dict& opts) {
     // Create instance of the right class
     string suffix = str(n) + "_" + f.name();
     if (parallelization == "serial") {
-      return Function::create(new Map("map" + suffix, f, n), Dict());
+      return Function::create(new Map("map" + suffix, f, n), opts);
     } else if (parallelization== "openmp") {
-      return Function::create(new OmpMap("ompmap" + suffix, f, n), Dict());
+      return Function::create(new OmpMap("ompmap" + suffix, f, n), opts);
     } else if (parallelization== "thread") {
-      return Function::create(new ThreadMap("threadmap" + suffix, f, n), Dict());
+      return Function::create(new ThreadMap("threadmap" + suffix, f, n), opts);
     } else {
       casadi_error("Unknown parallelization: " + parallelization);
     }
   }
 
   Map::Map(const std::string& name, const Function& f, casadi_int n)
-    : FunctionInternal(name), f_(f), n_(n) {
+    : FunctionInternal(name), f_(f), n_(n), batch_(false) {
   }
 
   void Map::serialize_body(SerializingStream &s) const {
     FunctionInternal::serialize_body(s);
+    s.version("Map", 2);
     s.pack("Map::f", f_);
     s.pack("Map::n", n_);
+    s.pack("Map::batch", batch_);
   }
 
   void Map::serialize_type(SerializingStream &s) const {
@@ -68,8 +64,10 @@ namespace casadi {
   }
 
   Map::Map(DeserializingStream& s) : FunctionInternal(s) {
+    s.version("Map", 2);
     s.unpack("Map::f", f_);
     s.unpack("Map::n", n_);
+    s.unpack("Map::batch", batch_);
   }
 
   ProtoFunction* Map::deserialize(DeserializingStream& s) {
@@ -101,6 +99,10 @@ namespace casadi {
     alloc_res(f_.sz_res());
     alloc_w(f_.sz_w());
     alloc_iw(f_.sz_iw());
+
+    // Evaluate all instances at once if supported, e.g. for SXFunction
+    batch_ = parallelization()=="serial" && f_->can_eval_batch();
+    if (batch_) alloc_w(f_->sz_w_batch());
   }
 
   template<typename T>
@@ -148,10 +150,20 @@ namespace casadi {
   }
 
   void Map::codegen_declarations(CodeGenerator& g) const {
-    g.add_dependency(f_);
+    if (batch_ && g.with_batch && f_->has_codegen_batch()) {
+      g.add_batch_dependency(f_);
+    } else {
+      g.add_dependency(f_);
+    }
   }
 
   void Map::codegen_body(CodeGenerator& g) const {
+    // Evaluate all points in one call to the batched variant, if available
+    if (batch_ && g.with_batch && f_->has_codegen_batch()) {
+      g << "if (" << g(f_, "arg", "res", "iw", "w", str(n_)) << ") return 1;\n";
+      return;
+    }
+
     g.local("i", "casadi_int");
     g.local("arg1", "const casadi_real*", "*");
     g.local("res1", "casadi_real*", "*");
@@ -281,6 +293,7 @@ namespace casadi {
   }
 
   int Map::eval(const double** arg, double** res, casadi_int* iw, double* w, void* mem) const {
+    if (batch_) return f_->eval_batch(arg, res, iw, w, nullptr, n_);
     // This checkout/release dance is an optimization.
     // Could also use the thread-safe variant f_(arg1, res1, iw, w)
     // in Map::eval_gen
@@ -307,7 +320,7 @@ namespace casadi {
     for (casadi_int i=0; i<n_; ++i) ind.emplace_back(f_);
 
     // Evaluate in parallel
-#pragma omp parallel for reduction(||:flag)
+#pragma omp parallel for schedule(dynamic) reduction(||:flag)
     for (casadi_int i=0; i<n_; ++i) {
       // Input buffers
       const double** arg1 = arg + n_in_ + i*sz_arg;
@@ -346,7 +359,7 @@ namespace casadi {
       << "const double** arg1;\n"
       << "double** res1;\n"
       << "casadi_int flag = 0;\n"
-      << "#pragma omp parallel for private(i,arg1,res1) reduction(||:flag)\n"
+      << "#pragma omp parallel for schedule(dynamic) private(i,arg1,res1) reduction(||:flag)\n"
       << "for (i=0; i<" << n_ << "; ++i) {\n"
       << "arg1 = arg + " << n_in_ << "+i*" << sz_arg << ";\n";
     for (casadi_int j=0; j<n_in_; ++j) {
@@ -383,11 +396,38 @@ namespace casadi {
   }
 
 
+  const Options ThreadMap::options_
+  = {{&FunctionInternal::options_},
+     {{"max_workers",
+       {OT_INT,
+        "Maximum number of concurrent workers, including the calling thread "
+        "[default: thread pool size + 1]"}},
+      {"chunk_size",
+       {OT_INT,
+        "Number of consecutive instances a worker claims at a time. "
+        "Workers that run out of instances steal half of the remaining "
+        "instances of another worker [default: 1]"}}
+     }
+  };
+
+  ThreadMap::ThreadMap(DeserializingStream& s) : Map(s) {
+    s.version("ThreadMap", 1);
+    s.unpack("ThreadMap::max_workers", max_workers_);
+    s.unpack("ThreadMap::chunk_size", chunk_size_);
+  }
+
+  void ThreadMap::serialize_body(SerializingStream &s) const {
+    Map::serialize_body(s);
+    s.version("ThreadMap", 1);
+    s.pack("ThreadMap::max_workers", max_workers_);
+    s.pack("ThreadMap::chunk_size", chunk_size_);
+  }
+
   ThreadMap::~ThreadMap() {
     clear_mem();
   }
 
-  void ThreadsWork(const Function& f, casadi_int i,
+  void ThreadsWork(const Function& f, casadi_int i, casadi_int slot,
       const double** arg, double** res,
       casadi_int* iw, double* w,
       casadi_int ind, int& ret) {
@@ -401,19 +441,19 @@ namespace casadi {
     f.sz_work(sz_arg, sz_res, sz_iw, sz_w);
 
     // Input buffers
-    const double** arg1 = arg + n_in + i*sz_arg;
+    const double** arg1 = arg + n_in + slot*sz_arg;
     for (casadi_int j=0; j<n_in; ++j) {
       arg1[j] = arg[j] ? arg[j] + i*f.nnz_in(j) : nullptr;
     }
 
     // Output buffers
-    double** res1 = res + n_out + i*sz_res;
+    double** res1 = res + n_out + slot*sz_res;
     for (casadi_int j=0; j<n_out; ++j) {
       res1[j] = res[j] ? res[j] + i*f.nnz_out(j) : nullptr;
     }
 
     try {
-      ret = f(arg1, res1, iw + i*sz_iw, w + i*sz_w, ind);
+      ret = f(arg1, res1, iw + slot*sz_iw, w + slot*sz_w, ind);
     } catch (std::exception& e) {
       ret = 1;
       casadi_warning("Exception raised: " + std::string(e.what()));
@@ -429,29 +469,19 @@ namespace casadi {
 #ifndef CASADI_WITH_THREAD
     return Map::eval(arg, res, iw, w, mem);
 #else // CASADI_WITH_THREAD
-    // Checkout memory objects
-    std::vector< scoped_checkout<Function> > ind; ind.reserve(n_);
-    for (casadi_int i=0; i<n_; ++i) ind.emplace_back(f_);
+    // Checkout one memory object per worker
+    std::vector< scoped_checkout<Function> > ind; ind.reserve(max_workers_);
+    for (casadi_int k=0; k<max_workers_; ++k) ind.emplace_back(f_);
 
     // Allocate space for return values
     std::vector<int> ret_values(n_);
 
-    // Spawn threads
-    std::vector<std::thread> threads;
-    for (casadi_int i=0; i<n_; ++i) {
-      // Why the lambda function?
-      // Because it was the first iteration to pass tests on MingGW
-      // using mingw-std-threads.
-      threads.emplace_back(
-        [i](const Function& f, const double** arg, double** res,
-            casadi_int* iw, double* w, casadi_int ind, int& ret) {
-              ThreadsWork(f, i, arg, res, iw, w, ind, ret);
-            },
-        std::ref(f_), arg, res, iw, w, casadi_int(ind[i]), std::ref(ret_values[i]));
-    }
-
-    // Join threads
-    for (auto && th : threads) th.join();
+    // Evaluate on the persistent thread pool
+    auto m = static_cast<ThreadMapMemory*>(mem);
+    ThreadPool::instance().run(n_, max_workers_, chunk_size_,
+      [&](casadi_int i, casadi_int slot) {
+        ThreadsWork(f_, i, slot, arg, res, iw, w, ind[slot], ret_values[i]);
+      }, &m->worker_stats);
 
     // Anticipate success
     int ret = 0;
@@ -463,6 +493,13 @@ namespace casadi {
 #endif // CASADI_WITH_THREAD
   }
 
+  Dict ThreadMap::get_stats(void* mem) const {
+    Dict stats = Map::get_stats(mem);
+    auto m = static_cast<ThreadMapMemory*>(mem);
+    add_worker_stats(stats, m->worker_stats);
+    return stats;
+  }
+
   void ThreadMap::codegen_body(CodeGenerator& g) const {
     Map::codegen_body(g);
   }
@@ -475,14 +512,31 @@ namespace casadi {
     // Call the initialization method of the base class
     Map::init(opts);
 
-    // Allocate memory for holding memory object references
-    alloc_iw(n_, true);
+    // Default options
+    max_workers_ = ThreadPool::target_size() + 1;
+    chunk_size_ = 1;
 
-    // Allocate sufficient memory for parallel evaluation
-    alloc_arg(f_.sz_arg() * n_);
-    alloc_res(f_.sz_res() * n_);
-    alloc_w(f_.sz_w() * n_);
-    alloc_iw(f_.sz_iw() * n_);
+    // Read options
+    for (auto&& op : opts) {
+      if (op.first=="max_workers") {
+        max_workers_ = op.second;
+      } else if (op.first=="chunk_size") {
+        chunk_size_ = op.second;
+      }
+    }
+
+    // Sanity checks
+    casadi_assert(max_workers_>=1, "Option 'max_workers' must be positive");
+    casadi_assert(chunk_size_>=1, "Option 'chunk_size' must be positive");
+
+    // No more workers than instances
+    max_workers_ = std::min(max_workers_, n_);
+
+    // Allocate sufficient memory for parallel evaluation, one buffer per worker
+    alloc_arg(f_.sz_arg() * max_workers_);
+    alloc_res(f_.sz_res() * max_workers_);
+    alloc_w(f_.sz_w() * max_workers_);
+    alloc_iw(f_.sz_iw() * max_workers_);
   }
 
 } // namespace casadi
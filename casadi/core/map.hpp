@@ -27,6 +27,7 @@
 #define CASADI_MAP_HPP
 
 #include "function_internal.hpp"
+#include "thread_pool.hpp"
 
 /// \cond INTERNAL
 
@@ -40,7 +41,7 @@ namespace casadi {
   public:
     // Create function (use instead of constructor)
     static Function create(const std::string& parallelization,
-                           const Function& f, casadi_int n);
+                           const Function& f, casadi_int n, const Dict& opts=Dict());
 
     /** \brief Destructor */
     ~Map() override;
@@ -156,6 +157,9 @@ namespace casadi {
 
     // Number of times to evaluate this function
     casadi_int n_;
+
+    // Evaluate numerically using the batched evaluation of f_
+    bool batch_;
   };
 
   /** A map Evaluate in parallel using OpenMP
@@ -194,9 +198,16 @@ namespace casadi {
     explicit OmpMap(DeserializingStream& s) : Map(s) {}
   };
 
-  /** A map Evaluate in parallel using std::thread
-      Note: Do not use this class with much more than the intended number of
-      threads for the parallel evaluation as it will cause excessive memory use.
+  /** \brief Memory of maps evaluated on the thread pool */
+  struct CASADI_EXPORT ThreadMapMemory : public FunctionMemory {
+    // Statistics of each worker during the last evaluation
+    std::vector<WorkerStats> worker_stats;
+  };
+
+  /** A map Evaluate in parallel using a persistent pool of std::thread workers
+      Work buffers are allocated per worker rather than per instance, such that
+      n may exceed the number of workers by far. Instances are scheduled with
+      work stealing, which keeps all workers busy when instance costs differ.
 
       \author Joris Gillis
       \date 2018
@@ -213,21 +224,45 @@ namespace casadi {
     /** \brief Get type name */
     std::string class_name() const override {return "ThreadMap";}
 
+    ///@{
+    /** \brief Options */
+    static const Options options_;
+    const Options& get_options() const override { return options_;}
+    ///@}
+
     /// Evaluate the function numerically
     int eval(const double** arg, double** res, casadi_int* iw, double* w, void* mem) const override;
 
     /** \brief  Initialize */
     void init(const Dict& opts) override;
 
+    /** \brief Create memory block */
+    void* alloc_mem() const override { return new ThreadMapMemory();}
+
+    /** \brief Free memory block */
+    void free_mem(void *mem) const override { delete static_cast<ThreadMapMemory*>(mem);}
+
+    /// Get all statistics
+    Dict get_stats(void* mem) const override;
+
     /// Type of parallellization
     std::string parallelization() const override { return "thread"; }
 
     /** \brief Generate code for the body of the C function */
     void codegen_body(CodeGenerator& g) const override;
 
+    /** \brief Serialize an object without type information */
+    void serialize_body(SerializingStream &s) const override;
+
   protected:
     /** \brief Deserializing constructor */
-    explicit ThreadMap(DeserializingStream& s) : Map(s) {}
+    explicit ThreadMap(DeserializingStream& s);
+
+    // Maximum number of concurrent workers
+    casadi_int max_workers_;
+
+    // Number of consecutive instances handed out to a worker at a time
+    casadi_int chunk_size_;
   };
 
 } // namespace casadi
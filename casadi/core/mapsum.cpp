@@ -51,6 +51,10 @@ namespace casadi {
         f->tocache(ret, suffix);
       }
       return ret.wrap_as_needed(opts);
+    } else if (parallelization == "thread") {
+      return Function::create(new ThreadMapSum(name, f, n, reduce_in, reduce_out), opts);
+    } else if (parallelization == "openmp") {
+      return Function::create(new OmpMapSum(name, f, n, reduce_in, reduce_out), opts);
     } else {
       casadi_error("Unknown parallelization: " + parallelization);
     }
@@ -89,6 +93,10 @@ namespace casadi {
     s.unpack("MapSum::class_name", class_name);
     if (class_name=="MapSum") {
       return new MapSum(s);
+    } else if (class_name=="ThreadMapSum") {
+      return new ThreadMapSum(s);
+    } else if (class_name=="OmpMapSum") {
+      return new OmpMapSum(s);
     } else {
       casadi_error("class name '" + class_name + "' unknown.");
     }
@@ -399,4 +407,347 @@ namespace casadi {
     return eval_gen(arg, res, iw, w, m);
   }
 
+  casadi_int MapSum::nnz_reduce() const {
+    casadi_int nnz = 0;
+    for (casadi_int j=0; j<n_out_; ++j) {
+      if (reduce_out_[j]) nnz += f_.nnz_out(j);
+    }
+    return nnz;
+  }
+
+  int MapSum::eval_block(casadi_int b, casadi_int n_block, casadi_int slot,
+                         const double** arg, double** res, casadi_int* iw, double* w,
+                         casadi_int mem) const {
+    // Function work sizes
+    size_t sz_arg, sz_res, sz_iw, sz_w;
+    f_.sz_work(sz_arg, sz_res, sz_iw, sz_w);
+    casadi_int nnz_red = nnz_reduce();
+
+    // Accumulator of the block, work vector and scratch space of the slot
+    double* w_acc = w + b*nnz_red;
+    double* w1 = w + n_block*nnz_red + slot*(sz_w + nnz_red);
+    double* w_scratch = w1 + sz_w;
+
+    // Buffers of the slot
+    const double** arg1 = arg + n_in_ + slot*sz_arg;
+    double** res1 = res + n_out_ + slot*sz_res;
+    casadi_int* iw1 = iw + slot*sz_iw;
+
+    // Evaluate the instances of the block in order
+    for (casadi_int i=b*n_/n_block; i<(b+1)*n_/n_block; ++i) {
+      for (casadi_int j=0; j<n_in_; ++j) {
+        if (!arg[j]) {
+          arg1[j] = nullptr;
+        } else {
+          arg1[j] = reduce_in_[j] ? arg[j] : arg[j] + i*f_.nnz_in(j);
+        }
+      }
+      // Reduced outputs are written to scratch space
+      double* s = w_scratch;
+      for (casadi_int j=0; j<n_out_; ++j) {
+        if (reduce_out_[j]) {
+          res1[j] = res[j] ? s : nullptr;
+          s += f_.nnz_out(j);
+        } else {
+          res1[j] = res[j] ? res[j] + i*f_.nnz_out(j) : nullptr;
+        }
+      }
+      // Evaluate
+      try {
+        if (f_(arg1, res1, iw1, w1, mem)) return 1;
+      } catch (std::exception& e) {
+        casadi_warning("Exception raised: " + std::string(e.what()));
+        return 1;
+      } catch (...) {
+        casadi_warning("Uncaught exception.");
+        return 1;
+      }
+      // Accumulate
+      double* acc = w_acc;
+      for (casadi_int j=0; j<n_out_; ++j) {
+        if (reduce_out_[j]) {
+          casadi_add(f_.nnz_out(j), res1[j], acc);
+          acc += f_.nnz_out(j);
+        }
+      }
+    }
+    return 0;
+  }
+
+  void MapSum::reduce_blocks(casadi_int n_block, double* w, double** res) const {
+    casadi_int nnz_red = nnz_reduce();
+    // Pairwise summation in a fixed order
+    for (casadi_int s=1; s<n_block; s*=2) {
+      for (casadi_int b=0; b+s<n_block; b+=2*s) {
+        casadi_add(nnz_red, w + (b+s)*nnz_red, w + b*nnz_red);
+      }
+    }
+    // Result is in the first accumulator
+    for (casadi_int j=0; j<n_out_; ++j) {
+      if (reduce_out_[j]) {
+        if (res[j]) casadi_copy(w, f_.nnz_out(j), res[j]);
+        w += f_.nnz_out(j);
+      }
+    }
+  }
+
+  void MapSum::codegen_blocks(CodeGenerator& g, casadi_int n_block, bool openmp) const {
+    size_t sz_arg, sz_res, sz_iw, sz_w;
+    f_.sz_work(sz_arg, sz_res, sz_iw, sz_w);
+    casadi_int nnz_red = nnz_reduce();
+    // Offsets of the per-block buffers, if any
+    string slot_arg = openmp ? "+b*" + str(sz_arg) : "";
+    string slot_res = openmp ? "+b*" + str(sz_res) : "";
+    string slot_iw = openmp ? "+b*" + str(sz_iw) : "";
+    string slot_w = openmp ? "+b*" + str(sz_w + nnz_red) : "";
+
+    g << "casadi_int b, i, s, flag = 0;\n"
+      << "const casadi_real** arg1;\n"
+      << "casadi_real **res1, *w1, *w_acc;\n";
+    // Clear accumulators
+    g << g.clear("w", n_block*nnz_red) << "\n";
+    if (openmp) {
+      g << "#pragma omp parallel for schedule(dynamic) private(b,i,arg1,res1,w1,w_acc) "
+        << "reduction(||:flag)\n";
+    }
+    g << "for (b=0; b<" << n_block << "; ++b) {\n"
+      << "arg1 = arg+" << n_in_ << slot_arg << ";\n"
+      << "res1 = res+" << n_out_ << slot_res << ";\n"
+      << "w1 = w+" << n_block*nnz_red << slot_w << ";\n"
+      << "for (i=(b*" << n_ << ")/" << n_block << "; i<((b+1)*" << n_ << ")/" << n_block
+      << "; ++i) {\n";
+    // Input buffers
+    for (casadi_int j=0; j<n_in_; ++j) {
+      if (reduce_in_[j]) {
+        g << "arg1[" << j << "] = " << g.arg(j) << ";\n";
+      } else {
+        g << "arg1[" << j << "] = " << g.arg(j) << " ? "
+          << g.arg(j) << "+i*" << f_.nnz_in(j) << " : 0;\n";
+      }
+    }
+    // Output buffers
+    casadi_int offset = 0;
+    for (casadi_int j=0; j<n_out_; ++j) {
+      if (reduce_out_[j]) {
+        g << "res1[" << j << "] = " << g.res(j) << " ? w1+" << sz_w + offset << " : 0;\n";
+        offset += f_.nnz_out(j);
+      } else {
+        g << "res1[" << j << "] = " << g.res(j) << " ? "
+          << g.res(j) << "+i*" << f_.nnz_out(j) << " : 0;\n";
+      }
+    }
+    // Evaluate
+    g << "if (" << g(f_, "arg1", "res1", "iw" + slot_iw, "w1") << ") flag = 1;\n";
+    // Accumulate
+    offset = 0;
+    for (casadi_int j=0; j<n_out_; ++j) {
+      if (reduce_out_[j]) {
+        g << "w_acc = w+b*" << nnz_red << "+" << offset << ";\n"
+          << "if (res1[" << j << "]) "
+          << g.axpy(f_.nnz_out(j), "1.0", "res1[" + str(j) + "]", "w_acc") << "\n";
+        offset += f_.nnz_out(j);
+      }
+    }
+    g << "}\n"
+      << "}\n"
+      << "if (flag) return 1;\n";
+    // Tree reduction
+    g << "for (s=1; s<" << n_block << "; s*=2) {\n"
+      << "for (b=0; b+s<" << n_block << "; b+=2*s) {\n"
+      << g.axpy(nnz_red, "1.0", "w+(b+s)*" + str(nnz_red), "w+b*" + str(nnz_red)) << "\n"
+      << "}\n"
+      << "}\n";
+    // Copy to outputs
+    offset = 0;
+    for (casadi_int j=0; j<n_out_; ++j) {
+      if (reduce_out_[j]) {
+        g << "if (" << g.res(j) << ") "
+          << g.copy("w+" + str(offset), f_.nnz_out(j), g.res(j)) << "\n";
+        offset += f_.nnz_out(j);
+      }
+    }
+  }
+
+  const Options ThreadMapSum::options_
+  = {{&FunctionInternal::options_},
+     {{"max_workers",
+       {OT_INT,
+        "Maximum number of concurrent workers, including the calling thread "
+        "[default: thread pool size + 1]"}},
+      {"n_block",
+       {OT_INT,
+        "Number of blocks of consecutive instances, each with a private accumulator. "
+        "Blocks are the unit of work stealing [default: min(n, 64)]"}}
+     }
+  };
+
+  ThreadMapSum::ThreadMapSum(DeserializingStream& s) : MapSum(s) {
+    s.unpack("ThreadMapSum::max_workers", max_workers_);
+    s.unpack("ThreadMapSum::n_block", n_block_);
+  }
+
+  void ThreadMapSum::serialize_body(SerializingStream &s) const {
+    MapSum::serialize_body(s);
+    s.pack("ThreadMapSum::max_workers", max_workers_);
+    s.pack("ThreadMapSum::n_block", n_block_);
+  }
+
+  ThreadMapSum::~ThreadMapSum() {
+    clear_mem();
+  }
+
+  void ThreadMapSum::init(const Dict& opts) {
+#ifndef CASADI_WITH_THREAD
+    casadi_warning("CasADi was not compiled with WITH_THREAD=ON. "
+                   "Falling back to serial evaluation.");
+#endif // CASADI_WITH_THREAD
+    // Call the initialization method of the base class
+    MapSum::init(opts);
+
+    // Default options
+    max_workers_ = ThreadPool::target_size() + 1;
+    n_block_ = std::min(n_, casadi_int(64));
+
+    // Read options
+    for (auto&& op : opts) {
+      if (op.first=="max_workers") {
+        max_workers_ = op.second;
+      } else if (op.first=="n_block") {
+        n_block_ = op.second;
+      }
+    }
+
+    // Sanity checks
+    casadi_assert(max_workers_>=1, "Option 'max_workers' must be positive");
+    casadi_assert(n_block_>=1 && n_block_<=n_, "Option 'n_block' must be in [1, n]");
+
+    // No more workers than blocks
+    max_workers_ = std::min(max_workers_, n_block_);
+
+    // Block accumulators, followed by work vector and scratch space per worker
+    alloc_arg(f_.sz_arg() * max_workers_);
+    alloc_res(f_.sz_res() * max_workers_);
+    alloc_w(n_block_*nnz_reduce() + (f_.sz_w() + nnz_reduce()) * max_workers_);
+    alloc_iw(f_.sz_iw() * max_workers_);
+  }
+
+  int ThreadMapSum::eval(const double** arg, double** res, casadi_int* iw, double* w,
+                         void* mem) const {
+    // Clear accumulators
+    casadi_clear(w, n_block_*nnz_reduce());
+
+    // Checkout one memory object per worker
+    std::vector< scoped_checkout<Function> > ind; ind.reserve(max_workers_);
+    for (casadi_int k=0; k<max_workers_; ++k) ind.emplace_back(f_);
+
+    // Allocate space for return values
+    std::vector<int> ret_values(n_block_);
+
+    // Evaluate blocks on the persistent thread pool
+    auto m = static_cast<ThreadMapMemory*>(mem);
+    ThreadPool::instance().run(n_block_, max_workers_, 1,
+      [&](casadi_int b, casadi_int slot) {
+        ret_values[b] = eval_block(b, n_block_, slot, arg, res, iw, w, ind[slot]);
+      }, &m->worker_stats);
+
+    // Check return values
+    for (int e : ret_values) if (e) return 1;
+
+    // Combine accumulators
+    reduce_blocks(n_block_, w, res);
+    return 0;
+  }
+
+  Dict ThreadMapSum::get_stats(void* mem) const {
+    Dict stats = MapSum::get_stats(mem);
+    auto m = static_cast<ThreadMapMemory*>(mem);
+    add_worker_stats(stats, m->worker_stats);
+    return stats;
+  }
+
+  void ThreadMapSum::codegen_body(CodeGenerator& g) const {
+    // Same block structure, evaluated sequentially
+    codegen_blocks(g, n_block_, false);
+  }
+
+  const Options OmpMapSum::options_
+  = {{&FunctionInternal::options_},
+     {{"n_block",
+       {OT_INT,
+        "Number of blocks of consecutive instances, each with a private accumulator "
+        "and work vector. Blocks are scheduled dynamically [default: min(n, 64)]"}}
+     }
+  };
+
+  OmpMapSum::OmpMapSum(DeserializingStream& s) : MapSum(s) {
+    s.unpack("OmpMapSum::n_block", n_block_);
+  }
+
+  void OmpMapSum::serialize_body(SerializingStream &s) const {
+    MapSum::serialize_body(s);
+    s.pack("OmpMapSum::n_block", n_block_);
+  }
+
+  OmpMapSum::~OmpMapSum() {
+    clear_mem();
+  }
+
+  void OmpMapSum::init(const Dict& opts) {
+#ifndef WITH_OPENMP
+    casadi_warning("CasADi was not compiled with WITH_OPENMP=ON. "
+                   "Falling back to serial evaluation.");
+#endif // WITH_OPENMP
+    // Call the initialization method of the base class
+    MapSum::init(opts);
+
+    // Default options
+    n_block_ = std::min(n_, casadi_int(64));
+
+    // Read options
+    for (auto&& op : opts) {
+      if (op.first=="n_block") {
+        n_block_ = op.second;
+      }
+    }
+
+    // Sanity checks
+    casadi_assert(n_block_>=1 && n_block_<=n_, "Option 'n_block' must be in [1, n]");
+
+    // Block accumulators, followed by work vector and scratch space per block
+    alloc_arg(f_.sz_arg() * n_block_);
+    alloc_res(f_.sz_res() * n_block_);
+    alloc_w(n_block_*nnz_reduce() + (f_.sz_w() + nnz_reduce()) * n_block_);
+    alloc_iw(f_.sz_iw() * n_block_);
+  }
+
+  int OmpMapSum::eval(const double** arg, double** res, casadi_int* iw, double* w,
+                      void* mem) const {
+    // Clear accumulators
+    casadi_clear(w, n_block_*nnz_reduce());
+
+    // Checkout one memory object per block
+    std::vector< scoped_checkout<Function> > ind; ind.reserve(n_block_);
+    for (casadi_int b=0; b<n_block_; ++b) ind.emplace_back(f_);
+
+    // Error flag
+    casadi_int flag = 0;
+
+    // Evaluate blocks in parallel
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(||:flag)
+#endif // WITH_OPENMP
+    for (casadi_int b=0; b<n_block_; ++b) {
+      flag = eval_block(b, n_block_, b, arg, res, iw, w, ind[b]) || flag;
+    }
+    if (flag) return 1;
+
+    // Combine accumulators
+    reduce_blocks(n_block_, w, res);
+    return 0;
+  }
+
+  void OmpMapSum::codegen_body(CodeGenerator& g) const {
+    codegen_blocks(g, n_block_, true);
+  }
+
 } // namespace casadi
@@ -26,7 +26,7 @@
 #ifndef CASADI_MAPSUM_HPP
 #define CASADI_MAPSUM_HPP
 
-#include "function_internal.hpp"
+#include "map.hpp"
 
 /// \cond INTERNAL
 
@@ -165,6 +165,24 @@ namespace casadi {
            const std::vector<bool>& reduce_in,
            const std::vector<bool>& reduce_out);
 
+    // Total number of nonzeros of the reduced outputs
+    casadi_int nnz_reduce() const;
+
+    /** \brief Evaluate the instances of a block, accumulating the reduced outputs
+
+        The work vector starts with n_block accumulators of size nnz_reduce(),
+        followed by one buffer of size f_.sz_w()+nnz_reduce() per slot.
+    */
+    int eval_block(casadi_int b, casadi_int n_block, casadi_int slot,
+                   const double** arg, double** res, casadi_int* iw, double* w,
+                   casadi_int mem) const;
+
+    // Combine the block accumulators by a tree reduction and write to res
+    void reduce_blocks(casadi_int n_block, double* w, double** res) const;
+
+    // Generate code for a blocked evaluation, with one buffer per block if openmp
+    void codegen_blocks(CodeGenerator& g, casadi_int n_block, bool openmp) const;
+
     // The function which is to be evaluated in parallel
     Function f_;
 
@@ -178,6 +196,115 @@ namespace casadi {
     std::vector<bool> reduce_out_;
   };
 
+  /** Map with reduce_in/reduce_out, evaluated in parallel on the thread pool
+      The instances are split into a fixed number of blocks. Each block
+      accumulates its reduced outputs in a private buffer, after which the
+      buffers are combined by a tree reduction. The result is bitwise
+      independent of the number of threads.
+  */
+  class CASADI_EXPORT ThreadMapSum : public MapSum {
+    friend class MapSum;
+  public:
+    /** \brief Destructor */
+    ~ThreadMapSum() override;
+
+    /** \brief Get type name */
+    std::string class_name() const override {return "ThreadMapSum";}
+
+    ///@{
+    /** \brief Options */
+    static const Options options_;
+    const Options& get_options() const override { return options_;}
+    ///@}
+
+    /// Evaluate the function numerically
+    int eval(const double** arg, double** res, casadi_int* iw, double* w, void* mem) const override;
+
+    /** \brief  Initialize */
+    void init(const Dict& opts) override;
+
+    /** \brief Create memory block */
+    void* alloc_mem() const override { return new ThreadMapMemory();}
+
+    /** \brief Free memory block */
+    void free_mem(void *mem) const override { delete static_cast<ThreadMapMemory*>(mem);}
+
+    /// Get all statistics
+    Dict get_stats(void* mem) const override;
+
+    /// Type of parallellization
+    std::string parallelization() const override { return "thread"; }
+
+    /** \brief Generate code for the body of the C function */
+    void codegen_body(CodeGenerator& g) const override;
+
+    /** \brief Serialize an object without type information */
+    void serialize_body(SerializingStream &s) const override;
+
+  protected:
+    /** \brief Deserializing constructor */
+    explicit ThreadMapSum(DeserializingStream& s);
+
+    // Constructor (protected, use create function in MapSum)
+    ThreadMapSum(const std::string& name, const Function& f, casadi_int n,
+                 const std::vector<bool>& reduce_in,
+                 const std::vector<bool>& reduce_out)
+      : MapSum(name, f, n, reduce_in, reduce_out) {}
+
+    // Maximum number of concurrent workers
+    casadi_int max_workers_;
+
+    // Number of blocks with private accumulators
+    casadi_int n_block_;
+  };
+
+  /** Map with reduce_in/reduce_out, evaluated in parallel using OpenMP
+      Same block structure as ThreadMapSum, with one work buffer per block.
+  */
+  class CASADI_EXPORT OmpMapSum : public MapSum {
+    friend class MapSum;
+  public:
+    /** \brief Destructor */
+    ~OmpMapSum() override;
+
+    /** \brief Get type name */
+    std::string class_name() const override {return "OmpMapSum";}
+
+    ///@{
+    /** \brief Options */
+    static const Options options_;
+    const Options& get_options() const override { return options_;}
+    ///@}
+
+    /// Evaluate the function numerically
+    int eval(const double** arg, double** res, casadi_int* iw, double* w, void* mem) const override;
+
+    /** \brief  Initialize */
+    void init(const Dict& opts) override;
+
+    /// Type of parallellization
+    std::string parallelization() const override { return "openmp"; }
+
+    /** \brief Generate code for the body of the C function */
+    void codegen_body(CodeGenerator& g) const override;
+
+    /** \brief Serialize an object without type information */
+    void serialize_body(SerializingStream &s) const override;
+
+  protected:
+    /** \brief Deserializing constructor */
+    explicit OmpMapSum(DeserializingStream& s);
+
+    // Constructor (protected, use create function in MapSum)
+    OmpMapSum(const std::string& name, const Function& f, casadi_int n,
+              const std::vector<bool>& reduce_in,
+              const std::vector<bool>& reduce_out)
+      : MapSum(name, f, n, reduce_in, reduce_out) {}
+
+    // Number of blocks with private accumulators
+    casadi_int n_block_;
+  };
+
 
 } // namespace casadi
 /// \endcond
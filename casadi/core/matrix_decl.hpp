@@ -313,6 +313,8 @@ namespace casadi {
                               std::vector<Matrix<Scalar> >& vdef,
                               const std::string& v_prefix,
                               const std::string& v_suffix);
+    static Matrix<Scalar> cse(const Matrix<Scalar>& e);
+    static std::vector<Matrix<Scalar> > cse(const std::vector<Matrix<Scalar> >& e);
     static Matrix<Scalar> _bilin(const Matrix<Scalar>& A,
                                    const Matrix<Scalar>& x,
                                    const Matrix<Scalar>& y);
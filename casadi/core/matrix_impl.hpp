@@ -1979,11 +1979,11 @@ namespace casadi {
     casadi_assert(beta.is_vector() && beta.numel()==ncol, "'beta' has wrong dimension");
     casadi_assert(prinv.size()==r.size1(), "'pinv' has wrong dimension");
     // Work vector
-    std::vector<Scalar> w(nrow+ncol);
+    std::vector<Scalar> w(4*(nrow+ncol));
     // Return value
     Matrix<Scalar> x = densify(b);
-    casadi_qr_solve(x.ptr(), nrhs, tr, v.sparsity(), v.ptr(), r.sparsity(), r.ptr(),
-                    beta.ptr(), get_ptr(prinv), get_ptr(pc), get_ptr(w));
+    casadi_qr_solve_panel(x.ptr(), nrhs, tr, v.sparsity(), v.ptr(), r.sparsity(), r.ptr(),
+                          beta.ptr(), get_ptr(prinv), get_ptr(pc), get_ptr(w));
     return x;
   }
 
@@ -2057,8 +2057,9 @@ namespace casadi {
     casadi_assert(D.is_vector() && D.numel()==n, "'D' has wrong dimension");
     // Solve for all right-hand-sides
     Matrix<Scalar> x = densify(b);
-    std::vector<Scalar> w(n);
-    casadi_ldl_solve(x.ptr(), nrhs, LT.sparsity(), LT.ptr(), D.ptr(), get_ptr(p), get_ptr(w));
+    std::vector<Scalar> w(4*n);
+    casadi_ldl_solve_panel(x.ptr(), nrhs, LT.sparsity(), LT.ptr(), D.ptr(), get_ptr(p),
+                           get_ptr(w));
     return x;
   }
 
@@ -2580,6 +2581,18 @@ namespace casadi {
     casadi_error("'shared' not defined for " + type_name());
   }
 
+  template<typename Scalar>
+  Matrix<Scalar> Matrix<Scalar>::cse(const Matrix<Scalar>& e) {
+    casadi_error("'cse' not defined for " + type_name());
+    return Matrix<Scalar>();
+  }
+
+  template<typename Scalar>
+  std::vector<Matrix<Scalar> > Matrix<Scalar>::cse(const std::vector<Matrix<Scalar> >& e) {
+    casadi_error("'cse' not defined for " + type_name());
+    return std::vector<Matrix<Scalar> >();
+  }
+
   template<typename Scalar>
   Matrix<Scalar> Matrix<Scalar>::poly_coeff(const Matrix<Scalar>& f,
                                                 const Matrix<Scalar>&x) {
@@ -122,6 +122,22 @@ namespace casadi {
                           g.work(res[0], nnz()), sparsity(), "w", false) << '\n';
   }
 
+  int DenseMultiplication::
+  eval(const double** arg, double** res, casadi_int* iw, double* w) const {
+    if (arg[0]!=res[0]) copy(arg[0], arg[0]+dep(0).nnz(), res[0]);
+    casadi_mtimes_dense(arg[1], dep(1).size1(), dep(1).size2(),
+                        arg[2], dep(2).size2(), res[0]);
+    return 0;
+  }
+
+  // Kernel selection for generated code, by number of multiply-adds
+  // Fully unrolled up to 4x4 times 4x4
+  const casadi_int mtimes_unroll_max = 64;
+  // Inner products with constant bounds up to 12x12 times 12x12
+  const casadi_int mtimes_inner_max = 1728;
+  // BLAS, if enabled, from 32x32 times 32x32
+  const casadi_int mtimes_blas_min = 32768;
+
   void DenseMultiplication::
   generate(CodeGenerator& g,
            const std::vector<casadi_int>& arg, const std::vector<casadi_int>& res) const {
@@ -132,17 +148,45 @@ namespace casadi {
     }
 
     casadi_int nrow_x = dep(1).size1(), nrow_y = dep(2).size1(), ncol_y = dep(2).size2();
-    g.local("rr", "casadi_real", "*");
-    g.local("ss", "casadi_real", "*");
-    g.local("tt", "casadi_real", "*");
-    g.local("i", "casadi_int");
-    g.local("j", "casadi_int");
-    g.local("k", "casadi_int");
-    g << "for (i=0, rr=" << g.work(res[0], nnz()) <<"; i<" << ncol_y << "; ++i)"
-      << " for (j=0; j<" << nrow_x << "; ++j, ++rr)"
-      << " for (k=0, ss=" << g.work(arg[1], dep(1).nnz()) << "+j, tt="
-      << g.work(arg[2], dep(2).nnz()) << "+i*" << nrow_y << "; k<" << nrow_y << "; ++k)"
-      << " *rr += ss[k*" << nrow_x << "]**tt++;\n";
+    casadi_int n_mac = nrow_x*nrow_y*ncol_y;
+    if (n_mac==0) return;
+    std::string x = g.work(arg[1], dep(1).nnz());
+    std::string y = g.work(arg[2], dep(2).nnz());
+    std::string z = g.work(res[0], nnz());
+    if (n_mac<=mtimes_unroll_max) {
+      // Fully unrolled, one sum of products per entry
+      g.local("rr", "casadi_real", "*");
+      g.local("ss", "casadi_real", "*");
+      g.local("tt", "casadi_real", "*");
+      g << "rr=" << z << "; ss=" << x << "; tt=" << y << ";\n";
+      for (casadi_int i=0; i<ncol_y; ++i) {
+        for (casadi_int j=0; j<nrow_x; ++j) {
+          g << "rr[" << j+i*nrow_x << "] +=";
+          for (casadi_int k=0; k<nrow_y; ++k) {
+            g << (k==0 ? " " : "+") << "ss[" << j+k*nrow_x << "]*tt[" << k+i*nrow_y << "]";
+          }
+          g << ";\n";
+        }
+      }
+    } else if (n_mac<=mtimes_inner_max) {
+      // Inner products, loop bounds known at compile time
+      g.local("rr", "casadi_real", "*");
+      g.local("ss", "casadi_real", "*");
+      g.local("tt", "casadi_real", "*");
+      g.local("i", "casadi_int");
+      g.local("j", "casadi_int");
+      g.local("k", "casadi_int");
+      g << "for (i=0, rr=" << z <<"; i<" << ncol_y << "; ++i)"
+        << " for (j=0; j<" << nrow_x << "; ++j, ++rr)"
+        << " for (k=0, ss=" << x << "+j, tt="
+        << y << "+i*" << nrow_y << "; k<" << nrow_y << "; ++k)"
+        << " *rr += ss[k*" << nrow_x << "]**tt++;\n";
+    } else if (g.blas && g.casadi_real_type=="double" && n_mac>=mtimes_blas_min) {
+      g << g.gemm(x, nrow_x, nrow_y, y, ncol_y, z) << '\n';
+    } else {
+      // Register-blocked kernel, dimensions passed as constants
+      g << g.mtimes(x, nrow_x, nrow_y, y, ncol_y, z) << '\n';
+    }
   }
 
   void Multiplication::serialize_type(SerializingStream& s) const {
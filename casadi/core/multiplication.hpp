@@ -121,6 +121,9 @@ namespace casadi {
     /** \brief  Destructor */
     ~DenseMultiplication() override {}
 
+    /// Evaluate the function numerically
+    int eval(const double** arg, double** res, casadi_int* iw, double* w) const override;
+
     /** \brief Generate code for the operation */
     void generate(CodeGenerator& g,
                   const std::vector<casadi_int>& arg,
@@ -1653,6 +1653,100 @@ namespace casadi {
     }
   }
 
+  std::vector<MX> MX::cse(const std::vector<MX>& e) {
+    try {
+      // Sort the expression
+      Function f("tmp", vector<MX>{}, e);
+      auto *ff = f.get<MXFunction>();
+
+      // Get references to the internal data structures
+      const vector<MXAlgEl>& algorithm = ff->algorithm_;
+      vector<MX> work(ff->workloc_.size()-1);
+
+      // Split up outputs analogous to symbolic primitives
+      vector<vector<MX> > res_split(e.size());
+      for (casadi_int i=0; i<e.size(); ++i) res_split[i].resize(e[i].n_primitives());
+
+      // Unique expressions, indexed by operation and (already merged) dependencies
+      map<pair<casadi_int, vector<const MXNode*> >, vector<MX> > unique;
+
+      // Arguments for calling the atomic operations
+      vector<MX> oarg, ores;
+      vector<const MXNode*> key_dep;
+
+      // Evaluate the algorithm
+      for (auto it=algorithm.begin(); it<algorithm.end(); ++it) {
+        switch (it->op) {
+        case OP_OUTPUT:
+          res_split.at(it->data->ind()).at(it->data->segment()) = work[it->arg.front()];
+          break;
+        case OP_PARAMETER:
+          work[it->res.front()] = it->data;
+          break;
+        default:
+          {
+            // Arguments of the operation
+            oarg.resize(it->arg.size());
+            for (casadi_int i=0; i<oarg.size(); ++i) {
+              casadi_int el = it->arg[i];
+              oarg[i] = el<0 ? MX(it->data->dep(i).size()) : work.at(el);
+            }
+
+            // Perform the operation, unless the arguments are unchanged
+            ores.resize(it->res.size());
+            bool changed = false;
+            for (casadi_int i=0; i<oarg.size(); ++i) {
+              if (it->arg[i]>=0 && oarg[i].get()!=it->data->dep(i).get()) changed = true;
+            }
+            if (changed) {
+              it->data->eval_mx(oarg, ores);
+            } else {
+              for (casadi_int i=0; i<ores.size(); ++i) ores[i] = it->data.get_output(i);
+            }
+
+            // Look for a structurally equal expression, single-output nodes only
+            if (ores.size()==1 && it->res.front()>=0) {
+              const MX& r = ores.front();
+              key_dep.resize(r.n_dep());
+              for (casadi_int i=0; i<key_dep.size(); ++i) key_dep[i] = r.dep(i).get();
+              // Arguments in a canonical order for commutative operations
+              if (r.is_binary() && r.is_commutative() && key_dep[1]<key_dep[0]) {
+                std::swap(key_dep[0], key_dep[1]);
+              }
+              vector<MX>& cand = unique[make_pair(r.op(), key_dep)];
+              bool found = false;
+              for (auto&& c : cand) {
+                if (is_equal(c, r, 1)) {
+                  ores.front() = c;
+                  found = true;
+                  break;
+                }
+              }
+              if (!found) cand.push_back(r);
+            }
+
+            // Get the result
+            for (casadi_int i=0; i<ores.size(); ++i) {
+              casadi_int el = it->res[i];
+              if (el>=0) work.at(el) = ores[i];
+            }
+          }
+        }
+      }
+
+      // Join split outputs
+      vector<MX> ret(e.size());
+      for (casadi_int i=0; i<ret.size(); ++i) ret[i] = e[i].join_primitives(res_split[i]);
+      return ret;
+    } catch (std::exception& ex) {
+      CASADI_THROW_ERROR("cse", ex.what());
+    }
+  }
+
+  MX MX::cse(const MX& e) {
+    return cse(vector<MX>{e}).at(0);
+  }
+
   MX MX::jacobian(const MX &f, const MX &x, const Dict& opts) {
     try {
       Dict h_opts;
@@ -490,6 +490,8 @@ namespace casadi {
     static void shared(std::vector<MX>& ex, std::vector<MX>& v,
                               std::vector<MX>& vdef, const std::string& v_prefix,
                               const std::string& v_suffix);
+    static MX cse(const MX& e);
+    static std::vector<MX> cse(const std::vector<MX>& e);
     static MX if_else(const MX& cond, const MX& if_true,
                       const MX& if_false, bool short_circuit=false);
     static MX conditional(const MX& ind, const std::vector<MX> &x, const MX& x_default,
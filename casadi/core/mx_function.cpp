@@ -61,7 +61,10 @@ namespace casadi {
         "Default input values"}},
       {"live_variables",
        {OT_BOOL,
-        "Reuse variables in the work vector"}}
+        "Reuse variables in the work vector"}},
+      {"cse",
+       {OT_BOOL,
+        "Perform common subexpression elimination on the outputs [default: false]"}}
      }
   };
 
@@ -103,6 +106,7 @@ namespace casadi {
 
     // Default (temporary) options
     live_variables_ = true;
+    bool cse_opt = false;
 
     // Read options
     for (auto&& op : opts) {
@@ -110,6 +114,8 @@ namespace casadi {
         default_in_ = op.second;
       } else if (op.first=="live_variables") {
         live_variables_ = op.second;
+      } else if (op.first=="cse") {
+        cse_opt = op.second;
       }
     }
 
@@ -121,6 +127,9 @@ namespace casadi {
                             "Option 'default_in' has incorrect length");
     }
 
+    // Merge structurally equal subexpressions before sorting
+    if (cse_opt) out_ = MX::cse(out_);
+
     // Stack used to sort the computational graph
     stack<MXNode*> s;
 
@@ -1,32 +1,48 @@
 // NOLINT(legal/copyright)
-// SYMBOL "ldl"
-// Calculate the nonzeros of the transposed L factor (strictly lower entries only)
-// as well as D for an LDL^T factorization
-// len[w] >= n
+// SYMBOL "ldl_copy"
+// Copy column c of the permuted A to the transposed L factor (strictly lower entries only)
+// and to D, cf. casadi_ldl
+// len[w] >= n, zero on entry and on exit
 template<typename T1>
-void casadi_ldl(const casadi_int* sp_a, const T1* a,
-                const casadi_int* sp_lt, T1* lt, T1* d, const casadi_int* p, T1* w) {
+void casadi_ldl_copy(const casadi_int* sp_a, const T1* a,
+                     const casadi_int* sp_lt, T1* lt, T1* d, const casadi_int* p, T1* w,
+                     casadi_int c) {
   const casadi_int *lt_colind, *lt_row, *a_colind, *a_row;
-  casadi_int n, r, c, c1, k, k2;
+  casadi_int n, c1, k;
   // Extract sparsities
   n=sp_lt[1];
   lt_colind=sp_lt+2; lt_row=sp_lt+2+n+1;
   a_colind=sp_a+2; a_row=sp_a+2+n+1;
-  // Clear w
-  for (r=0; r<n; ++r) w[r] = 0;
   // Sparse copy of A to L and D
-  for (c=0; c<n; ++c) {
-    c1 = p[c];
-    for (k=a_colind[c1]; k<a_colind[c1+1]; ++k) w[a_row[k]] = a[k];
-    for (k=lt_colind[c]; k<lt_colind[c+1]; ++k) lt[k] = w[p[lt_row[k]]];
-    d[c] = w[p[c]];
-    for (k=a_colind[c1]; k<a_colind[c1+1]; ++k) w[a_row[k]] = 0;
-  }
+  c1 = p[c];
+  for (k=a_colind[c1]; k<a_colind[c1+1]; ++k) w[a_row[k]] = a[k];
+  for (k=lt_colind[c]; k<lt_colind[c+1]; ++k) lt[k] = w[p[lt_row[k]]];
+  d[c] = w[p[c]];
+  for (k=a_colind[c1]; k<a_colind[c1+1]; ++k) w[a_row[k]] = 0;
+}
+
+// SYMBOL "ldl_cols"
+// Calculate the columns cols[0], ..., cols[ncols-1] of the transposed L factor
+// (strictly lower entries only) and of D, cf. casadi_ldl. The columns must be given
+// in increasing order and their descendants in the elimination tree must have been
+// calculated before or be part of the list. If cols is null, all columns are calculated.
+// len[w] >= n, zero on entry and on exit
+template<typename T1>
+void casadi_ldl_cols(const casadi_int* sp_a, const T1* a,
+                     const casadi_int* sp_lt, T1* lt, T1* d, const casadi_int* p, T1* w,
+                     const casadi_int* cols, casadi_int ncols) {
+  const casadi_int *lt_colind, *lt_row;
+  casadi_int n, r, c, i, k, k2;
+  // Extract sparsity
+  n=sp_lt[1];
+  lt_colind=sp_lt+2; lt_row=sp_lt+2+n+1;
   // Loop over columns of L
-  for (c=0; c<n; ++c) {
+  for (i=0; i<ncols; ++i) {
+    c = cols ? cols[i] : i;
+    casadi_ldl_copy(sp_a, a, sp_lt, lt, d, p, w, c);
+    // Calculate l(r,c) with r<c
     for (k=lt_colind[c]; k<lt_colind[c+1]; ++k) {
       r = lt_row[k];
-      // Calculate l(r,c) with r<c
       for (k2=lt_colind[r]; k2<lt_colind[r+1]; ++k2) {
         lt[k] -= lt[k2] * w[lt_row[k2]];
       }
@@ -40,25 +56,123 @@ void casadi_ldl(const casadi_int* sp_a, const T1* a,
   }
 }
 
-// SYMBOL "ldl_trs"
-// Solve for (I+R) with R an optionally transposed strictly upper triangular matrix.
+// SYMBOL "ldl_rows"
+// Calculate the entries in rows r0 <= r < r1 of the columns cols[0], ..., cols[ncols-1]
+// of the transposed L factor, which must have been copied from A with casadi_ldl_copy.
+// Columns r0, ..., r1-1 must be complete and form a subtree of the elimination tree.
+// D is not updated, cf. casadi_ldl_top.
+// len[w] >= n, zero on entry and on exit
 template<typename T1>
-void casadi_ldl_trs(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr) {
-  casadi_int ncol, c, k;
+void casadi_ldl_rows(const casadi_int* sp_lt, T1* lt, const T1* d, T1* w,
+                     const casadi_int* cols, casadi_int ncols, casadi_int r0, casadi_int r1) {
+  const casadi_int *lt_colind, *lt_row;
+  casadi_int n, r, c, i, k, k0, k1, k2;
+  // Extract sparsity
+  n=sp_lt[1];
+  lt_colind=sp_lt+2; lt_row=sp_lt+2+n+1;
+  for (i=0; i<ncols; ++i) {
+    c = cols[i];
+    // Bisection for the first entry with row >= r0
+    k0 = lt_colind[c];
+    k1 = lt_colind[c+1];
+    while (k0<k1) {
+      k = (k0+k1)/2;
+      if (lt_row[k]<r0) {
+        k0 = k+1;
+      } else {
+        k1 = k;
+      }
+    }
+    // Calculate l(r,c) with r0 <= r < r1
+    for (k=k0; k<lt_colind[c+1] && (r=lt_row[k])<r1; ++k) {
+      for (k2=lt_colind[r]; k2<lt_colind[r+1]; ++k2) {
+        lt[k] -= lt[k2] * w[lt_row[k2]];
+      }
+      w[r] = lt[k];
+      lt[k] /= d[r];
+    }
+    // Clear w
+    for (k2=k0; k2<k; ++k2) w[lt_row[k2]] = 0;
+  }
+}
+
+// SYMBOL "ldl_top"
+// Complete the columns cols[0], ..., cols[ncols-1] (in increasing order) of the transposed
+// L factor and of D after the entries in the rows r with done[r] != 0 have been calculated
+// with casadi_ldl_rows, cf. casadi_ldl_cols
+// len[w] >= n, zero on entry and on exit
+template<typename T1>
+void casadi_ldl_top(const casadi_int* sp_lt, T1* lt, T1* d, T1* w,
+                    const casadi_int* cols, casadi_int ncols, const casadi_int* done) {
+  const casadi_int *lt_colind, *lt_row;
+  casadi_int n, r, c, i, k, k2;
+  // Extract sparsity
+  n=sp_lt[1];
+  lt_colind=sp_lt+2; lt_row=sp_lt+2+n+1;
+  for (i=0; i<ncols; ++i) {
+    c = cols[i];
+    for (k=lt_colind[c]; k<lt_colind[c+1]; ++k) {
+      r = lt_row[k];
+      if (done[r]) {
+        // Restore the unscaled entry
+        w[r] = lt[k]*d[r];
+      } else {
+        // Calculate l(r,c) with r<c
+        for (k2=lt_colind[r]; k2<lt_colind[r+1]; ++k2) {
+          lt[k] -= lt[k2] * w[lt_row[k2]];
+        }
+        w[r] = lt[k];
+        lt[k] /= d[r];
+      }
+      // Update d(c)
+      d[c] -= w[r]*lt[k];
+    }
+    // Clear w
+    for (k=lt_colind[c]; k<lt_colind[c+1]; ++k) w[lt_row[k]] = 0;
+  }
+}
+
+// SYMBOL "ldl"
+// Calculate the nonzeros of the transposed L factor (strictly lower entries only)
+// as well as D for an LDL^T factorization
+// len[w] >= n
+template<typename T1>
+void casadi_ldl(const casadi_int* sp_a, const T1* a,
+                const casadi_int* sp_lt, T1* lt, T1* d, const casadi_int* p, T1* w) {
+  casadi_int n, r;
+  n=sp_lt[1];
+  // Clear w
+  for (r=0; r<n; ++r) w[r] = 0;
+  // Factorize all columns
+  casadi_ldl_cols(sp_a, a, sp_lt, lt, d, p, w, 0, n);
+}
+
+// SYMBOL "ldl_trs_cols"
+// Solve for (I+R) with R an optionally transposed strictly upper triangular matrix,
+// restricted to the columns cols[0], ..., cols[ncols-1] (in increasing order, all
+// columns if cols is null). Forward substitution requires the descendants of the
+// columns in the elimination tree to be processed before, backward substitution
+// requires the ancestors to be processed before.
+template<typename T1>
+void casadi_ldl_trs_cols(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr,
+                         const casadi_int* cols, casadi_int ncols) {
+  casadi_int ncol, c, i, k;
   const casadi_int *colind, *row;
   // Extract sparsity
   ncol=sp_r[1];
   colind=sp_r+2; row=sp_r+2+ncol+1;
   if (tr) {
     // Forward substitution
-    for (c=0; c<ncol; ++c) {
+    for (i=0; i<ncols; ++i) {
+      c = cols ? cols[i] : i;
       for (k=colind[c]; k<colind[c+1]; ++k) {
         x[c] -= nz_r[k]*x[row[k]];
       }
     }
   } else {
     // Backward substitution
-    for (c=ncol-1; c>=0; --c) {
+    for (i=ncols-1; i>=0; --i) {
+      c = cols ? cols[i] : i;
       for (k=colind[c+1]-1; k>=colind[c]; --k) {
         x[row[k]] -= nz_r[k]*x[c];
       }
@@ -66,6 +180,13 @@ void casadi_ldl_trs(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr
   }
 }
 
+// SYMBOL "ldl_trs"
+// Solve for (I+R) with R an optionally transposed strictly upper triangular matrix.
+template<typename T1>
+void casadi_ldl_trs(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr) {
+  casadi_ldl_trs_cols(sp_r, nz_r, x, tr, 0, sp_r[1]);
+}
+
 // SYMBOL "ldl_solve"
 // Linear solve using an LDL^T factorized linear system
 template<typename T1>
@@ -89,3 +210,74 @@ void casadi_ldl_solve(T1* x, casadi_int nrhs, const casadi_int* sp_lt, const T1*
     x += n;
   }
 }
+
+// SYMBOL "ldl_solve_panel"
+// Linear solve using an LDL^T factorized linear system, with the right-hand-sides
+// processed in panels of four. The factor is traversed once per panel and the
+// entries of a panel are stored contiguously for each row of w.
+// len[w] >= 4*n
+template<typename T1>
+void casadi_ldl_solve_panel(T1* x, casadi_int nrhs, const casadi_int* sp_lt, const T1* lt,
+                            const T1* d, const casadi_int* p, T1* w) {
+  casadi_int n, c, i, k;
+  const casadi_int *colind, *row;
+  T1 e, s0, s1, s2, s3, *wc, *wr;
+  // Extract sparsity
+  n=sp_lt[1];
+  colind=sp_lt+2; row=sp_lt+2+n+1;
+  for (; nrhs>=4; nrhs-=4) {
+    // Multiply by P
+    for (i=0; i<n; ++i) {
+      wc = w + 4*i;
+      wc[0] = x[p[i]];
+      wc[1] = x[n+p[i]];
+      wc[2] = x[2*n+p[i]];
+      wc[3] = x[3*n+p[i]];
+    }
+    //  Solve for L
+    for (c=0; c<n; ++c) {
+      wc = w + 4*c;
+      s0 = wc[0]; s1 = wc[1]; s2 = wc[2]; s3 = wc[3];
+      for (k=colind[c]; k<colind[c+1]; ++k) {
+        e = lt[k];
+        wr = w + 4*row[k];
+        s0 -= e*wr[0];
+        s1 -= e*wr[1];
+        s2 -= e*wr[2];
+        s3 -= e*wr[3];
+      }
+      wc[0] = s0; wc[1] = s1; wc[2] = s2; wc[3] = s3;
+    }
+    // Divide by D
+    for (c=0; c<n; ++c) {
+      e = d[c];
+      wc = w + 4*c;
+      wc[0] /= e; wc[1] /= e; wc[2] /= e; wc[3] /= e;
+    }
+    // Solve for L'
+    for (c=n-1; c>=0; --c) {
+      wc = w + 4*c;
+      s0 = wc[0]; s1 = wc[1]; s2 = wc[2]; s3 = wc[3];
+      for (k=colind[c]; k<colind[c+1]; ++k) {
+        e = lt[k];
+        wr = w + 4*row[k];
+        wr[0] -= e*s0;
+        wr[1] -= e*s1;
+        wr[2] -= e*s2;
+        wr[3] -= e*s3;
+      }
+    }
+    // Multiply by P'
+    for (i=0; i<n; ++i) {
+      wc = w + 4*i;
+      x[p[i]] = wc[0];
+      x[n+p[i]] = wc[1];
+      x[2*n+p[i]] = wc[2];
+      x[3*n+p[i]] = wc[3];
+    }
+    // Next panel
+    x += 4*n;
+  }
+  // Remaining right-hand-sides
+  casadi_ldl_solve(x, nrhs, sp_lt, lt, d, p, w);
+}
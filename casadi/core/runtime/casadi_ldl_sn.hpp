@@ -0,0 +1,224 @@
+// NOLINT(legal/copyright)
+// SYMBOL "ldl_sn"
+// Supernodal LDL^T factorization
+// The structure sn = [n, nsn, col[nsn+1], rptr[nsn+1], nzptr[nsn+1], snof[n], row[...]]
+// holds for each supernode s its columns col[s] to col[s+1]-1, the rows below the
+// diagonal block, row[rptr[s]] to row[rptr[s+1]-1], and the offset of its dense,
+// column-major panel in l. snof[c] is the supernode containing column c.
+// Only the strictly lower entries of each panel are used, D is stored in d
+// len[iw] >= 2*n, len[w] >= max_s (rptr[s+1]-rptr[s])*(col[s+1]-col[s]+rptr[s+1]-rptr[s])
+template<typename T1>
+void casadi_ldl_sn(const casadi_int* sp_a, const T1* a, const casadi_int* sn,
+                   T1* l, T1* d, const casadi_int* p, casadi_int* iw, T1* w) {
+  const casadi_int *a_colind, *a_row, *col, *rptr, *nzptr, *snof, *row;
+  casadi_int n, nsn, s, t, f, ft, nc, nct, nb, nr, nrt, mb, ga, b, b2, i, j, k, c, r;
+  casadi_int *pinv, *map;
+  T1 dj, e, *ls, *lt, *lj, *lk, *u;
+  // Extract sparsities
+  n=sn[0]; nsn=sn[1];
+  col=sn+2; rptr=col+nsn+1; nzptr=rptr+nsn+1; snof=nzptr+nsn+1; row=snof+n;
+  a_colind=sp_a+2; a_row=sp_a+2+n+1;
+  // Work vectors
+  pinv=iw; map=iw+n;
+  for (i=0; i<n; ++i) pinv[p[i]] = i;
+  // Sparse copy of the lower triangular part of P A P' to the panels
+  for (k=0; k<nzptr[nsn]; ++k) l[k] = 0;
+  for (s=0; s<nsn; ++s) {
+    f=col[s]; nc=col[s+1]-f; nr=nc+rptr[s+1]-rptr[s]; ls=l+nzptr[s];
+    for (i=0; i<nc; ++i) map[f+i] = i;
+    for (k=rptr[s]; k<rptr[s+1]; ++k) map[row[k]] = nc+k-rptr[s];
+    for (j=0; j<nc; ++j) {
+      c = p[f+j];
+      for (k=a_colind[c]; k<a_colind[c+1]; ++k) {
+        r = pinv[a_row[k]];
+        if (r>=f+j) ls[map[r] + j*nr] = a[k];
+      }
+    }
+  }
+  // Loop over supernodes
+  for (s=0; s<nsn; ++s) {
+    f=col[s]; nc=col[s+1]-f; nb=rptr[s+1]-rptr[s]; nr=nc+nb; ls=l+nzptr[s];
+    // Dense LDL^T of the diagonal block, also giving the block below it
+    for (j=0; j<nc; ++j) {
+      lj = ls + j*nr;
+      dj = d[f+j] = lj[j];
+      for (i=j+1; i<nr; ++i) lj[i] /= dj;
+      for (k=j+1; k<nc; ++k) {
+        lk = ls + k*nr;
+        e = lj[k]*dj;
+        for (i=k; i<nr; ++i) lk[i] -= lj[i]*e;
+      }
+    }
+    // Update the supernodes containing the rows below the diagonal block
+    for (b=0; b<nb; b=b2) {
+      // Rows that are columns of the same supernode t
+      t = snof[row[rptr[s]+b]];
+      for (b2=b+1; b2<nb && row[rptr[s]+b2]<col[t+1]; ++b2) {}
+      ga = b2-b;
+      mb = nb-b;
+      // Scaled rows: w = L(rows b:b2, :)*D
+      for (j=0; j<nc; ++j) {
+        dj = d[f+j];
+        lj = ls + nc + b + j*nr;
+        for (i=0; i<ga; ++i) w[i + j*ga] = lj[i]*dj;
+      }
+      // u = -L(rows b:nb, :)*D*L(rows b:b2, :)'
+      u = w + ga*nc;
+      for (i=0; i<mb*ga; ++i) u[i] = 0;
+      casadi_ldl_sn_gemm(mb, ga, nc, ls+nc+b, nr, w, ga, u, mb);
+      // Scatter into the panel of t
+      ft=col[t]; nct=col[t+1]-ft; nrt=nct+rptr[t+1]-rptr[t]; lt=l+nzptr[t];
+      for (i=0; i<nct; ++i) map[ft+i] = i;
+      for (k=rptr[t]; k<rptr[t+1]; ++k) map[row[k]] = nct+k-rptr[t];
+      for (j=0; j<ga; ++j) {
+        lj = lt + (row[rptr[s]+b+j]-ft)*nrt;
+        for (i=j; i<mb; ++i) lj[map[row[rptr[s]+b+i]]] += u[i + j*mb];
+      }
+    }
+  }
+}
+
+// SYMBOL "ldl_sn_solve"
+// Linear solve using a supernodal LDL^T factorized linear system
+template<typename T1>
+void casadi_ldl_sn_solve(T1* x, casadi_int nrhs, const casadi_int* sn, const T1* l,
+                         const T1* d, const casadi_int* p, T1* w) {
+  const casadi_int *col, *rptr, *nzptr, *rs;
+  casadi_int n, nsn, s, f, nc, nb, nr, i, j, k;
+  const T1 *ls, *lj;
+  T1 e;
+  // Extract sparsities
+  n=sn[0]; nsn=sn[1];
+  col=sn+2; rptr=col+nsn+1; nzptr=rptr+nsn+1;
+  for (k=0; k<nrhs; ++k) {
+    // P' L D L' P x = b <=> x = P' L' \ D \ L \ P b
+    // Multiply by P
+    for (i=0; i<n; ++i) w[i] = x[p[i]];
+    // Solve for L
+    for (s=0; s<nsn; ++s) {
+      f=col[s]; nc=col[s+1]-f; nb=rptr[s+1]-rptr[s]; nr=nc+nb;
+      ls=l+nzptr[s]; rs=nzptr+nsn+1+n+rptr[s];
+      for (j=0; j<nc; ++j) {
+        lj = ls + j*nr;
+        e = w[f+j];
+        for (i=j+1; i<nc; ++i) w[f+i] -= lj[i]*e;
+        for (i=0; i<nb; ++i) w[rs[i]] -= lj[nc+i]*e;
+      }
+    }
+    // Divide by D
+    for (i=0; i<n; ++i) w[i] /= d[i];
+    // Solve for L'
+    for (s=nsn-1; s>=0; --s) {
+      f=col[s]; nc=col[s+1]-f; nb=rptr[s+1]-rptr[s]; nr=nc+nb;
+      ls=l+nzptr[s]; rs=nzptr+nsn+1+n+rptr[s];
+      for (j=nc-1; j>=0; --j) {
+        lj = ls + j*nr;
+        e = w[f+j];
+        for (i=j+1; i<nc; ++i) e -= lj[i]*w[f+i];
+        for (i=0; i<nb; ++i) e -= lj[nc+i]*w[rs[i]];
+        w[f+j] = e;
+      }
+    }
+    // Multiply by P'
+    for (i=0; i<n; ++i) x[p[i]] = w[i];
+    // Next rhs
+    x += n;
+  }
+}
+
+// SYMBOL "ldl_sn_solve_panel"
+// Linear solve using a supernodal LDL^T factorized linear system, with the
+// right-hand-sides processed in panels of four, cf. casadi_ldl_solve_panel
+// len[w] >= 4*n
+template<typename T1>
+void casadi_ldl_sn_solve_panel(T1* x, casadi_int nrhs, const casadi_int* sn, const T1* l,
+                               const T1* d, const casadi_int* p, T1* w) {
+  const casadi_int *col, *rptr, *nzptr, *rs;
+  casadi_int n, nsn, s, f, nc, nb, nr, i, j;
+  const T1 *ls, *lj;
+  T1 e, s0, s1, s2, s3, *wj, *wi;
+  // Extract sparsities
+  n=sn[0]; nsn=sn[1];
+  col=sn+2; rptr=col+nsn+1; nzptr=rptr+nsn+1;
+  for (; nrhs>=4; nrhs-=4) {
+    // Multiply by P
+    for (i=0; i<n; ++i) {
+      wi = w + 4*i;
+      wi[0] = x[p[i]];
+      wi[1] = x[n+p[i]];
+      wi[2] = x[2*n+p[i]];
+      wi[3] = x[3*n+p[i]];
+    }
+    // Solve for L
+    for (s=0; s<nsn; ++s) {
+      f=col[s]; nc=col[s+1]-f; nb=rptr[s+1]-rptr[s]; nr=nc+nb;
+      ls=l+nzptr[s]; rs=nzptr+nsn+1+n+rptr[s];
+      for (j=0; j<nc; ++j) {
+        lj = ls + j*nr;
+        wj = w + 4*(f+j);
+        s0 = wj[0]; s1 = wj[1]; s2 = wj[2]; s3 = wj[3];
+        for (i=j+1; i<nc; ++i) {
+          e = lj[i];
+          wi = w + 4*(f+i);
+          wi[0] -= e*s0;
+          wi[1] -= e*s1;
+          wi[2] -= e*s2;
+          wi[3] -= e*s3;
+        }
+        for (i=0; i<nb; ++i) {
+          e = lj[nc+i];
+          wi = w + 4*rs[i];
+          wi[0] -= e*s0;
+          wi[1] -= e*s1;
+          wi[2] -= e*s2;
+          wi[3] -= e*s3;
+        }
+      }
+    }
+    // Divide by D
+    for (i=0; i<n; ++i) {
+      e = d[i];
+      wi = w + 4*i;
+      wi[0] /= e; wi[1] /= e; wi[2] /= e; wi[3] /= e;
+    }
+    // Solve for L'
+    for (s=nsn-1; s>=0; --s) {
+      f=col[s]; nc=col[s+1]-f; nb=rptr[s+1]-rptr[s]; nr=nc+nb;
+      ls=l+nzptr[s]; rs=nzptr+nsn+1+n+rptr[s];
+      for (j=nc-1; j>=0; --j) {
+        lj = ls + j*nr;
+        wj = w + 4*(f+j);
+        s0 = wj[0]; s1 = wj[1]; s2 = wj[2]; s3 = wj[3];
+        for (i=j+1; i<nc; ++i) {
+          e = lj[i];
+          wi = w + 4*(f+i);
+          s0 -= e*wi[0];
+          s1 -= e*wi[1];
+          s2 -= e*wi[2];
+          s3 -= e*wi[3];
+        }
+        for (i=0; i<nb; ++i) {
+          e = lj[nc+i];
+          wi = w + 4*rs[i];
+          s0 -= e*wi[0];
+          s1 -= e*wi[1];
+          s2 -= e*wi[2];
+          s3 -= e*wi[3];
+        }
+        wj[0] = s0; wj[1] = s1; wj[2] = s2; wj[3] = s3;
+      }
+    }
+    // Multiply by P'
+    for (i=0; i<n; ++i) {
+      wi = w + 4*i;
+      x[p[i]] = wi[0];
+      x[n+p[i]] = wi[1];
+      x[2*n+p[i]] = wi[2];
+      x[3*n+p[i]] = wi[3];
+    }
+    // Next panel
+    x += 4*n;
+  }
+  // Remaining right-hand-sides
+  casadi_ldl_sn_solve(x, nrhs, sn, l, d, p, w);
+}
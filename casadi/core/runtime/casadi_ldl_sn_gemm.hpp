@@ -0,0 +1,42 @@
+// NOLINT(legal/copyright)
+// SYMBOL "ldl_sn_gemm"
+// Dense update z -= x*y' of an LDL^T supernode, all matrices column-major
+// x is m-by-k, y is n-by-k, z is m-by-n, with leading dimensions ldx, ldy, ldz
+template<typename T1>
+void casadi_ldl_sn_gemm(casadi_int m, casadi_int n, casadi_int k,
+                        const T1* x, casadi_int ldx, const T1* y, casadi_int ldy,
+                        T1* z, casadi_int ldz) {
+  casadi_int i, j, l;
+  const T1 *xl;
+  T1 *z0, *z1, *z2, *z3, a, b0, b1, b2, b3;
+  // Blocks of four columns: each column of x is loaded once per block
+  for (j=0; j+4<=n; j+=4) {
+    z0 = z + j*ldz;
+    z1 = z0 + ldz;
+    z2 = z1 + ldz;
+    z3 = z2 + ldz;
+    for (l=0; l<k; ++l) {
+      xl = x + l*ldx;
+      b0 = y[j + l*ldy];
+      b1 = y[j+1 + l*ldy];
+      b2 = y[j+2 + l*ldy];
+      b3 = y[j+3 + l*ldy];
+      for (i=0; i<m; ++i) {
+        a = xl[i];
+        z0[i] -= a*b0;
+        z1[i] -= a*b1;
+        z2[i] -= a*b2;
+        z3[i] -= a*b3;
+      }
+    }
+  }
+  // Remaining columns
+  for (; j<n; ++j) {
+    z0 = z + j*ldz;
+    for (l=0; l<k; ++l) {
+      xl = x + l*ldx;
+      b0 = y[j + l*ldy];
+      for (i=0; i<m; ++i) z0[i] -= xl[i]*b0;
+    }
+  }
+}
@@ -0,0 +1,45 @@
+// NOLINT(legal/copyright)
+// SYMBOL "mtimes_dense"
+template<typename T1>
+void casadi_mtimes_dense(const T1* x, casadi_int nrow_x, casadi_int ncol_x,
+    const T1* y, casadi_int ncol_y, T1* z) {
+  casadi_int i, j, k;
+  const T1 *xk, *y0, *y1, *y2, *y3;
+  T1 *z0, *z1, *z2, *z3, a, b0, b1, b2, b3;
+  if (!x || !y || !z) return;
+  // Blocks of four columns: each column of x is loaded once per block
+  for (i=0; i+4<=ncol_y; i+=4) {
+    z0 = z + i*nrow_x;
+    z1 = z0 + nrow_x;
+    z2 = z1 + nrow_x;
+    z3 = z2 + nrow_x;
+    y0 = y + i*ncol_x;
+    y1 = y0 + ncol_x;
+    y2 = y1 + ncol_x;
+    y3 = y2 + ncol_x;
+    for (k=0; k<ncol_x; ++k) {
+      xk = x + k*nrow_x;
+      b0 = y0[k];
+      b1 = y1[k];
+      b2 = y2[k];
+      b3 = y3[k];
+      for (j=0; j<nrow_x; ++j) {
+        a = xk[j];
+        z0[j] += a*b0;
+        z1[j] += a*b1;
+        z2[j] += a*b2;
+        z3[j] += a*b3;
+      }
+    }
+  }
+  // Remaining columns
+  for (; i<ncol_y; ++i) {
+    z0 = z + i*nrow_x;
+    y0 = y + i*ncol_x;
+    for (k=0; k<ncol_x; ++k) {
+      xk = x + k*nrow_x;
+      b0 = y0[k];
+      for (j=0; j<nrow_x; ++j) z0[j] += xk[j]*b0;
+    }
+  }
+}
@@ -22,33 +22,29 @@ T1 casadi_house(T1* v, T1* beta, casadi_int nv) {
   return s;
 }
 
-// SYMBOL "qr"
-// Numeric QR factorization
-// Ref: Chapter 5, Direct Methods for Sparse Linear Systems by Tim Davis
-// len[x] = nrow
-// sp_v = [nrow, ncol, 0, 0, ...] len[3 + ncol + nnz_v]
-// len[v] nnz_v
-// sp_r = [nrow, ncol, 0, 0, ...] len[3 + ncol + nnz_r]
-// len[r] nnz_r
-// len[beta] ncol
+// SYMBOL "qr_cols"
+// Numeric QR factorization of the columns cols[0], ..., cols[ncols-1], cf. casadi_qr.
+// The columns must be given in increasing order and their descendants in the column
+// elimination tree must have been factorized before or be part of the list.
+// If cols is null, all columns are factorized.
+// len[x] = nrow, zero on entry and on exit
 template<typename T1>
-void casadi_qr(const casadi_int* sp_a, const T1* nz_a, T1* x,
-               const casadi_int* sp_v, T1* nz_v, const casadi_int* sp_r, T1* nz_r, T1* beta,
-               const casadi_int* prinv, const casadi_int* pc) {
+void casadi_qr_cols(const casadi_int* sp_a, const T1* nz_a, T1* x,
+                    const casadi_int* sp_v, T1* nz_v, const casadi_int* sp_r, T1* nz_r,
+                    T1* beta, const casadi_int* prinv, const casadi_int* pc,
+                    const casadi_int* cols, casadi_int ncols) {
    // Local variables
-   casadi_int ncol, nrow, r, c, k, k1;
+   casadi_int ncol, r, c, i, k, k1;
    T1 alpha;
    const casadi_int *a_colind, *a_row, *v_colind, *v_row, *r_colind, *r_row;
    // Extract sparsities
    ncol = sp_a[1];
    a_colind=sp_a+2; a_row=sp_a+2+ncol+1;
-   nrow = sp_v[0];
    v_colind=sp_v+2; v_row=sp_v+2+ncol+1;
    r_colind=sp_r+2; r_row=sp_r+2+ncol+1;
-   // Clear work vector
-   for (r=0; r<nrow; ++r) x[r] = 0;
    // Loop over columns of R, A and V
-   for (c=0; c<ncol; ++c) {
+   for (i=0; i<ncols; ++i) {
+     c = cols ? cols[i] : i;
      // Copy (permuted) column of A to x
      for (k=a_colind[pc[c]]; k<a_colind[pc[c]+1]; ++k) x[prinv[a_row[k]]] = nz_a[k];
      // Use the equality R = (I-betan*vn*vn')*...*(I-beta1*v1*v1')*A to get
@@ -61,41 +57,61 @@ void casadi_qr(const casadi_int* sp_a, const T1* nz_a, T1* x,
        // x -= alpha*v(:,r)
        for (k1=v_colind[r]; k1<v_colind[r+1]; ++k1) x[v_row[k1]] -= alpha*nz_v[k1];
        // Get r entry
-       *nz_r++ = x[r];
+       nz_r[k] = x[r];
        // Strictly upper triangular entries in x no longer needed
        x[r] = 0;
      }
      // Get V column
-     for (k=v_colind[c]; k<v_colind[c+1]; ++k) {
-       nz_v[k] = x[v_row[k]];
+     for (k1=v_colind[c]; k1<v_colind[c+1]; ++k1) {
+       nz_v[k1] = x[v_row[k1]];
        // Lower triangular entries of x no longer needed
-       x[v_row[k]] = 0;
+       x[v_row[k1]] = 0;
      }
      // Get diagonal entry of R, normalize V column
-     *nz_r++ = casadi_house(nz_v + v_colind[c], beta + c, v_colind[c+1] - v_colind[c]);
+     nz_r[k] = casadi_house(nz_v + v_colind[c], beta + c, v_colind[c+1] - v_colind[c]);
    }
  }
 
-// SYMBOL "qr_mv"
-// Multiply QR Q matrix from the right with a vector, with Q represented
-// by the Householder vectors V and beta
-// x = Q*x or x = Q'*x
-// with Q = (I-beta(1)*v(:,1)*v(:,1)')*...*(I-beta(n)*v(:,n)*v(:,n)')
-// len[x] >= nrow_ext
+// SYMBOL "qr"
+// Numeric QR factorization
+// Ref: Chapter 5, Direct Methods for Sparse Linear Systems by Tim Davis
+// len[x] = nrow
+// sp_v = [nrow, ncol, 0, 0, ...] len[3 + ncol + nnz_v]
+// len[v] nnz_v
+// sp_r = [nrow, ncol, 0, 0, ...] len[3 + ncol + nnz_r]
+// len[r] nnz_r
+// len[beta] ncol
 template<typename T1>
-void casadi_qr_mv(const casadi_int* sp_v, const T1* v, const T1* beta, T1* x,
-                  casadi_int tr) {
+void casadi_qr(const casadi_int* sp_a, const T1* nz_a, T1* x,
+               const casadi_int* sp_v, T1* nz_v, const casadi_int* sp_r, T1* nz_r, T1* beta,
+               const casadi_int* prinv, const casadi_int* pc) {
+   // Local variables
+   casadi_int nrow, r;
+   nrow = sp_v[0];
+   // Clear work vector
+   for (r=0; r<nrow; ++r) x[r] = 0;
+   // Factorize all columns
+   casadi_qr_cols(sp_a, nz_a, x, sp_v, nz_v, sp_r, nz_r, beta, prinv, pc, 0, sp_a[1]);
+ }
+
+// SYMBOL "qr_mv_cols"
+// Multiply with the Householder reflections of the columns cols[0], ..., cols[ncols-1]
+// (in increasing order, all columns if cols is null), cf. casadi_qr_mv
+template<typename T1>
+void casadi_qr_mv_cols(const casadi_int* sp_v, const T1* v, const T1* beta, T1* x,
+                       casadi_int tr, const casadi_int* cols, casadi_int ncols) {
   // Local variables
-  casadi_int ncol, c, c1, k;
+  casadi_int ncol, c, i, k;
   T1 alpha;
   const casadi_int *colind, *row;
   // Extract sparsity
   ncol=sp_v[1];
   colind=sp_v+2; row=sp_v+2+ncol+1;
   // Loop over vectors
-  for (c1=0; c1<ncol; ++c1) {
+  for (i=0; i<ncols; ++i) {
     // Forward order for transpose, otherwise backwards
-    c = tr ? c1 : ncol-1-c1;
+    c = tr ? i : ncols-1-i;
+    if (cols) c = cols[c];
     // Calculate scalar factor alpha = beta(c)*dot(v(:,c), x)
     alpha=0;
     for (k=colind[c]; k<colind[c+1]; ++k) alpha += v[k]*x[row[k]];
@@ -105,19 +121,34 @@ void casadi_qr_mv(const casadi_int* sp_v, const T1* v, const T1* beta, T1* x,
   }
 }
 
-// SYMBOL "qr_trs"
-// Solve for an (optionally transposed) upper triangular matrix R
+// SYMBOL "qr_mv"
+// Multiply QR Q matrix from the right with a vector, with Q represented
+// by the Householder vectors V and beta
+// x = Q*x or x = Q'*x
+// with Q = (I-beta(1)*v(:,1)*v(:,1)')*...*(I-beta(n)*v(:,n)*v(:,n)')
+// len[x] >= nrow_ext
 template<typename T1>
-void casadi_qr_trs(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr) {
+void casadi_qr_mv(const casadi_int* sp_v, const T1* v, const T1* beta, T1* x,
+                  casadi_int tr) {
+  casadi_qr_mv_cols(sp_v, v, beta, x, tr, 0, sp_v[1]);
+}
+
+// SYMBOL "qr_trs_cols"
+// Solve for an (optionally transposed) upper triangular matrix R, restricted to the
+// columns cols[0], ..., cols[ncols-1] (in increasing order, all columns if cols is null)
+template<typename T1>
+void casadi_qr_trs_cols(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr,
+                        const casadi_int* cols, casadi_int ncols) {
   // Local variables
-  casadi_int ncol, r, c, k;
+  casadi_int ncol, r, c, i, k;
   const casadi_int *colind, *row;
   // Extract sparsity
   ncol=sp_r[1];
   colind=sp_r+2; row=sp_r+2+ncol+1;
   if (tr) {
     // Forward substitution
-    for (c=0; c<ncol; ++c) {
+    for (i=0; i<ncols; ++i) {
+      c = cols ? cols[i] : i;
       for (k=colind[c]; k<colind[c+1]; ++k) {
         r = row[k];
         if (r==c) {
@@ -129,7 +160,8 @@ void casadi_qr_trs(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr)
     }
   } else {
     // Backward substitution
-    for (c=ncol-1; c>=0; --c) {
+    for (i=ncols-1; i>=0; --i) {
+      c = cols ? cols[i] : i;
       for (k=colind[c+1]-1; k>=colind[c]; --k) {
         r=row[k];
         if (r==c) {
@@ -142,6 +174,13 @@ void casadi_qr_trs(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr)
   }
 }
 
+// SYMBOL "qr_trs"
+// Solve for an (optionally transposed) upper triangular matrix R
+template<typename T1>
+void casadi_qr_trs(const casadi_int* sp_r, const T1* nz_r, T1* x, casadi_int tr) {
+  casadi_qr_trs_cols(sp_r, nz_r, x, tr, 0, sp_r[1]);
+}
+
 // SYMBOL "qr_solve"
 // Solve a factorized linear system
 // len[w] >= max(ncol, nrow_ext)
@@ -178,6 +217,136 @@ void casadi_qr_solve(T1* x, casadi_int nrhs, casadi_int tr,
   }
 }
 
+// SYMBOL "qr_solve_panel"
+// Solve a factorized linear system, with the right-hand-sides processed in panels
+// of four. The factors are traversed once per panel and the entries of a panel are
+// stored contiguously for each row of w.
+// len[w] >= 4*max(ncol, nrow_ext)
+template<typename T1>
+void casadi_qr_solve_panel(T1* x, casadi_int nrhs, casadi_int tr,
+                           const casadi_int* sp_v, const T1* v, const casadi_int* sp_r,
+                           const T1* r, const T1* beta, const casadi_int* prinv,
+                           const casadi_int* pc, T1* w) {
+  casadi_int nrow_ext, ncol, c, i, k;
+  const casadi_int *v_colind, *v_row, *r_colind, *r_row;
+  T1 e, s0, s1, s2, s3, *wc, *wr;
+  // Extract sparsities
+  nrow_ext = sp_v[0]; ncol = sp_v[1];
+  v_colind=sp_v+2; v_row=sp_v+2+ncol+1;
+  r_colind=sp_r+2; r_row=sp_r+2+ncol+1;
+  for (; nrhs>=4; nrhs-=4) {
+    if (tr) {
+      // (PR' Q R PC)' x = PC' R' Q' PR x = b <-> x = PR' Q R' \ PC b
+      // Multiply by PC
+      for (i=4*ncol; i<4*nrow_ext; ++i) w[i] = 0;
+      for (c=0; c<ncol; ++c) {
+        wc = w + 4*c;
+        wc[0] = x[pc[c]];
+        wc[1] = x[ncol+pc[c]];
+        wc[2] = x[2*ncol+pc[c]];
+        wc[3] = x[3*ncol+pc[c]];
+      }
+      //  Solve for R'
+      for (c=0; c<ncol; ++c) {
+        wc = w + 4*c;
+        s0 = wc[0]; s1 = wc[1]; s2 = wc[2]; s3 = wc[3];
+        for (k=r_colind[c]; k<r_colind[c+1]; ++k) {
+          i = r_row[k];
+          e = r[k];
+          if (i==c) {
+            s0 /= e; s1 /= e; s2 /= e; s3 /= e;
+          } else {
+            wr = w + 4*i;
+            s0 -= e*wr[0];
+            s1 -= e*wr[1];
+            s2 -= e*wr[2];
+            s3 -= e*wr[3];
+          }
+        }
+        wc[0] = s0; wc[1] = s1; wc[2] = s2; wc[3] = s3;
+      }
+    } else {
+      //PR' Q R PC x = b <-> x = PC' R \ Q' PR b
+      // Multiply with PR
+      for (i=0; i<4*nrow_ext; ++i) w[i] = 0;
+      for (c=0; c<ncol; ++c) {
+        wr = w + 4*prinv[c];
+        wr[0] = x[c];
+        wr[1] = x[ncol+c];
+        wr[2] = x[2*ncol+c];
+        wr[3] = x[3*ncol+c];
+      }
+    }
+    // Multiply with Q' (forward order) or Q (backward order)
+    for (i=0; i<ncol; ++i) {
+      c = tr ? ncol-1-i : i;
+      // Scalar factors alpha = beta(c)*dot(v(:,c), w)
+      s0 = s1 = s2 = s3 = 0;
+      for (k=v_colind[c]; k<v_colind[c+1]; ++k) {
+        e = v[k];
+        wr = w + 4*v_row[k];
+        s0 += e*wr[0];
+        s1 += e*wr[1];
+        s2 += e*wr[2];
+        s3 += e*wr[3];
+      }
+      e = beta[c];
+      s0 *= e; s1 *= e; s2 *= e; s3 *= e;
+      // w -= alpha*v(:,c)
+      for (k=v_colind[c]; k<v_colind[c+1]; ++k) {
+        e = v[k];
+        wr = w + 4*v_row[k];
+        wr[0] -= e*s0;
+        wr[1] -= e*s1;
+        wr[2] -= e*s2;
+        wr[3] -= e*s3;
+      }
+    }
+    if (tr) {
+      // Multiply by PR'
+      for (c=0; c<ncol; ++c) {
+        wr = w + 4*prinv[c];
+        x[c] = wr[0];
+        x[ncol+c] = wr[1];
+        x[2*ncol+c] = wr[2];
+        x[3*ncol+c] = wr[3];
+      }
+    } else {
+      //  Solve for R
+      for (c=ncol-1; c>=0; --c) {
+        wc = w + 4*c;
+        s0 = wc[0]; s1 = wc[1]; s2 = wc[2]; s3 = wc[3];
+        for (k=r_colind[c+1]-1; k>=r_colind[c]; --k) {
+          i = r_row[k];
+          e = r[k];
+          if (i==c) {
+            s0 /= e; s1 /= e; s2 /= e; s3 /= e;
+            wc[0] = s0; wc[1] = s1; wc[2] = s2; wc[3] = s3;
+          } else {
+            wr = w + 4*i;
+            wr[0] -= e*s0;
+            wr[1] -= e*s1;
+            wr[2] -= e*s2;
+            wr[3] -= e*s3;
+          }
+        }
+      }
+      // Multiply with PC'
+      for (c=0; c<ncol; ++c) {
+        wc = w + 4*c;
+        x[pc[c]] = wc[0];
+        x[ncol+pc[c]] = wc[1];
+        x[2*ncol+pc[c]] = wc[2];
+        x[3*ncol+pc[c]] = wc[3];
+      }
+    }
+    // Next panel
+    x += 4*ncol;
+  }
+  // Remaining right-hand-sides
+  casadi_qr_solve(x, nrhs, tr, sp_v, v, sp_r, r, beta, prinv, pc, w);
+}
+
 // SYMBOL "qr_singular"
 // Check if QR factorization corresponds to a singular matrix
 template<typename T1>
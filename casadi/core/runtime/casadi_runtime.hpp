@@ -90,6 +90,11 @@ namespace casadi {
   void casadi_mtimes(const T1* x, const casadi_int* sp_x, const T1* y, const casadi_int* sp_y,
                              T1* z, const casadi_int* sp_z, T1* w, casadi_int tr);
 
+  /// Dense matrix-matrix multiplication: z <- z + x*y
+  template<typename T1>
+  void casadi_mtimes_dense(const T1* x, casadi_int nrow_x, casadi_int ncol_x,
+                           const T1* y, casadi_int ncol_y, T1* z);
+
   /// Sparse matrix-vector multiplication: z <- z + x*y
   template<typename T1>
   void casadi_mv(const T1* x, const casadi_int* sp_x, const T1* y, T1* z, casadi_int tr);
@@ -243,6 +248,7 @@ namespace casadi {
   #include "casadi_vfmax.hpp"
   #include "casadi_sum_viol.hpp"
   #include "casadi_mtimes.hpp"
+  #include "casadi_mtimes_dense.hpp"
   #include "casadi_mv.hpp"
   #include "casadi_trans.hpp"
   #include "casadi_norm_1.hpp"
@@ -265,6 +271,8 @@ namespace casadi {
   #include "casadi_finite_diff.hpp"
   #include "casadi_file_slurp.hpp"
   #include "casadi_ldl.hpp"
+  #include "casadi_ldl_sn_gemm.hpp"
+  #include "casadi_ldl_sn.hpp"
   #include "casadi_qr.hpp"
   #include "casadi_qp.hpp"
   #include "casadi_nlp.hpp"
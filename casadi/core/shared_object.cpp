@@ -96,6 +96,21 @@ namespace casadi {
     }
   }
 
+  bool SharedObject::own_if_alive(SharedObjectInternal* node_) {
+#ifdef CASADI_WITH_THREAD
+    casadi_int c = node_->count.load(std::memory_order_relaxed);
+    do {
+      if (c==0) return false;
+    } while (!node_->count.compare_exchange_weak(c, c+1));
+#else // CASADI_WITH_THREAD
+    if (node_->count==0) return false;
+    node_->count++;
+#endif // CASADI_WITH_THREAD
+    count_down();
+    node = node_;
+    return true;
+  }
+
   SharedObjectInternal* SharedObject::operator->() const {
     casadi_assert_dev(!is_null());
     return node;
@@ -156,6 +156,13 @@ namespace casadi {
   protected:
     void count_up(); // increase counter of the node
     void count_down(); // decrease counter of the node
+
+    /** \brief Take ownership of a node, unless its counter has already reached zero
+
+        Used by caches that hold nodes without owning them: a node whose counter
+        has reached zero is being destroyed and must not be handed out again.
+    */
+    bool own_if_alive(SharedObjectInternal* node);
   private:
     SharedObjectInternal *node;
 #endif // SWIG
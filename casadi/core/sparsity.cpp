@@ -31,6 +31,14 @@
 #include "serializing_stream.hpp"
 #include <climits>
 
+#ifdef CASADI_WITH_THREAD
+#ifdef CASADI_WITH_THREAD_MINGW
+#include <mingw.mutex.h>
+#else // CASADI_WITH_THREAD_MINGW
+#include <mutex>
+#endif // CASADI_WITH_THREAD_MINGW
+#endif // CASADI_WITH_THREAD
+
 #define CASADI_THROW_ERROR(FNAME, WHAT) \
 throw CasadiException("Error in Sparsity::" FNAME " at " + CASADI_WHERE + ":\n"\
   + std::string(WHAT));
@@ -70,6 +78,26 @@ namespace casadi {
   };
   /// \endcond
 
+  namespace {
+    // Cached sparsity patterns with the same hash modulo the number of shards
+    struct SparsityCacheShard {
+#ifdef CASADI_WITH_THREAD
+      std::mutex mtx;
+#endif // CASADI_WITH_THREAD
+      // Non-owning, patterns remove themselves on destruction
+      std::unordered_multimap<std::size_t, SparsityInternal*> map;
+    };
+
+    // The cache is sharded so that threads creating patterns rarely contend
+    const std::size_t n_sparsity_cache_shard = 64;
+
+    SparsityCacheShard& sparsity_cache_shard(std::size_t h) {
+      // Never destroyed, since patterns held by static objects may be released at exit
+      static SparsityCacheShard* shards = new SparsityCacheShard[n_sparsity_cache_shard];
+      return shards[h % n_sparsity_cache_shard];
+    }
+  } // namespace
+
   Sparsity::Sparsity(casadi_int dummy) {
     casadi_assert_dev(dummy==0);
   }
@@ -501,11 +529,6 @@ namespace casadi {
     }
   }
 
-  Sparsity::CachingMap& Sparsity::getCache() {
-    static CachingMap ret;
-    return ret;
-  }
-
   const Sparsity& Sparsity::getScalar() {
     static ScalarSparsity ret;
     return ret;
@@ -688,6 +711,10 @@ namespace casadi {
     return (*this)->amd();
   }
 
+  std::vector<casadi_int> Sparsity::nd() const {
+    return (*this)->nd();
+  }
+
   casadi_int Sparsity::btf(std::vector<casadi_int>& rowperm, std::vector<casadi_int>& colperm,
                             std::vector<casadi_int>& rowblock, std::vector<casadi_int>& colblock,
                             std::vector<casadi_int>& coarse_rowblock,
@@ -853,90 +880,45 @@ namespace casadi {
     // Hash the pattern
     std::size_t h = hash_sparsity(nrow, ncol, colind, row);
 
-    // Get a reference to the cache
-    CachingMap& cache = getCache();
-
-    // Record the current number of buckets (for garbage collection below)
-    casadi_int bucket_count_before = cache.bucket_count();
-
-    // WORKAROUND, functions do not appear to work when bucket_count==0
-    if (bucket_count_before>0) {
+    // Look for the pattern in the cache, or add it
+    Sparsity ret;
+    {
+      SparsityCacheShard& shard = sparsity_cache_shard(h);
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(shard.mtx);
+#endif // CASADI_WITH_THREAD
 
       // Find the range of patterns equal to the key (normally only zero or one)
-      pair<CachingMap::iterator, CachingMap::iterator> eq = cache.equal_range(h);
-
-      // Loop over maching patterns
-      for (CachingMap::iterator i=eq.first; i!=eq.second; ++i) {
-
-        // Get a weak reference to the cached sparsity pattern
-        WeakRef& wref = i->second;
-
-        // Check if the pattern still exists
-        if (wref.alive()) {
-
-          // Get an owning reference to the cached pattern
-          Sparsity ref = shared_cast<Sparsity>(wref.shared());
-
-          // Check if the pattern matches
-          if (ref.is_equal(nrow, ncol, colind, row)) {
+      auto eq = shard.map.equal_range(h);
 
-            // Found match!
-            own(ref.get());
-            return;
-
-          } else { // There is a hash rowision (unlikely, but possible)
-            // Leave the pattern alone, continue to the next matching pattern
-            continue;
-          }
-        } else {
-
-          // Check if one of the other cache entries indeed has a matching sparsity
-          CachingMap::iterator j=i;
-          j++; // Start at the next matching key
-          for (; j!=eq.second; ++j) {
-            if (j->second.alive()) {
-
-              // Recover cached sparsity
-              Sparsity ref = shared_cast<Sparsity>(j->second.shared());
-
-              // Match found if sparsity matches
-              if (ref.is_equal(nrow, ncol, colind, row)) {
-                own(ref.get());
-                return;
-              }
-            }
-          }
-
-          // The cached entry has been deleted, create a new one
-          own(new SparsityInternal(nrow, ncol, colind, row));
-
-          // Cache this pattern
-          wref = *this;
+      // Loop over matching patterns, skipping ones that are being destroyed
+      for (auto i=eq.first; i!=eq.second; ++i) {
+        if (i->second->is_equal(nrow, ncol, colind, row) && ret.own_if_alive(i->second)) break;
+      }
 
-          // Return
-          return;
-        }
+      // No matching sparsity pattern could be found, create a new one
+      if (ret.is_null()) {
+        SparsityInternal* n = new SparsityInternal(nrow, ncol, colind, row);
+        n->set_cached(h);
+        ret.own(n);
+        shard.map.insert(std::make_pair(h, n));
       }
     }
 
-    // No matching sparsity pattern could be found, create a new one
-    own(new SparsityInternal(nrow, ncol, colind, row));
-
-    // Cache this pattern
-    cache.insert(std::pair<std::size_t, WeakRef>(h, *this));
-
-    // Garbage collection (currently only supported for unordered_multimap)
-    casadi_int bucket_count_after = cache.bucket_count();
+    // Assign outside of the lock, since this may release a cached pattern
+    *this = ret;
+  }
 
-    // We we increased the number of buckets, take time to garbage-collect deleted references
-    if (bucket_count_before!=bucket_count_after) {
-      CachingMap::const_iterator i=cache.begin();
-      while (i!=cache.end()) {
-        if (!i->second.alive()) {
-          i = cache.erase(i);
-        } else {
-          i++;
-        }
+  void Sparsity::uncache(std::size_t h, const SparsityInternal* sp) {
+    SparsityCacheShard& shard = sparsity_cache_shard(h);
+#ifdef CASADI_WITH_THREAD
+    std::lock_guard<std::mutex> lock(shard.mtx);
+#endif // CASADI_WITH_THREAD
+    auto eq = shard.map.equal_range(h);
+    for (auto i=eq.first; i!=eq.second; ++i) {
+      if (i->second==sp) {
+        shard.map.erase(i);
+        return;
       }
     }
   }
@@ -656,10 +656,8 @@ namespace casadi {
     void removeDuplicates(std::vector<casadi_int>& SWIG_INOUT(mapping));
 
 #ifndef SWIG
-    typedef std::unordered_multimap<std::size_t, WeakRef> CachingMap;
-
-    /// Cached sparsity patterns
-    static CachingMap& getCache();
+    /// Remove a pattern that is being destroyed from the cache of sparsity patterns
+    static void uncache(std::size_t h, const SparsityInternal* sp);
 
     /// (Dense) scalar
     static const Sparsity& getScalar();
@@ -773,6 +771,14 @@ namespace casadi {
     */
     std::vector<casadi_int> amd() const;
 
+    /** \brief Nested dissection preordering
+      Fill-reducing ordering that recursively splits the graph of a symmetric pattern
+      by small vertex separators, which are ordered last. Yields less fill-in than amd
+      for large banded or grid-like patterns and a balanced elimination tree.
+      Small subgraphs are ordered with amd.
+    */
+    std::vector<casadi_int> nd() const;
+
 #ifndef SWIG
     /** \brief Propagate sparsity through a linear solve
      */
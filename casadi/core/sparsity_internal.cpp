@@ -448,10 +448,115 @@ namespace casadi {
     }
   }
 
+  casadi_int SparsityInternal::
+  ldl_supernodes(casadi_int n, const casadi_int* parent, const casadi_int* l_colind,
+      casadi_int* sn_col) {
+    casadi_int c, nc, nr, nz=0, stored, nsn=0;
+    for (c=0; c<n; ++c) {
+      // Can c be added to the supernode of c-1?
+      if (c>0 && parent[c-1]==c) {
+        // Entries of the merged panel below the diagonal, nonzeros among them
+        nc = c - sn_col[nsn-1] + 1;
+        nr = nc + l_colind[c+1] - l_colind[c];
+        stored = nc*nr - nc*(nc+1)/2;
+        nz += l_colind[c+1] - l_colind[c];
+        // Allow explicit zeros, fewer the wider the supernode
+        if (nz==stored || nc<=4 || (nc<=16 && 5*(stored-nz)<=4*stored)
+            || (nc<=48 && 10*(stored-nz)<=stored) || 20*(stored-nz)<=stored) continue;
+      }
+      // Start a new supernode
+      sn_col[nsn++] = c;
+      nz = l_colind[c+1] - l_colind[c];
+    }
+    sn_col[nsn] = n;
+    return nsn;
+  }
+
+  casadi_int SparsityInternal::
+  etree_partition(casadi_int n, const casadi_int* parent, const double* cost,
+      casadi_int n_part, std::vector<casadi_int>& ptr, std::vector<casadi_int>& col) {
+    casadi_int c, k;
+    // Accumulated cost of each subtree, children are numbered before their parents
+    std::vector<double> st(cost, cost+n);
+    for (c=0; c<n; ++c) if (parent[c]>=0) st[parent[c]] += st[c];
+    // Linked lists of children
+    std::vector<casadi_int> head(n, -1), next(n, -1);
+    for (c=n-1; c>=0; --c) {
+      if (parent[c]>=0) {
+        next[c] = head[parent[c]];
+        head[parent[c]] = c;
+      }
+    }
+    // Subtrees to be processed in parallel, heaviest first
+    std::vector<std::pair<double, casadi_int>> heap;
+    double sum = 0, top = 0;
+    for (c=0; c<n; ++c) {
+      if (parent[c]<0) {
+        heap.push_back(std::make_pair(st[c], c));
+        sum += st[c];
+      }
+    }
+    std::make_heap(heap.begin(), heap.end());
+    // Split until the subtrees can be balanced, keep the best split
+    std::vector<casadi_int> split;
+    double best = sum;
+    casadi_int n_split = 0;
+    while (!heap.empty() && heap.front().first*n_part > sum && top < best) {
+      // Move the root of the heaviest subtree to the top
+      c = heap.front().second;
+      std::pop_heap(heap.begin(), heap.end());
+      heap.pop_back();
+      split.push_back(c);
+      top += cost[c];
+      sum -= st[c];
+      for (k=head[c]; k>=0; k=next[k]) {
+        heap.push_back(std::make_pair(st[k], k));
+        std::push_heap(heap.begin(), heap.end());
+      }
+      // Estimated time: top of the tree, the heaviest subtree or an even split
+      double t = top + std::max(heap.empty() ? 0 : heap.front().first, sum/n_part);
+      if (t<best) {
+        best = t;
+        n_split = split.size();
+      }
+    }
+    // Mark the top of the tree
+    std::vector<casadi_int> part(n, 0);
+    for (k=0; k<n_split; ++k) part[split[k]] = -1;
+    // Subtree roots, by decreasing cost
+    std::vector<std::pair<double, casadi_int>> roots;
+    for (c=0; c<n; ++c) {
+      if (part[c]>=0 && (parent[c]<0 || part[parent[c]]<0)) {
+        roots.push_back(std::make_pair(-st[c], c));
+      }
+    }
+    std::sort(roots.begin(), roots.end());
+    for (k=0; k<static_cast<casadi_int>(roots.size()); ++k) part[roots[k].second] = -2-k;
+    // Descendants inherit the subtree of their parents
+    for (c=n-1; c>=0; --c) {
+      if (part[c]<-1) {
+        part[c] = -2-part[c];
+      } else if (part[c]>=0) {
+        part[c] = part[parent[c]];
+      }
+    }
+    // Sort the columns by subtree, top of the tree last
+    casadi_int nsub = roots.size();
+    ptr.assign(nsub+2, 0);
+    for (c=0; c<n; ++c) ptr[(part[c]<0 ? nsub : part[c]) + 1]++;
+    for (k=0; k<=nsub; ++k) ptr[k+1] += ptr[k];
+    col.resize(n);
+    for (c=0; c<n; ++c) col[ptr[part[c]<0 ? nsub : part[c]]++] = c;
+    for (k=nsub; k>0; --k) ptr[k] = ptr[k-1];
+    ptr[0] = 0;
+    ptr.resize(nsub+1);
+    return nsub;
+  }
+
   SparsityInternal::
   SparsityInternal(casadi_int nrow, casadi_int ncol,
       const casadi_int* colind, const casadi_int* row) :
-    sp_(2 + ncol+1 + colind[ncol]), btf_(nullptr) {
+    sp_(2 + ncol+1 + colind[ncol]), btf_(nullptr), cached_(false), cache_key_(0) {
     sp_[0] = nrow;
     sp_[1] = ncol;
     std::copy(colind, colind+ncol+1, sp_.begin()+2);
@@ -459,6 +564,7 @@ namespace casadi {
   }
 
   SparsityInternal::~SparsityInternal() {
+    if (cached_) Sparsity::uncache(cache_key_, this);
     delete btf_;
   }
 
@@ -961,6 +1067,214 @@ namespace casadi {
     #undef FLIP
   }
 
+  namespace {
+    // Recursive nested dissection of the graph of a symmetric sparsity pattern
+    struct NestedDissection {
+      // Graph, diagonal entries are ignored
+      const casadi_int *colind, *row;
+      // Subgraph containing each vertex, -1 if already ordered
+      std::vector<casadi_int> part;
+      // Breadth-first search levels, -1 if not visited
+      std::vector<casadi_int> level;
+      // Number of subgraphs created
+      casadi_int n_part;
+      // Elimination order
+      std::vector<casadi_int> order;
+      // Subgraphs up to this size are ordered with AMD
+      static const casadi_int n_leaf = 64;
+
+      NestedDissection(casadi_int n, const casadi_int* colind, const casadi_int* row)
+        : colind(colind), row(row), part(n, 0), level(n, -1), n_part(1) {
+        order.reserve(n);
+      }
+
+      // Breadth-first search within the subgraph of v, returns the eccentricity of v
+      casadi_int bfs(casadi_int v, std::vector<casadi_int>& q) {
+        casadi_int p = part[v];
+        q.assign(1, v);
+        level[v] = 0;
+        for (size_t i=0; i<q.size(); ++i) {
+          casadi_int u = q[i];
+          for (casadi_int k=colind[u]; k<colind[u+1]; ++k) {
+            casadi_int w = row[k];
+            if (part[w]==p && level[w]<0) {
+              level[w] = level[u] + 1;
+              q.push_back(w);
+            }
+          }
+        }
+        return level[q.back()];
+      }
+
+      // Clear the levels after a search
+      void clear(const std::vector<casadi_int>& q) {
+        for (casadi_int v : q) level[v] = -1;
+      }
+
+      // Order a small subgraph with AMD
+      void leaf(std::vector<casadi_int>& verts) {
+        casadi_int nv = verts.size();
+        if (nv<=2) {
+          order.insert(order.end(), verts.begin(), verts.end());
+          return;
+        }
+        std::sort(verts.begin(), verts.end());
+        for (casadi_int i=0; i<nv; ++i) level[verts[i]] = i;
+        std::vector<casadi_int> sub_colind(1, 0), sub_row;
+        for (casadi_int v : verts) {
+          for (casadi_int k=colind[v]; k<colind[v+1]; ++k) {
+            casadi_int w = row[k];
+            if (part[w]==part[v]) sub_row.push_back(level[w]);
+          }
+          sub_colind.push_back(sub_row.size());
+        }
+        clear(verts);
+        std::vector<casadi_int> p = Sparsity(nv, nv, sub_colind, sub_row).amd();
+        for (casadi_int i : p) order.push_back(verts[i]);
+      }
+
+      // Order the vertices of a subgraph, all with the same part
+      void dissect(std::vector<casadi_int>& verts) {
+        casadi_int nv = verts.size();
+        if (nv<=n_leaf) {
+          leaf(verts);
+          return;
+        }
+        std::vector<casadi_int> q;
+        bfs(verts[0], q);
+        if (static_cast<casadi_int>(q.size())<nv) {
+          // Label all connected components in one pass
+          std::vector<std::vector<casadi_int> > comp(1, q);
+          for (casadi_int v : verts) {
+            if (level[v]>=0) continue;
+            bfs(v, q);
+            comp.push_back(q);
+          }
+          for (auto&& c : comp) clear(c);
+          verts.clear();
+          // Small components are grouped into leaves, larger ones dissected separately
+          std::vector<casadi_int> group;
+          for (auto&& c : comp) {
+            casadi_int nc = c.size();
+            if (nc>n_leaf/2) {
+              for (casadi_int v : c) part[v] = n_part;
+              n_part++;
+              dissect(c);
+            } else {
+              // No edges between components, the part can be shared
+              if (static_cast<casadi_int>(group.size())+nc>n_leaf) {
+                leaf(group);
+                group.clear();
+              }
+              group.insert(group.end(), c.begin(), c.end());
+            }
+          }
+          if (!group.empty()) leaf(group);
+          return;
+        }
+        // Pseudo-peripheral vertex, cf. George and Liu
+        casadi_int v = verts[0], ecc = level[q.back()];
+        for (casadi_int iter=0; iter<8; ++iter) {
+          // Vertex of smallest degree in the last level
+          casadi_int u = q.back();
+          for (casadi_int i=q.size()-1; i>=0 && level[q[i]]==ecc; --i) {
+            if (colind[q[i]+1]-colind[q[i]] < colind[u+1]-colind[u]) u = q[i];
+          }
+          clear(q);
+          casadi_int ecc_u = bfs(u, q);
+          if (ecc_u<=ecc) {
+            clear(q);
+            bfs(v, q);
+            break;
+          }
+          v = u;
+          ecc = ecc_u;
+        }
+        // Too few levels to separate
+        if (ecc<2) {
+          clear(q);
+          leaf(verts);
+          return;
+        }
+        // Separate at the level minimizing |S|/(|A||B|)
+        std::vector<casadi_int> count(ecc+1, 0);
+        for (casadi_int u : q) count[level[u]]++;
+        casadi_int sep = -1, n_a = 0;
+        double best = 0;
+        for (casadi_int l=1; l<ecc; ++l) {
+          n_a += count[l-1];
+          casadi_int n_b = nv - n_a - count[l];
+          double r = static_cast<double>(count[l]) / (static_cast<double>(n_a) * n_b);
+          if (sep<0 || r<best) {
+            sep = l;
+            best = r;
+          }
+        }
+        // Thin the separator: vertices without neighbors on one side join the other side
+        std::vector<casadi_int> a, b, s;
+        for (casadi_int u : q) {
+          if (level[u]!=sep) continue;
+          bool has_b = false;
+          for (casadi_int k=colind[u]; k<colind[u+1] && !has_b; ++k) {
+            casadi_int w = row[k];
+            has_b = part[w]==part[u] && level[w]>sep;
+          }
+          if (!has_b) level[u] = sep-1;
+        }
+        for (casadi_int u : q) {
+          if (level[u]!=sep) continue;
+          bool has_a = false;
+          for (casadi_int k=colind[u]; k<colind[u+1] && !has_a; ++k) {
+            casadi_int w = row[k];
+            has_a = part[w]==part[u] && level[w]<sep;
+          }
+          if (!has_a) level[u] = sep+1;
+        }
+        for (casadi_int u : q) {
+          if (level[u]<sep) {
+            a.push_back(u);
+          } else if (level[u]>sep) {
+            b.push_back(u);
+          } else {
+            s.push_back(u);
+          }
+        }
+        clear(q);
+        // Recursion, separator last
+        for (casadi_int u : a) part[u] = n_part;
+        for (casadi_int u : b) part[u] = n_part+1;
+        for (casadi_int u : s) part[u] = -1;
+        n_part += 2;
+        verts.clear();
+        dissect(a);
+        dissect(b);
+        std::sort(s.begin(), s.end());
+        order.insert(order.end(), s.begin(), s.end());
+      }
+    };
+  } // namespace
+
+  std::vector<casadi_int> SparsityInternal::nd() const {
+    casadi_assert(is_symmetric(), "Nested dissection requires a symmetric matrix");
+    casadi_int n = size2();
+    NestedDissection nd(n, colind(), row());
+    // Dense rows, as in AMD, are ordered last
+    casadi_int dense = static_cast<casadi_int>(10*sqrt(static_cast<double>(n)));
+    dense = std::max(casadi_int(16), dense);
+    std::vector<casadi_int> verts, dense_verts;
+    for (casadi_int c=0; c<n; ++c) {
+      if (colind()[c+1]-colind()[c] > dense) {
+        dense_verts.push_back(c);
+        nd.part[c] = -1;
+      } else {
+        verts.push_back(c);
+      }
+    }
+    nd.dissect(verts);
+    nd.order.insert(nd.order.end(), dense_verts.begin(), dense_verts.end());
+    return nd.order;
+  }
+
   void SparsityInternal::bfs(casadi_int n, std::vector<casadi_int>& wi, std::vector<casadi_int>& wj,
                               std::vector<casadi_int>& queue, const std::vector<casadi_int>& imatch,
                               const std::vector<casadi_int>& jmatch, casadi_int mark) const {
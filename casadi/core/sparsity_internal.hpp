@@ -56,6 +56,11 @@ namespace casadi {
     */
     mutable Btf* btf_;
 
+    /* \brief Whether the pattern is in the cache of sparsity patterns, and its hash key
+    */
+    bool cached_;
+    std::size_t cache_key_;
+
   public:
     /// Construct a sparsity pattern from arrays
     SparsityInternal(casadi_int nrow, casadi_int ncol,
@@ -64,6 +69,9 @@ namespace casadi {
     /// Destructor
     ~SparsityInternal() override;
 
+    /// Mark as entered in the cache of sparsity patterns with hash key h
+    void set_cached(std::size_t h) { cached_ = true; cache_key_ = h;}
+
     /** \brief Get number of rows (see public class) */
     inline const std::vector<casadi_int>& sp() const { return sp_;}
 
@@ -117,6 +125,13 @@ namespace casadi {
       */
     std::vector<casadi_int> amd() const;
 
+    /** \brief Nested dissection preordering
+      * Recursive bisection of the graph of the pattern by vertex separators, taken from
+      * level structures rooted at pseudo-peripheral vertices and thinned afterwards.
+      * Subgraphs with at most 64 vertices are ordered with AMD, dense rows last.
+      */
+    std::vector<casadi_int> nd() const;
+
     /** \brief Calculate the elimination tree for a matrix
       * len[w] >= ata ? ncol + nrow : ncol
       * len[parent] == ncol
@@ -232,6 +247,31 @@ namespace casadi {
     static void ldl_row(const casadi_int* sp, const casadi_int* parent,
       casadi_int* l_colind, casadi_int* l_row, casadi_int *w);
 
+    /** \brief Detect the supernodes of an LDL^T factorization
+      * A supernode is a chain c, c+1, ... in the elimination tree, stored as a dense
+      * panel with the rows of its last column below the diagonal block. Fundamental
+      * supernodes, where the pattern is shared exactly, are relaxed by allowing a
+      * number of explicit zeros that decreases with the width of the supernode.
+      * Strictly lower entries of L only, as returned by ldl_colind.
+      * len[sn_col] >= ncol+1, gets the first column of each supernode
+      * Returns the number of supernodes
+      */
+    static casadi_int ldl_supernodes(casadi_int n, const casadi_int* parent,
+      const casadi_int* l_colind, casadi_int* sn_col);
+
+    /** \brief Partition an elimination tree into independent subtrees
+      * The heaviest subtree is split repeatedly, moving its root to the top of the
+      * tree, for as long as this reduces the estimated time of processing the subtrees
+      * on n_part workers followed by the top of the tree on one worker.
+      * Requires parent[c]>c for all non-roots, len[cost] == n
+      * On return, subtree k (by decreasing cost) has the columns col[ptr[k]], ...,
+      * col[ptr[k+1]-1] and the top of the tree the columns col[ptr[nsub]], ..., col[n-1],
+      * all in increasing order. Returns the number of subtrees nsub
+      */
+    static casadi_int etree_partition(casadi_int n, const casadi_int* parent,
+      const double* cost, casadi_int n_part, std::vector<casadi_int>& ptr,
+      std::vector<casadi_int>& col);
+
     /// Transpose the matrix
     Sparsity T() const;
 
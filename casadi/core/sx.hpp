@@ -160,6 +160,12 @@ template<> inline std::string matrixName<SXElem>() { return "SX"; }
                          const std::string& v_prefix,
                          const std::string& v_suffix);
 
+  template<>
+  SX SX::cse(const SX& e);
+
+  template<>
+  std::vector<SX> SX::cse(const std::vector<SX>& e);
+
   template<>
   SX SX::poly_coeff(const SX& ex, const SX& x);
 
@@ -40,9 +40,17 @@ namespace casadi {
 
 
 
-  // Allocate storage for the caching
-  CACHING_MAP<casadi_int, IntegerSX*> IntegerSX::cached_constants_;
-  CACHING_MAP<double, RealtypeSX*> RealtypeSX::cached_constants_;
+  // Allocate storage for the caching, never destroyed since constant nodes
+  // held by static objects may be released at exit
+  ConstantCache<casadi_int, IntegerSX>& IntegerSX::cached_constants() {
+    static ConstantCache<casadi_int, IntegerSX>* ret = new ConstantCache<casadi_int, IntegerSX>();
+    return *ret;
+  }
+
+  ConstantCache<double, RealtypeSX>& RealtypeSX::cached_constants() {
+    static ConstantCache<double, RealtypeSX>* ret = new ConstantCache<double, RealtypeSX>();
+    return *ret;
+  }
 
   SXElem::SXElem() {
     node = casadi_limits<SXElem>::nan.node;
@@ -70,13 +78,21 @@ namespace casadi {
       else if (intval == 1)        node = casadi_limits<SXElem>::one.node;
       else if (intval == 2)        node = casadi_limits<SXElem>::two.node;
       else if (intval == -1)       node = casadi_limits<SXElem>::minus_one.node;
-      else                        node = IntegerSX::create(intval);
+      else {
+        // Cached nodes are returned already counted
+        node = IntegerSX::create(intval);
+        return;
+      }
       node->count++;
     } else {
       if (isnan(val))              node = casadi_limits<SXElem>::nan.node;
       else if (isinf(val))         node = val > 0 ? casadi_limits<SXElem>::inf.node :
                                       casadi_limits<SXElem>::minus_inf.node;
-      else                        node = RealtypeSX::create(val);
+      else {
+        // Cached nodes are returned already counted
+        node = RealtypeSX::create(val);
+        return;
+      }
       node->count++;
     }
   }
@@ -517,7 +533,7 @@ namespace casadi {
   const SXElem casadi_limits<SXElem>::zero(ZeroSX::singleton(), false);
   // node corresponding to a constant 1
   const SXElem casadi_limits<SXElem>::one(OneSX::singleton(), false);
-  // node corresponding to a constant 2
+  // node corresponding to a constant 2, holds an extra reference from its creation
   const SXElem casadi_limits<SXElem>::two(IntegerSX::create(2), false);
   // node corresponding to a constant -1
   const SXElem casadi_limits<SXElem>::minus_one(MinusOneSX::singleton(), false);
@@ -598,7 +614,7 @@ namespace casadi {
   }
 
   SXElem SXElem::deserialize(DeserializingStream& s) {
-    return SXElem::create(SXNode::deserialize(s));
+    return SXNode::deserialize(s);
   }
 
 } // namespace casadi
@@ -30,6 +30,8 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <cstring>
+#include <unordered_map>
 #include "casadi_misc.hpp"
 #include "sx_node.hpp"
 #include "casadi_common.hpp"
@@ -53,6 +55,7 @@ namespace casadi {
     // Default (persistent) options
     just_in_time_opencl_ = false;
     just_in_time_sparsity_ = false;
+    compiled_tape_ = false;
   }
 
   SXFunction::~SXFunction() {
@@ -75,6 +78,9 @@ namespace casadi {
     // class structure can cause large performance losses. For this reason,
     // the preprocessor macros are used below
 
+    // Evaluate the compiled tape, if available
+    if (compiled_tape_) return eval_tape(arg, res, w);
+
     // Evaluate the algorithm
     for (auto&& e : algorithm_) {
       switch (e.op) {
@@ -90,6 +96,301 @@ namespace casadi {
     return 0;
   }
 
+  int SXFunction::eval_batch(const double** arg, double** res, casadi_int* iw, double* w,
+                             void* mem, casadi_int n) const {
+    if (verbose_) casadi_message(name_ + "::eval_batch");
+
+    // Make sure no free parameters
+    if (!free_vars_.empty()) {
+      std::stringstream ss;
+      disp(ss, false);
+      casadi_error("Cannot evaluate \"" + ss.str() + "\" since variables "
+                   + str(free_vars_) + " are free.");
+    }
+
+    // The work vector is stored struct-of-arrays: element i of point l at w[i*B + l]
+    const casadi_int B = batch_size;
+    for (casadi_int p=0; p<n; p+=B) {
+      // Number of points in this block, remaining lanes are evaluated but discarded
+      casadi_int nb = std::min(B, n-p);
+      for (auto&& e : algorithm_) {
+        double* w0 = w + e.i0*B;
+        switch (e.op) {
+        case OP_CONST:
+          for (casadi_int l=0; l<B; ++l) w0[l] = e.d;
+          break;
+        case OP_INPUT:
+          {
+            const double* a = arg[e.i1];
+            if (a==nullptr) {
+              for (casadi_int l=0; l<B; ++l) w0[l] = 0;
+            } else {
+              casadi_int nnz = nnz_in(e.i1);
+              a += p*nnz + e.i2;
+              for (casadi_int l=0; l<nb; ++l) w0[l] = a[l*nnz];
+              for (casadi_int l=nb; l<B; ++l) w0[l] = 0;
+            }
+          }
+          break;
+        case OP_OUTPUT:
+          if (res[e.i0]!=nullptr) {
+            casadi_int nnz = nnz_out(e.i0);
+            double* r = res[e.i0] + p*nnz + e.i2;
+            const double* w1 = w + e.i1*B;
+            for (casadi_int l=0; l<nb; ++l) r[l*nnz] = w1[l];
+          }
+          break;
+        case OP_ADD:
+          {
+            const double *w1 = w + e.i1*B, *w2 = w + e.i2*B;
+            for (casadi_int l=0; l<B; ++l) w0[l] = w1[l] + w2[l];
+          }
+          break;
+        case OP_SUB:
+          {
+            const double *w1 = w + e.i1*B, *w2 = w + e.i2*B;
+            for (casadi_int l=0; l<B; ++l) w0[l] = w1[l] - w2[l];
+          }
+          break;
+        case OP_MUL:
+          {
+            const double *w1 = w + e.i1*B, *w2 = w + e.i2*B;
+            for (casadi_int l=0; l<B; ++l) w0[l] = w1[l] * w2[l];
+          }
+          break;
+        default:
+          casadi_math<double>::fun(e.op, w + e.i1*B, w + e.i2*B, w0, B);
+        }
+      }
+    }
+    return 0;
+  }
+
+  namespace {
+    // Opcodes of the compiled tape
+    enum TapeOp : unsigned char {
+      // Single instructions
+      TAPE_CONST, TAPE_INPUT, TAPE_OUTPUT, TAPE_ASSIGN,
+      TAPE_ADD, TAPE_SUB, TAPE_MUL, TAPE_DIV, TAPE_NEG, TAPE_SQ, TAPE_TWICE, TAPE_INV,
+      // Multiplication followed by an addition/subtraction consuming its result
+      TAPE_MUL_ADD, TAPE_MUL_SUB,
+      // Input followed by a binary operation
+      TAPE_INPUT_ADD, TAPE_INPUT_SUB, TAPE_INPUT_MUL,
+      // Binary operation followed by an output
+      TAPE_ADD_OUTPUT, TAPE_SUB_OUTPUT, TAPE_MUL_OUTPUT,
+      // Any other built-in operation
+      TAPE_GENERIC,
+      // End of the tape
+      TAPE_END,
+      TAPE_NUM_OP
+    };
+
+    // Tape opcode of a single instruction
+    unsigned char tape_op(casadi_int op) {
+      switch (op) {
+      case OP_CONST: return TAPE_CONST;
+      case OP_INPUT: return TAPE_INPUT;
+      case OP_OUTPUT: return TAPE_OUTPUT;
+      case OP_ASSIGN: return TAPE_ASSIGN;
+      case OP_ADD: return TAPE_ADD;
+      case OP_SUB: return TAPE_SUB;
+      case OP_MUL: return TAPE_MUL;
+      case OP_DIV: return TAPE_DIV;
+      case OP_NEG: return TAPE_NEG;
+      case OP_SQ: return TAPE_SQ;
+      case OP_TWICE: return TAPE_TWICE;
+      case OP_INV: return TAPE_INV;
+      default: return TAPE_GENERIC;
+      }
+    }
+
+    // Tape opcode of a pair of instructions, or TAPE_END if they cannot be fused
+    unsigned char tape_op(const ScalarAtomic& a, const ScalarAtomic& b) {
+      if (a.op==OP_MUL) {
+        if (b.op==OP_ADD && (b.i1==a.i0 || b.i2==a.i0)) return TAPE_MUL_ADD;
+        if (b.op==OP_SUB && b.i1==a.i0) return TAPE_MUL_SUB;
+      }
+      if (a.op==OP_INPUT) {
+        if (b.op==OP_ADD) return TAPE_INPUT_ADD;
+        if (b.op==OP_SUB) return TAPE_INPUT_SUB;
+        if (b.op==OP_MUL) return TAPE_INPUT_MUL;
+      }
+      if (b.op==OP_OUTPUT) {
+        if (a.op==OP_ADD) return TAPE_ADD_OUTPUT;
+        if (a.op==OP_SUB) return TAPE_SUB_OUTPUT;
+        if (a.op==OP_MUL) return TAPE_MUL_OUTPUT;
+      }
+      return TAPE_END;
+    }
+  } // namespace
+
+  void SXFunction::compile_tape() {
+    tape_ = CompiledTape();
+    casadi_int n = algorithm_.size();
+    tape_.op.reserve(n+1);
+    tape_.fop.reserve(n+1);
+    tape_.i0.reserve(n+1);
+    tape_.i1.reserve(n+1);
+    tape_.i2.reserve(n+1);
+    for (casadi_int k=0; k<n; ++k) {
+      const AlgEl& e = algorithm_[k];
+      // Try to fuse with the next instruction
+      unsigned char op = k+1<n ? tape_op(e, algorithm_[k+1])
+        : static_cast<unsigned char>(TAPE_END);
+      casadi_int n_slot = op==TAPE_END ? 1 : 2;
+      if (n_slot==1) op = tape_op(e.op);
+      for (casadi_int j=0; j<n_slot; ++j) {
+        const AlgEl& ej = algorithm_[k+j];
+        tape_.op.push_back(j==0 ? op : static_cast<unsigned char>(TAPE_END));
+        tape_.fop.push_back(static_cast<unsigned char>(ej.op));
+        tape_.i0.push_back(ej.i0);
+        if (op==TAPE_MUL_ADD && j==1 && ej.i1!=e.i0) {
+          // Addition is commutative: let the first operand be the product
+          tape_.i1.push_back(ej.i2);
+          tape_.i2.push_back(ej.i1);
+        } else if (ej.op==OP_CONST) {
+          tape_.i1.push_back(tape_.d.size());
+          tape_.i2.push_back(0);
+          tape_.d.push_back(ej.d);
+        } else {
+          tape_.i1.push_back(ej.i1);
+          tape_.i2.push_back(ej.i2);
+        }
+      }
+      k += n_slot-1;
+    }
+    // Sentinel
+    tape_.op.push_back(TAPE_END);
+    tape_.fop.push_back(0);
+    tape_.i0.push_back(0);
+    tape_.i1.push_back(0);
+    tape_.i2.push_back(0);
+  }
+
+  // Dispatch using computed goto (threaded code) where supported, otherwise a switch
+#if defined(__GNUC__)
+#define CASADI_TAPE_LABEL(OP) L_##OP
+#define CASADI_TAPE_NEXT(N) k += N; goto *table[op[k]]
+#define CASADI_TAPE_DISPATCH goto *table[op[k]];
+#else
+#define CASADI_TAPE_LABEL(OP) case OP
+#define CASADI_TAPE_NEXT(N) k += N; continue
+#define CASADI_TAPE_DISPATCH for (;;) switch (op[k])
+#endif
+
+  int SXFunction::eval_tape(const double** arg, double** res, double* w) const {
+    const unsigned char* op = get_ptr(tape_.op);
+    const unsigned char* fop = get_ptr(tape_.fop);
+    const int *i0 = get_ptr(tape_.i0), *i1 = get_ptr(tape_.i1), *i2 = get_ptr(tape_.i2);
+    const double* d = get_ptr(tape_.d);
+    double t;
+#if defined(__GNUC__)
+    static const void* const table[] = {
+      &&L_TAPE_CONST, &&L_TAPE_INPUT, &&L_TAPE_OUTPUT, &&L_TAPE_ASSIGN,
+      &&L_TAPE_ADD, &&L_TAPE_SUB, &&L_TAPE_MUL, &&L_TAPE_DIV, &&L_TAPE_NEG,
+      &&L_TAPE_SQ, &&L_TAPE_TWICE, &&L_TAPE_INV,
+      &&L_TAPE_MUL_ADD, &&L_TAPE_MUL_SUB,
+      &&L_TAPE_INPUT_ADD, &&L_TAPE_INPUT_SUB, &&L_TAPE_INPUT_MUL,
+      &&L_TAPE_ADD_OUTPUT, &&L_TAPE_SUB_OUTPUT, &&L_TAPE_MUL_OUTPUT,
+      &&L_TAPE_GENERIC, &&L_TAPE_END};
+    static_assert(sizeof(table)/sizeof(table[0])==TAPE_NUM_OP, "Dispatch table mismatch");
+#endif
+    casadi_int k = 0;
+    CASADI_TAPE_DISPATCH {
+      CASADI_TAPE_LABEL(TAPE_CONST):
+        w[i0[k]] = d[i1[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_INPUT):
+        w[i0[k]] = arg[i1[k]]==nullptr ? 0 : arg[i1[k]][i2[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_OUTPUT):
+        if (res[i0[k]]!=nullptr) res[i0[k]][i2[k]] = w[i1[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_ASSIGN):
+        w[i0[k]] = w[i1[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_ADD):
+        w[i0[k]] = w[i1[k]] + w[i2[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_SUB):
+        w[i0[k]] = w[i1[k]] - w[i2[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_MUL):
+        w[i0[k]] = w[i1[k]] * w[i2[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_DIV):
+        w[i0[k]] = w[i1[k]] / w[i2[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_NEG):
+        w[i0[k]] = -w[i1[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_SQ):
+        t = w[i1[k]];
+        w[i0[k]] = t*t;
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_TWICE):
+        t = w[i1[k]];
+        w[i0[k]] = t+t;
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_INV):
+        w[i0[k]] = 1./w[i1[k]];
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_MUL_ADD):
+        // Product is kept in a register for the second instruction
+        t = w[i1[k]] * w[i2[k]];
+        w[i0[k]] = t;
+        w[i0[k+1]] = t + w[i2[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_MUL_SUB):
+        t = w[i1[k]] * w[i2[k]];
+        w[i0[k]] = t;
+        w[i0[k+1]] = t - w[i2[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_INPUT_ADD):
+        w[i0[k]] = arg[i1[k]]==nullptr ? 0 : arg[i1[k]][i2[k]];
+        w[i0[k+1]] = w[i1[k+1]] + w[i2[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_INPUT_SUB):
+        w[i0[k]] = arg[i1[k]]==nullptr ? 0 : arg[i1[k]][i2[k]];
+        w[i0[k+1]] = w[i1[k+1]] - w[i2[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_INPUT_MUL):
+        w[i0[k]] = arg[i1[k]]==nullptr ? 0 : arg[i1[k]][i2[k]];
+        w[i0[k+1]] = w[i1[k+1]] * w[i2[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_ADD_OUTPUT):
+        w[i0[k]] = w[i1[k]] + w[i2[k]];
+        if (res[i0[k+1]]!=nullptr) res[i0[k+1]][i2[k+1]] = w[i1[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_SUB_OUTPUT):
+        w[i0[k]] = w[i1[k]] - w[i2[k]];
+        if (res[i0[k+1]]!=nullptr) res[i0[k+1]][i2[k+1]] = w[i1[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_MUL_OUTPUT):
+        w[i0[k]] = w[i1[k]] * w[i2[k]];
+        if (res[i0[k+1]]!=nullptr) res[i0[k+1]][i2[k+1]] = w[i1[k+1]];
+        CASADI_TAPE_NEXT(2);
+      CASADI_TAPE_LABEL(TAPE_GENERIC):
+        switch (fop[k]) {
+          CASADI_MATH_FUN_BUILTIN(w[i1[k]], w[i2[k]], w[i0[k]])
+        default:
+          casadi_error("Unknown operation" + str(static_cast<casadi_int>(fop[k])));
+        }
+        CASADI_TAPE_NEXT(1);
+      CASADI_TAPE_LABEL(TAPE_END):
+        return 0;
+#if !defined(__GNUC__)
+      default:
+        casadi_error("Unknown tape operation" + str(static_cast<casadi_int>(op[k])));
+#endif
+    }
+    return 0;
+  }
+
+#undef CASADI_TAPE_LABEL
+#undef CASADI_TAPE_NEXT
+#undef CASADI_TAPE_DISPATCH
+
   bool SXFunction::is_smooth() const {
     // Go through all nodes and check if any node is non-smooth
     for (auto&& a : algorithm_) {
@@ -150,32 +451,339 @@ namespace casadi {
     }
   }
 
+  std::string SXFunction::codegen_instruction(CodeGenerator& g, const AlgEl& a,
+      const std::function<std::string(casadi_int)>& work) {
+    std::stringstream s;
+    if (a.op==OP_OUTPUT) {
+      s << "if (res[" << a.i0 << "]!=0) "
+        << g.res(a.i0) << "[" << a.i2 << "]=" << work(a.i1);
+    } else {
+
+      // Where to store the result
+      s << work(a.i0) << "=";
+
+      // What to store
+      if (a.op==OP_CONST) {
+        s << g.constant(a.d);
+      } else if (a.op==OP_INPUT) {
+        s << g.arg(a.i1) << "? " << g.arg(a.i1) << "[" << a.i2 << "] : 0";
+      } else {
+        casadi_int ndep = casadi_math<double>::ndeps(a.op);
+        casadi_assert_dev(ndep>0);
+        if (ndep==1) s << g.print_op(a.op, work(a.i1));
+        if (ndep==2) s << g.print_op(a.op, work(a.i1), work(a.i2));
+      }
+    }
+    s << ";\n";
+    return s.str();
+  }
+
   void SXFunction::codegen_body(CodeGenerator& g) const {
+    // Split into several functions if too large
+    if (g.split_size>0 && algorithm_.size()>g.split_size) return codegen_body_split(g);
+
+    // Run the algorithm, rolled loops address the work vector by index
+    std::vector<bool> rolled = rolled_work(g);
+    auto work = [&g, &rolled](casadi_int i) {
+      return rolled[i] ? "w[" + str(i) + "]" : g.sx_work(i);
+    };
+    g << codegen_range(g, 0, algorithm_.size(), work);
+  }
 
-    // Run the algorithm
-    for (auto&& a : algorithm_) {
-      if (a.op==OP_OUTPUT) {
-        g << "if (res[" << a.i0 << "]!=0) "
-          << g.res(a.i0) << "[" << a.i2 << "]=" << g.sx_work(a.i1);
+  casadi_int SXFunction::codegen_sz_w(const CodeGenerator& g) const {
+    if (g.avoid_stack() || g.split_size>0) return sz_w();
+    // Work vector elements are local variables, unless accessed by a rolled loop
+    for (bool r : rolled_work(g)) if (r) return sz_w();
+    return 0;
+  }
+
+  std::vector<std::vector<casadi_int> > SXFunction::roll_blocks(const CodeGenerator& g,
+      casadi_int begin, casadi_int end) const {
+    std::vector<std::vector<casadi_int> > ret;
+    if (!g.loop_rolling) return ret;
+
+    // Window length for finding candidate repetitions
+    const casadi_int win = 8;
+    // Maximum length of a repeated block
+    const casadi_int max_len = 4096;
+    // Minimum number of instructions saved by rolling a block into a loop
+    const casadi_int min_saved = 8;
+
+    // Instructions that only differ in their work vector, input and output indices
+    auto same = [&](casadi_int i, casadi_int j) {
+      const AlgEl& a = algorithm_[i];
+      const AlgEl& b = algorithm_[j];
+      if (a.op!=b.op) return false;
+      return a.op!=OP_CONST || std::memcmp(&a.d, &b.d, sizeof(double))==0;
+    };
+    auto token = [&](casadi_int i) {
+      const AlgEl& a = algorithm_[i];
+      size_t h = a.op;
+      if (a.op==OP_CONST) {
+        uint64_t bits;
+        std::memcpy(&bits, &a.d, sizeof(double));
+        hash_combine(h, bits);
+      }
+      return h;
+    };
+
+    // For each position, the next position starting the same window of operations
+    std::vector<casadi_int> next(end-begin, -1);
+    std::unordered_map<size_t, casadi_int> last;
+    for (casadi_int i=end-win; i>=begin; --i) {
+      size_t h = 0;
+      for (casadi_int j=i; j<i+win; ++j) hash_combine(h, token(j));
+      auto it = last.find(h);
+      if (it!=last.end()) next[i-begin] = it->second;
+      last[h] = i;
+    }
+
+    // Greedily roll maximal periodic blocks
+    casadi_int i = begin;
+    while (i<end) {
+      casadi_int len = next[i-begin]<0 ? 0 : next[i-begin]-i, rep = 1;
+      if (len>0 && len<=max_len) {
+        casadi_int m = 0;
+        while (i+len+m<end && same(i+m, i+len+m)) m++;
+        rep = 1 + m/len;
+      }
+      if (rep>1 && (rep-1)*len>=min_saved) {
+        ret.push_back({i, len, rep});
+        i += rep*len;
       } else {
+        i++;
+      }
+    }
+    return ret;
+  }
+
+  std::vector<bool> SXFunction::rolled_work(const CodeGenerator& g) const {
+    std::vector<bool> ret(worksize_, false);
+    if (!g.loop_rolling) return ret;
+    // Same ranges as codegen_body and codegen_body_split
+    casadi_int n = algorithm_.size();
+    casadi_int sz = g.split_size>0 && n>g.split_size ? g.split_size : std::max(n, casadi_int(1));
+    for (casadi_int k=0; k<n; k+=sz) {
+      for (auto&& b : roll_blocks(g, k, std::min(n, k+sz))) {
+        for (casadi_int i=b[0]; i<b[0]+b[1]*b[2]; ++i) {
+          const AlgEl& a = algorithm_[i];
+          if (a.op==OP_OUTPUT) {
+            ret[a.i1] = true;
+          } else {
+            ret[a.i0] = true;
+            if (a.op!=OP_CONST && a.op!=OP_INPUT) {
+              casadi_int ndep = casadi_math<double>::ndeps(a.op);
+              if (ndep>=1) ret[a.i1] = true;
+              if (ndep==2) ret[a.i2] = true;
+            }
+          }
+        }
+      }
+    }
+    return ret;
+  }
 
-        // Where to store the result
-        g << g.sx_work(a.i0) << "=";
+  std::string SXFunction::codegen_range(CodeGenerator& g, casadi_int begin, casadi_int end,
+      const std::function<std::string(casadi_int)>& work) const {
+    // Rolled blocks as loops, everything else as is
+    std::stringstream s;
+    casadi_int i = begin;
+    for (auto&& b : roll_blocks(g, begin, end)) {
+      for (; i<b[0]; ++i) s << codegen_instruction(g, algorithm_[i], work);
+      s << codegen_loop(g, b[0], b[1], b[2]);
+      i += b[1]*b[2];
+    }
+    for (; i<end; ++i) s << codegen_instruction(g, algorithm_[i], work);
+    return s.str();
+  }
 
-        // What to store
+  std::string SXFunction::codegen_loop(CodeGenerator& g, casadi_int begin, casadi_int len,
+      casadi_int rep) const {
+    // Index tables, one column per index that is not affine in the loop counter
+    std::vector<std::vector<casadi_int> > cols;
+    auto index = [&](casadi_int p, casadi_int field) -> std::string {
+      std::vector<casadi_int> v(rep);
+      for (casadi_int r=0; r<rep; ++r) {
+        const AlgEl& a = algorithm_[begin + r*len + p];
+        v[r] = field==0 ? a.i0 : field==1 ? a.i1 : a.i2;
+      }
+      casadi_int stride = v[1]-v[0];
+      bool affine = true;
+      for (casadi_int r=2; r<rep && affine; ++r) affine = v[r]==v[0]+r*stride;
+      if (!affine) {
+        cols.push_back(v);
+        return "ti[" + str(cols.size()-1) + "]";
+      } else if (stride==0) {
+        return str(v[0]);
+      } else {
+        return str(v[0]) + (stride<0 ? "-" : "+")
+          + (std::abs(stride)==1 ? "" : str(std::abs(stride)) + "*") + "i";
+      }
+    };
+
+    // Loop body
+    std::stringstream body;
+    for (casadi_int p=0; p<len; ++p) {
+      const AlgEl& a = algorithm_[begin + p];
+      if (a.op==OP_OUTPUT) {
+        std::string r = "res[" + index(p, 0) + "]";
+        body << "if (" << r << "!=0) " << r << "[" << index(p, 2) << "]=w["
+             << index(p, 1) << "];\n";
+      } else {
+        std::string w = "w[" + index(p, 0) + "]";
         if (a.op==OP_CONST) {
-          g << g.constant(a.d);
+          body << w << "=" << g.constant(a.d) << ";\n";
         } else if (a.op==OP_INPUT) {
-          g << g.arg(a.i1) << "? " << g.arg(a.i1) << "[" << a.i2 << "] : 0";
+          std::string x = "arg[" + index(p, 1) + "]";
+          body << w << "=" << x << "? " << x << "[" << index(p, 2) << "] : 0;\n";
         } else {
           casadi_int ndep = casadi_math<double>::ndeps(a.op);
           casadi_assert_dev(ndep>0);
-          if (ndep==1) g << g.print_op(a.op, g.sx_work(a.i1));
-          if (ndep==2) g << g.print_op(a.op, g.sx_work(a.i1), g.sx_work(a.i2));
+          std::string x = "w[" + index(p, 1) + "]";
+          if (ndep==1) body << w << "=" << g.print_op(a.op, x) << ";\n";
+          if (ndep==2) body << w << "=" << g.print_op(a.op, x, "w[" + index(p, 2) + "]") << ";\n";
+        }
+      }
+    }
+
+    // Loop over the repetitions, with one row of the index table per repetition
+    std::stringstream s;
+    s << "{\n";
+    casadi_int n_col = cols.size();
+    if (n_col>0) {
+      std::vector<casadi_int> t(rep*n_col);
+      for (casadi_int r=0; r<rep; ++r) {
+        for (casadi_int m=0; m<n_col; ++m) t[r*n_col+m] = cols[m][r];
+      }
+      s << "static const casadi_int t[" << t.size() << "] = " << g.initializer(t) << ";\n";
+    }
+    s << "casadi_int i;\n";
+    if (n_col>0) {
+      s << "const casadi_int* ti;\n";
+      s << "for (i=0, ti=t; i<" << rep << "; ++i, ti+=" << n_col << ") {\n";
+    } else {
+      s << "for (i=0; i<" << rep << "; ++i) {\n";
+    }
+    s << body.str() << "}\n}\n";
+    return s.str();
+  }
+
+  void SXFunction::codegen_body_split(CodeGenerator& g) const {
+    // Partition the algorithm into chunks of at most split_size instructions
+    casadi_int sz = g.split_size;
+    casadi_int n_chunk = (algorithm_.size()+sz-1)/sz;
+
+    // Work vector elements live at the start of each chunk (backward liveness)
+    std::vector<std::vector<casadi_int> > live_in(n_chunk+1);
+    std::vector<bool> live(worksize_, false);
+    for (casadi_int k=n_chunk-1; k>=0; --k) {
+      casadi_int end = std::min(static_cast<casadi_int>(algorithm_.size()), (k+1)*sz);
+      for (casadi_int i=end-1; i>=k*sz; --i) {
+        const AlgEl& a = algorithm_[i];
+        if (a.op==OP_OUTPUT) {
+          live[a.i1] = true;
+        } else {
+          live[a.i0] = false;
+          if (a.op!=OP_CONST && a.op!=OP_INPUT) {
+            casadi_int ndep = casadi_math<double>::ndeps(a.op);
+            if (ndep>=1) live[a.i1] = true;
+            if (ndep==2) live[a.i2] = true;
+          }
         }
       }
-      g  << ";\n";
+      for (casadi_int j=0; j<worksize_; ++j) if (live[j]) live_in[k].push_back(j);
     }
+
+    // Work vector elements referenced by a chunk, rolled loops address w by index
+    std::vector<bool> rolled = rolled_work(g);
+    std::vector<bool> used(worksize_, false);
+    auto work = [&](casadi_int i) {
+      if (g.avoid_stack() || rolled[i]) return "w[" + str(i) + "]";
+      used[i] = true;
+      return "a" + str(i);
+    };
+
+    // Generate the chunks
+    std::string fname = codegen_name(g, false);
+    for (casadi_int k=0; k<n_chunk; ++k) {
+      // Instructions
+      casadi_int end = std::min(static_cast<casadi_int>(algorithm_.size()), (k+1)*sz);
+      std::string body = codegen_range(g, k*sz, end, work);
+
+      // Local variables, live-in elements are read from and live-out elements written to w,
+      // elements that are live across the chunk without being used stay in w
+      std::stringstream s;
+      if (!g.avoid_stack()) {
+        std::string sep = "casadi_real ";
+        for (casadi_int j=0; j<worksize_; ++j) {
+          if (used[j]) {
+            s << sep << "a" << j;
+            sep = ", ";
+          }
+        }
+        if (sep==", ") s << ";\n";
+        for (casadi_int j : live_in[k]) {
+          if (used[j]) s << "a" << j << "=w[" << j << "];\n";
+        }
+        s << body;
+        for (casadi_int j : live_in[k+1]) {
+          if (used[j]) s << "w[" << j << "]=a" << j << ";\n";
+        }
+        std::fill(used.begin(), used.end(), false);
+      } else {
+        s << body;
+      }
+
+      // Call from the main function
+      g << g.add_split(fname + "_s" + str(k), s.str()) << "(arg, res, w);\n";
+    }
+  }
+
+  void SXFunction::codegen_batch_body(CodeGenerator& g) const {
+    // Same layout as eval_batch: element i of point l in a block at w[i*B + l]
+    const casadi_int B = batch_size;
+    g.local("p", "casadi_int");
+    g.local("l", "casadi_int");
+    g.local("nb", "casadi_int");
+    g << "for (p=0; p<n; p+=" << B << ") {\n"
+      << "nb = n-p<" << B << " ? n-p : " << B << ";\n";
+
+    // Work vector element of the current lane
+    auto work = [B](casadi_int i) { return i==0 ? "w[l]" : "w[" + str(i*B) + "+l]";};
+
+    // Nonzero k of the current point, with n nonzeros per point
+    auto point = [](casadi_int n, casadi_int k) {
+      std::string s = n==1 ? "p+l" : "(p+l)*" + str(n);
+      return k==0 ? s : s + "+" + str(k);
+    };
+
+    // Consecutive elementwise operations share a loop over the lanes
+    bool in_loop = false;
+    for (auto&& a : algorithm_) {
+      if (a.op==OP_INPUT || a.op==OP_OUTPUT) {
+        if (in_loop) g << "}\n";
+        in_loop = false;
+        if (a.op==OP_INPUT) {
+          casadi_int nnz = nnz_in(a.i1);
+          g << "for (l=0; l<" << B << "; ++l) " << work(a.i0) << "="
+            << g.arg(a.i1) << " && l<nb ? "
+            << g.arg(a.i1) << "[" << point(nnz, a.i2) << "] : 0;\n";
+        } else {
+          casadi_int nnz = nnz_out(a.i0);
+          g << "if (" << g.res(a.i0) << ") for (l=0; l<nb; ++l) "
+            << g.res(a.i0) << "[" << point(nnz, a.i2) << "]=" << work(a.i1) << ";\n";
+        }
+      } else {
+        if (!in_loop) {
+          g << "#pragma omp simd\n"
+            << "for (l=0; l<" << B << "; ++l) {\n";
+        }
+        in_loop = true;
+        g << codegen_instruction(g, a, work);
+      }
+    }
+    if (in_loop) g << "}\n";
+    g << "}\n";
   }
 
   const Options SXFunction::options_
@@ -192,7 +800,14 @@ namespace casadi {
         "Just-in-time compilation for numeric evaluation using OpenCL (experimental)"}},
       {"live_variables",
        {OT_BOOL,
-        "Reuse variables in the work vector"}}
+        "Reuse variables in the work vector"}},
+      {"cse",
+       {OT_BOOL,
+        "Perform common subexpression elimination on the outputs [default: false]"}},
+      {"compiled_tape",
+       {OT_BOOL,
+        "Evaluate numerically using a compact tape with fused superinstructions "
+        "and threaded dispatch instead of the default virtual machine"}}
      }
   };
 
@@ -202,6 +817,7 @@ namespace casadi {
     opts["live_variables"] = live_variables_;
     opts["just_in_time_sparsity"] = just_in_time_sparsity_;
     opts["just_in_time_opencl"] = just_in_time_opencl_;
+    opts["compiled_tape"] = compiled_tape_;
     return opts;
   }
 
@@ -212,6 +828,7 @@ namespace casadi {
 
     // Default (temporary) options
     live_variables_ = true;
+    bool cse_opt = false;
 
     // Read options
     for (auto&& op : opts) {
@@ -219,10 +836,14 @@ namespace casadi {
         default_in_ = op.second;
       } else if (op.first=="live_variables") {
         live_variables_ = op.second;
+      } else if (op.first=="cse") {
+        cse_opt = op.second;
       } else if (op.first=="just_in_time_opencl") {
         just_in_time_opencl_ = op.second;
       } else if (op.first=="just_in_time_sparsity") {
         just_in_time_sparsity_ = op.second;
+      } else if (op.first=="compiled_tape") {
+        compiled_tape_ = op.second;
       }
     }
 
@@ -234,6 +855,9 @@ namespace casadi {
                             "Option 'default_in' has incorrect length");
     }
 
+    // Merge structurally equal subexpressions before sorting
+    if (cse_opt) out_ = SX::cse(out_);
+
     // Stack used to sort the computational graph
     stack<SXNode*> s;
 
@@ -470,6 +1094,9 @@ namespace casadi {
       casadi_error("OpenCL is not supported in this version of CasADi");
     }
 
+    // Compile the tape for numerical evaluation
+    if (compiled_tape_) compile_tape();
+
     // Print
     if (verbose_) casadi_message(str(algorithm_.size()) + " elementary operations");
   }
@@ -830,6 +1457,82 @@ namespace casadi {
     return 0;
   }
 
+  int SXFunction::sp_forward_wide(const bvec_t** arg, bvec_t** res,
+      casadi_int* iw, bvec_t* w, void* mem, casadi_int nw) const {
+    // Fall back when forward mode not allowed
+    if (sp_weight()==1) return FunctionInternal::sp_forward_wide(arg, res, iw, w, mem, nw);
+    // Propagate sparsity forward, nw words per work vector entry
+    for (auto&& e : algorithm_) {
+      bvec_t* w0 = w + nw*e.i0;
+      switch (e.op) {
+      case OP_CONST:
+      case OP_PARAMETER:
+        std::fill_n(w0, nw, 0);
+        break;
+      case OP_INPUT:
+        if (arg[e.i1]==nullptr) {
+          std::fill_n(w0, nw, 0);
+        } else {
+          std::copy_n(arg[e.i1] + nw*e.i2, nw, w0);
+        }
+        break;
+      case OP_OUTPUT:
+        if (res[e.i0]!=nullptr) std::copy_n(w + nw*e.i1, nw, res[e.i0] + nw*e.i2);
+        break;
+      default: // Unary or binary operation
+        {
+          const bvec_t *w1 = w + nw*e.i1, *w2 = w + nw*e.i2;
+          for (casadi_int q=0; q<nw; ++q) w0[q] = w1[q] | w2[q];
+        }
+      }
+    }
+    return 0;
+  }
+
+  int SXFunction::sp_reverse_wide(bvec_t** arg, bvec_t** res,
+      casadi_int* iw, bvec_t* w, void* mem, casadi_int nw) const {
+    // Fall back when reverse mode not allowed
+    if (sp_weight()==0) return FunctionInternal::sp_reverse_wide(arg, res, iw, w, mem, nw);
+    fill_n(w, nw*sz_w(), 0);
+
+    // Propagate sparsity backward, nw words per work vector entry
+    for (auto it=algorithm_.rbegin(); it!=algorithm_.rend(); ++it) {
+      bvec_t* w0 = w + nw*it->i0;
+      switch (it->op) {
+      case OP_CONST:
+      case OP_PARAMETER:
+        std::fill_n(w0, nw, 0);
+        break;
+      case OP_INPUT:
+        if (arg[it->i1]!=nullptr) {
+          bvec_t* a = arg[it->i1] + nw*it->i2;
+          for (casadi_int q=0; q<nw; ++q) a[q] |= w0[q];
+        }
+        std::fill_n(w0, nw, 0);
+        break;
+      case OP_OUTPUT:
+        if (res[it->i0]!=nullptr) {
+          bvec_t* r = res[it->i0] + nw*it->i2;
+          bvec_t* w1 = w + nw*it->i1;
+          for (casadi_int q=0; q<nw; ++q) w1[q] |= r[q];
+          std::fill_n(r, nw, 0);
+        }
+        break;
+      default: // Unary or binary operation
+        {
+          bvec_t *w1 = w + nw*it->i1, *w2 = w + nw*it->i2;
+          for (casadi_int q=0; q<nw; ++q) {
+            bvec_t seed = w0[q];
+            w0[q] = 0;
+            w1[q] |= seed;
+            w2[q] |= seed;
+          }
+        }
+      }
+    }
+    return 0;
+  }
+
   Function SXFunction::get_jacobian(const std::string& name,
                                        const std::vector<std::string>& inames,
                                        const std::vector<std::string>& onames,
@@ -965,7 +1668,7 @@ namespace casadi {
 
   SXFunction::SXFunction(DeserializingStream& s) :
     XFunction<SXFunction, SX, SXNode>(s) {
-    s.version("SXFunction", 1);
+    s.version("SXFunction", 2);
     size_t n_instructions;
     s.unpack("SXFunction::n_instr", n_instructions);
 
@@ -989,13 +1692,15 @@ namespace casadi {
     just_in_time_sparsity_ = false;
 
     s.unpack("SXFunction::live_variables", live_variables_);
+    s.unpack("SXFunction::compiled_tape", compiled_tape_);
+    if (compiled_tape_) compile_tape();
 
     XFunction<SXFunction, SX, SXNode>::delayed_deserialize_members(s);
   }
 
   void SXFunction::serialize_body(SerializingStream &s) const {
     XFunction<SXFunction, SX, SXNode>::serialize_body(s);
-    s.version("SXFunction", 1);
+    s.version("SXFunction", 2);
     s.pack("SXFunction::n_instr", algorithm_.size());
 
     s.pack("SXFunction::worksize", worksize_);
@@ -1013,6 +1718,7 @@ namespace casadi {
     }
 
     s.pack("SXFunction::live_variables", live_variables_);
+    s.pack("SXFunction::compiled_tape", compiled_tape_);
 
     XFunction<SXFunction, SX, SXNode>::delayed_serialize_members(s);
   }
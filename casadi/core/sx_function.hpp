@@ -27,6 +27,7 @@
 #define CASADI_SX_FUNCTION_HPP
 
 #include "x_function.hpp"
+#include <functional>
 
 /// \cond INTERNAL
 
@@ -62,6 +63,17 @@ class CASADI_EXPORT SXFunction :
   /** \brief  Evaluate numerically, work vectors given */
   int eval(const double** arg, double** res, casadi_int* iw, double* w, void* mem) const override;
 
+  ///@{
+  /** \brief  Evaluate numerically at a batch of points, batch_size points at a time */
+  int eval_batch(const double** arg, double** res, casadi_int* iw, double* w,
+                 void* mem, casadi_int n) const override;
+  bool has_eval_batch() const override { return !compiled_tape_;}
+  size_t sz_w_batch() const override { return batch_size*worksize_;}
+  ///@}
+
+  /// Number of points evaluated simultaneously by eval_batch
+  static const casadi_int batch_size = 16;
+
   /** \brief  evaluate symbolically while also propagating directional derivatives */
   int eval_sx(const SXElem** arg, SXElem** res,
               casadi_int* iw, SXElem* w, void* mem) const override;
@@ -206,6 +218,37 @@ class CASADI_EXPORT SXFunction :
   /** \brief Generate code for the body of the C function */
   void codegen_body(CodeGenerator& g) const override;
 
+  /** \brief Generate code for the body, split into several functions */
+  void codegen_body_split(CodeGenerator& g) const;
+
+  /** \brief Generate code for the body of the batched variant, cf. eval_batch */
+  void codegen_batch_body(CodeGenerator& g) const override;
+
+  /** \brief Is codegen of a batched variant supported? */
+  bool has_codegen_batch() const override { return true;}
+
+  /** \brief Work vector length in generated code */
+  casadi_int codegen_sz_w(const CodeGenerator& g) const override;
+
+  /** \brief Blocks of a range rolled into loops, as {begin, length, repetitions} */
+  std::vector<std::vector<casadi_int> > roll_blocks(const CodeGenerator& g,
+    casadi_int begin, casadi_int end) const;
+
+  /** \brief Work vector elements accessed by rolled loops, which are addressed by index */
+  std::vector<bool> rolled_work(const CodeGenerator& g) const;
+
+  /** \brief Generate code for a range of instructions, rolling repeated blocks into loops */
+  std::string codegen_range(CodeGenerator& g, casadi_int begin, casadi_int end,
+    const std::function<std::string(casadi_int)>& work) const;
+
+  /** \brief Generate a loop over rep repetitions of the block of len instructions at begin */
+  std::string codegen_loop(CodeGenerator& g, casadi_int begin, casadi_int len,
+    casadi_int rep) const;
+
+  /** \brief Generate code for a single instruction */
+  static std::string codegen_instruction(CodeGenerator& g, const AlgEl& a,
+    const std::function<std::string(casadi_int)>& work);
+
   /** \brief  Propagate sparsity forward */
   int sp_forward(const bvec_t** arg, bvec_t** res,
                   casadi_int* iw, bvec_t* w, void* mem) const override;
@@ -213,6 +256,15 @@ class CASADI_EXPORT SXFunction :
   /** \brief  Propagate sparsity backwards */
   int sp_reverse(bvec_t** arg, bvec_t** res, casadi_int* iw, bvec_t* w, void* mem) const override;
 
+  ///@{
+  /** \brief  Propagate sparsity with several bvec_t words per nonzero */
+  int sp_forward_wide(const bvec_t** arg, bvec_t** res,
+                      casadi_int* iw, bvec_t* w, void* mem, casadi_int nw) const override;
+  int sp_reverse_wide(bvec_t** arg, bvec_t** res,
+                      casadi_int* iw, bvec_t* w, void* mem, casadi_int nw) const override;
+  bool has_sp_wide() const override { return true;}
+  ///@}
+
   /** \brief Return Jacobian of all input elements with respect to all output elements */
   Function get_jacobian(const std::string& name,
                                    const std::vector<std::string>& inames,
@@ -238,6 +290,34 @@ class CASADI_EXPORT SXFunction :
   /// Live variables?
   bool live_variables_;
 
+  /// Evaluate numerically using the compiled tape
+  bool compiled_tape_;
+
+  /** \brief Struct-of-arrays encoding of the algorithm for the compiled tape
+
+      Superinstructions occupy two consecutive slots, the first holding the
+      fused opcode and both holding the operands of the original instructions.
+  */
+  struct CompiledTape {
+    /// Tape opcode of each slot
+    std::vector<unsigned char> op;
+    /// Original operation, for slots dispatched to the generic handler
+    std::vector<unsigned char> fop;
+    /// Operands
+    std::vector<int> i0, i1, i2;
+    /// Constant pool, indexed by i1 for constants
+    std::vector<double> d;
+  };
+
+  /// Compiled tape
+  CompiledTape tape_;
+
+  /** \brief Build the compiled tape from the algorithm */
+  void compile_tape();
+
+  /** \brief Evaluate numerically using the compiled tape */
+  int eval_tape(const double** arg, double** res, double* w) const;
+
 protected:
   /** \brief Deserializing constructor */
   explicit SXFunction(DeserializingStream& s);
@@ -26,6 +26,8 @@
 #include "matrix_impl.hpp"
 
 #include "sx_function.hpp"
+#include <cstring>
+#include <unordered_map>
 
 using namespace std;
 
@@ -861,6 +863,114 @@ namespace casadi {
     copy(vdef.begin(), vdef.end(), vdef_sx.begin());
   }
 
+  /// \cond INTERNAL
+  // Operation with its (already merged) arguments, used for hash-consing
+  struct SXCseKey {
+    casadi_int op;
+    const SXNode* x;
+    const SXNode* y;
+    bool operator==(const SXCseKey& k) const { return op==k.op && x==k.x && y==k.y;}
+  };
+  struct SXCseHash {
+    size_t operator()(const SXCseKey& k) const {
+      size_t h = std::hash<casadi_int>()(k.op);
+      h ^= std::hash<const SXNode*>()(k.x) + 0x9e3779b9 + (h<<6) + (h>>2);
+      h ^= std::hash<const SXNode*>()(k.y) + 0x9e3779b9 + (h<<6) + (h>>2);
+      return h;
+    }
+  };
+  /// \endcond
+
+  template<>
+  vector<SX> CASADI_EXPORT SX::cse(const vector<SX>& e) {
+    // Sort the expression
+    Function f("tmp", vector<SX>(), e);
+    SXFunction *ff = f.get<SXFunction>();
+
+    // Get references to the internal data structures
+    const vector<ScalarAtomic>& algorithm = ff->algorithm_;
+    vector<SXElem> work(f.sz_w());
+
+    // Iterators to the binary operations, constants and free variables
+    vector<SXElem>::const_iterator b_it=ff->operations_.begin();
+    vector<SXElem>::const_iterator c_it = ff->constants_.begin();
+    vector<SXElem>::const_iterator p_it = ff->free_vars_.begin();
+
+    // Nonzeros of the results
+    vector<vector<SXElem> > ret_nz(e.size());
+    for (casadi_int i=0; i<e.size(); ++i) ret_nz[i].resize(e[i].nnz());
+
+    // Unique constants, by bit pattern
+    unordered_map<uint64_t, SXElem> constants;
+
+    // Unique operations
+    unordered_map<SXCseKey, SXElem, SXCseHash> operations;
+
+    // Evaluate the algorithm
+    for (auto&& a : algorithm) {
+      switch (a.op) {
+      case OP_OUTPUT:
+        ret_nz.at(a.i0).at(a.i2) = work[a.i1];
+        break;
+      case OP_CONST:
+        {
+          uint64_t bits;
+          std::memcpy(&bits, &a.d, sizeof(bits));
+          auto it = constants.insert(make_pair(bits, *c_it++)).first;
+          work[a.i0] = it->second;
+        }
+        break;
+      case OP_PARAMETER:
+        work[a.i0] = *p_it++;
+        break;
+      default:
+        {
+          const SXElem& orig = *b_it++;
+          bool is_binary = casadi_math<double>::is_binary(a.op);
+          SXElem x = work[a.i1];
+          SXElem y = is_binary ? work[a.i2] : SXElem();
+          // Print instructions have side effects, never merge them
+          if (a.op==OP_PRINTME) {
+            work[a.i0] = SXElem::binary(a.op, x, y);
+            break;
+          }
+          // Arguments in a canonical order for commutative operations
+          SXCseKey key = {a.op, x.get(), is_binary ? y.get() : nullptr};
+          if (is_binary && operation_checker<CommChecker>(a.op) && key.y<key.x) {
+            std::swap(key.x, key.y);
+          }
+          auto it = operations.find(key);
+          if (it!=operations.end()) {
+            // Structurally equal to an earlier operation
+            work[a.i0] = it->second;
+          } else {
+            // Reuse the original node if the arguments are unchanged
+            SXElem r;
+            if (x.get()==orig.dep(0).get() && (!is_binary || y.get()==orig.dep(1).get())) {
+              r = orig;
+            } else if (is_binary) {
+              r = SXElem::binary(a.op, x, y);
+            } else {
+              r = SXElem::unary(a.op, x);
+            }
+            operations.insert(make_pair(key, r));
+            work[a.i0] = r;
+          }
+        }
+      }
+    }
+
+    // Assemble the results
+    vector<SX> ret(e.size());
+    for (casadi_int i=0; i<e.size(); ++i) ret[i] = SX(e[i].sparsity(), ret_nz[i]);
+    return ret;
+  }
+
+  template<>
+  SX CASADI_EXPORT SX::cse(const SX& e) {
+    return cse(vector<SX>{e}).at(0);
+  }
+
   template<>
   SX CASADI_EXPORT SX::poly_coeff(const SX& ex, const SX& x) {
     casadi_assert_dev(ex.is_scalar());
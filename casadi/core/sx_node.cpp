@@ -161,6 +161,8 @@ namespace casadi {
       delete n;
       return;
     }
+    // Return the memory of the whole graph to the pool at once
+    SXNodePool::BulkRelease bulk;
     // Stack of expressions to be deleted
     std::stack<SXNode*> deletion_stack;
     // Add the node to the deletion stack
@@ -207,14 +209,14 @@ namespace casadi {
     serialize_node(s);
   }
 
-  SXNode* SXNode::deserialize(DeserializingStream& s) {
+  SXElem SXNode::deserialize(DeserializingStream& s) {
     casadi_int op;
     s.unpack("SXNode::op", op);
 
     if (casadi_math<MX>::is_binary(op)) {
-      return BinarySX::deserialize(s, op);
+      return SXElem::create(BinarySX::deserialize(s, op));
     } else if (casadi_math<MX>::is_unary(op)) {
-      return UnarySX::deserialize(s, op);
+      return SXElem::create(UnarySX::deserialize(s, op));
     }
 
     auto it = SXNode::deserialize_map.find(op);
@@ -227,7 +229,7 @@ namespace casadi {
 
 
   // Note: binary/unary operations are ommitted here
-  std::map<casadi_int, SXNode* (*)(DeserializingStream&)> SXNode::deserialize_map = {
+  std::map<casadi_int, SXElem (*)(DeserializingStream&)> SXNode::deserialize_map = {
     {OP_PARAMETER, SymbolicSX::deserialize},
     {OP_CONST, ConstantSX_deserialize}};
 
@@ -33,6 +33,11 @@
 
 /** \brief  Scalar expression (which also works as a smart pointer class to this class) */
 #include "sx_elem.hpp"
+#include "sx_node_pool.hpp"
+
+#ifdef CASADI_WITH_THREAD
+#include <atomic>
+#endif // CASADI_WITH_THREAD
 
 
 /// \cond INTERNAL
@@ -54,6 +59,12 @@ namespace casadi {
     /** \brief  destructor  */
     virtual ~SXNode();
 
+    ///@{
+    /** \brief  Nodes are allocated from SXNodePool */
+    static void* operator new(std::size_t sz) { return SXNodePool::allocate(sz);}
+    static void operator delete(void* p, std::size_t sz) { SXNodePool::deallocate(p, sz);}
+    ///@}
+
     ///@{
     /** \brief  check properties of a node */
     virtual bool is_constant() const { return false; }
@@ -131,16 +142,39 @@ namespace casadi {
     mutable int temp;
 
     // Reference counter -- counts the number of parents of the node
+#ifdef CASADI_WITH_THREAD
+    std::atomic<unsigned int> count;
+#else // CASADI_WITH_THREAD
     unsigned int count;
+#endif // CASADI_WITH_THREAD
+
+    /** \brief Increase the reference counter, unless it has already reached zero
+
+        Used by caches that hold nodes without owning them: a node whose counter
+        has reached zero is being destroyed and must not be handed out again.
+    */
+    bool count_up_if_alive() {
+#ifdef CASADI_WITH_THREAD
+      unsigned int c = count.load(std::memory_order_relaxed);
+      do {
+        if (c==0) return false;
+      } while (!count.compare_exchange_weak(c, c+1));
+      return true;
+#else // CASADI_WITH_THREAD
+      if (count==0) return false;
+      count++;
+      return true;
+#endif // CASADI_WITH_THREAD
+    }
 
     /** \brief Serialize an object */
     void serialize(SerializingStream& s) const;
 
     virtual void serialize_node(SerializingStream& s) const;
 
-    static SXNode* deserialize(DeserializingStream& s);
+    static SXElem deserialize(DeserializingStream& s);
 
-    static std::map<casadi_int, SXNode* (*)(DeserializingStream&)> deserialize_map;
+    static std::map<casadi_int, SXElem (*)(DeserializingStream&)> deserialize_map;
 
 
   };
@@ -0,0 +1,470 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010-2014 Joel Andersson, Joris Gillis, Moritz Diehl,
+ *                            K.U. Leuven. All rights reserved.
+ *    Copyright (C) 2011-2014 Greg Horn
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include "sx_node_pool.hpp"
+
+#ifdef CASADI_WITH_THREAD
+#ifdef CASADI_WITH_THREAD_MINGW
+#include <mingw.mutex.h>
+#else // CASADI_WITH_THREAD_MINGW
+#include <mutex>
+#endif // CASADI_WITH_THREAD_MINGW
+#endif // CASADI_WITH_THREAD
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif // _WIN32
+
+namespace casadi {
+
+  namespace {
+
+    // A released block, linked into a free list
+    struct FreeBlock {
+      FreeBlock* next;
+    };
+
+    // List a chunk belongs to
+    enum ChunkList {CHUNK_CURRENT, CHUNK_PARTIAL, CHUNK_FULL, CHUNK_ABANDONED};
+
+    // Header, stored at the start of every chunk
+    struct Chunk {
+      // Id of the owning thread, 0 if abandoned
+      std::atomic<uint64_t> owner;
+      // Blocks released by other threads
+      std::atomic<FreeBlock*> remote;
+      // Blocks released by the owner
+      FreeBlock* free;
+      // Never used memory
+      char* bump;
+      char* end;
+      // Block size
+      size_t bs;
+      // Blocks handed out and not yet reclaimed
+      size_t n_used;
+      // Linked list
+      Chunk* prev;
+      Chunk* next;
+      ChunkList list;
+    };
+
+    // Offset of the first block
+    const size_t header_size = (sizeof(Chunk) + SXNodePool::max_size - 1)
+      / SXNodePool::max_size * SXNodePool::max_size;
+
+    // Doubly linked list of chunks
+    struct ChunkQueue {
+      Chunk* head;
+      void push(Chunk* ch) {
+        ch->prev = nullptr;
+        ch->next = head;
+        if (head) head->prev = ch;
+        head = ch;
+      }
+      void remove(Chunk* ch) {
+        if (ch->prev) ch->prev->next = ch->next;
+        if (ch->next) ch->next->prev = ch->prev;
+        if (head==ch) head = ch->next;
+        ch->prev = ch->next = nullptr;
+      }
+    };
+
+    // Chunks of one size class, owned by a thread
+    struct ClassState {
+      // Chunk being allocated from
+      Chunk* cur;
+      // Chunks with blocks released by the owner
+      ChunkQueue partial;
+      // Chunks without free blocks, except possibly remote ones
+      ChunkQueue full;
+      // Empty chunk kept for reuse
+      Chunk* spare;
+    };
+
+    // State shared by all threads
+    struct PoolGlobal {
+#ifdef CASADI_WITH_THREAD
+      std::mutex mtx;
+#endif // CASADI_WITH_THREAD
+      // Chunks of exited threads
+      ChunkQueue abandoned[SXNodePool::n_class];
+      // Number of chunks allocated
+      std::atomic<size_t> n_chunk;
+      // Last thread id handed out
+      std::atomic<uint64_t> last_id;
+    };
+
+    // Never destroyed: nodes held by static objects may be released at exit
+    PoolGlobal& pool_global() {
+      static PoolGlobal* g = new PoolGlobal();
+      return *g;
+    }
+
+    // Blocks released to the same chunk, not yet returned to it
+    struct BulkRun {
+      Chunk* ch;
+      FreeBlock* first;
+      FreeBlock* last;
+      size_t n;
+    };
+
+    // Pool state of the current thread, trivially destructible so that access is cheap
+    struct PoolLocal {
+      // Id of the thread, 0 if not yet initialized or exited
+      uint64_t id;
+      // Set once the thread has started to exit
+      bool dead;
+      // Number of active BulkRelease instances
+      size_t n_bulk;
+      // Blocks collected for bulk release, per size class
+      BulkRun bulk[SXNodePool::n_class];
+      ClassState cls[SXNodePool::n_class];
+    };
+    thread_local PoolLocal pool_local;
+
+    // Hands the chunks over to the global list at thread exit
+    struct PoolLocalGuard {
+      bool active;
+      ~PoolLocalGuard();
+    };
+    thread_local PoolLocalGuard pool_local_guard;
+
+    inline size_t size_class(size_t sz) {
+      return (sz + SXNodePool::size_step - 1) / SXNodePool::size_step - 1;
+    }
+
+    inline Chunk* chunk_of(void* p) {
+      return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(p)
+        & ~static_cast<uintptr_t>(SXNodePool::chunk_size-1));
+    }
+
+    // Make all blocks of an empty chunk available again
+    void chunk_reset(Chunk* ch) {
+      ch->free = nullptr;
+      ch->bump = reinterpret_cast<char*>(ch) + header_size;
+      ch->n_used = 0;
+    }
+
+    Chunk* chunk_new(size_t c, uint64_t owner) {
+      void* mem;
+#ifdef _WIN32
+      mem = _aligned_malloc(SXNodePool::chunk_size, SXNodePool::chunk_size);
+      if (mem==nullptr) throw std::bad_alloc();
+#else // _WIN32
+      if (posix_memalign(&mem, SXNodePool::chunk_size, SXNodePool::chunk_size))
+        throw std::bad_alloc();
+#endif // _WIN32
+      pool_global().n_chunk++;
+      Chunk* ch = new(mem) Chunk();
+      ch->owner.store(owner, std::memory_order_relaxed);
+      ch->remote.store(nullptr, std::memory_order_relaxed);
+      ch->bs = (c+1)*SXNodePool::size_step;
+      ch->end = static_cast<char*>(mem) + header_size
+        + (SXNodePool::chunk_size-header_size) / ch->bs * ch->bs;
+      ch->prev = ch->next = nullptr;
+      chunk_reset(ch);
+      return ch;
+    }
+
+    void chunk_delete(Chunk* ch) {
+      ch->~Chunk();
+#ifdef _WIN32
+      _aligned_free(ch);
+#else // _WIN32
+      ::free(ch);
+#endif // _WIN32
+      pool_global().n_chunk--;
+    }
+
+    // Move blocks released by other threads to the free list of the chunk
+    void chunk_collect(Chunk* ch) {
+      if (ch->remote.load(std::memory_order_relaxed)==nullptr) return;
+      FreeBlock* r = ch->remote.exchange(nullptr, std::memory_order_acquire);
+      FreeBlock* last = r;
+      size_t n = 1;
+      while (last->next) {
+        last = last->next;
+        n++;
+      }
+      last->next = ch->free;
+      ch->free = r;
+      ch->n_used -= n;
+      if (ch->n_used==0) chunk_reset(ch);
+    }
+
+    inline bool chunk_has_space(const Chunk* ch) {
+      return ch->free || ch->bump + ch->bs <= ch->end;
+    }
+
+    inline void* chunk_pop(Chunk* ch) {
+      ch->n_used++;
+      if (ch->free) {
+        FreeBlock* b = ch->free;
+        ch->free = b->next;
+        return b;
+      }
+      void* ret = ch->bump;
+      ch->bump += ch->bs;
+      return ret;
+    }
+
+    // Find a chunk with space for the current thread
+    Chunk* refill(ClassState& s, size_t c) {
+      uint64_t id = pool_local.id;
+      // Current chunk, if other threads have released to it
+      if (s.cur) {
+        chunk_collect(s.cur);
+        if (chunk_has_space(s.cur)) return s.cur;
+        s.cur->list = CHUNK_FULL;
+        s.full.push(s.cur);
+        s.cur = nullptr;
+      }
+      // Chunks with blocks released by this thread
+      while (s.partial.head) {
+        Chunk* ch = s.partial.head;
+        s.partial.remove(ch);
+        chunk_collect(ch);
+        if (chunk_has_space(ch)) {
+          ch->list = CHUNK_CURRENT;
+          return s.cur = ch;
+        }
+        ch->list = CHUNK_FULL;
+        s.full.push(ch);
+      }
+      // Full chunks with blocks released by other threads
+      for (Chunk* ch = s.full.head; ch; ch = ch->next) {
+        if (ch->remote.load(std::memory_order_relaxed)) {
+          chunk_collect(ch);
+          s.full.remove(ch);
+          ch->list = CHUNK_CURRENT;
+          return s.cur = ch;
+        }
+      }
+      // Empty chunk kept from before
+      if (s.spare) {
+        s.cur = s.spare;
+        s.spare = nullptr;
+        s.cur->list = CHUNK_CURRENT;
+        return s.cur;
+      }
+      // Adopt a chunk from an exited thread
+      PoolGlobal& g = pool_global();
+      {
+#ifdef CASADI_WITH_THREAD
+        std::lock_guard<std::mutex> lock(g.mtx);
+#endif // CASADI_WITH_THREAD
+        while (g.abandoned[c].head) {
+          Chunk* ch = g.abandoned[c].head;
+          g.abandoned[c].remove(ch);
+          ch->owner.store(id, std::memory_order_relaxed);
+          chunk_collect(ch);
+          if (chunk_has_space(ch)) {
+            ch->list = CHUNK_CURRENT;
+            return s.cur = ch;
+          }
+          ch->list = CHUNK_FULL;
+          s.full.push(ch);
+        }
+      }
+      // Allocate a new chunk
+      s.cur = chunk_new(c, id);
+      s.cur->list = CHUNK_CURRENT;
+      return s.cur;
+    }
+
+    // Allocate for a thread that is exiting, from the abandoned chunks
+    void* allocate_abandoned(size_t c) {
+      PoolGlobal& g = pool_global();
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(g.mtx);
+#endif // CASADI_WITH_THREAD
+      for (Chunk* ch = g.abandoned[c].head; ch; ch = ch->next) {
+        chunk_collect(ch);
+        if (chunk_has_space(ch)) return chunk_pop(ch);
+      }
+      Chunk* ch = chunk_new(c, 0);
+      ch->list = CHUNK_ABANDONED;
+      g.abandoned[c].push(ch);
+      return chunk_pop(ch);
+    }
+
+    void* allocate_slow(size_t c) {
+      if (pool_local.id==0) {
+        if (pool_local.dead) return allocate_abandoned(c);
+        // First allocation by this thread
+        pool_local.id = ++pool_global().last_id;
+        pool_local_guard.active = true;
+      }
+      return chunk_pop(refill(pool_local.cls[c], c));
+    }
+
+    // Chunk without any blocks in use, owned by the current thread
+    void release_empty(ClassState& s, Chunk* ch) {
+      if (ch->list==CHUNK_PARTIAL) {
+        s.partial.remove(ch);
+      } else {
+        s.full.remove(ch);
+      }
+      chunk_reset(ch);
+      if (s.spare==nullptr) {
+        s.spare = ch;
+      } else {
+        chunk_delete(ch);
+      }
+    }
+
+    // Release n blocks, linked from first to last, to a chunk owned by the current thread
+    inline void release_owned(Chunk* ch, FreeBlock* first, FreeBlock* last, size_t n) {
+      last->next = ch->free;
+      ch->free = first;
+      ch->n_used -= n;
+      ClassState& s = pool_local.cls[size_class(ch->bs)];
+      if (ch!=s.cur) {
+        if (ch->n_used==0) {
+          release_empty(s, ch);
+        } else if (ch->list==CHUNK_FULL) {
+          s.full.remove(ch);
+          ch->list = CHUNK_PARTIAL;
+          s.partial.push(ch);
+        }
+      } else if (ch->n_used==0) {
+        chunk_reset(ch);
+      }
+    }
+
+    // Release the blocks collected by BulkRelease
+    void release_bulk() {
+      for (size_t c=0; c<SXNodePool::n_class; ++c) {
+        BulkRun& r = pool_local.bulk[c];
+        if (r.ch) release_owned(r.ch, r.first, r.last, r.n);
+        r.ch = nullptr;
+      }
+    }
+
+    PoolLocalGuard::~PoolLocalGuard() {
+      release_bulk();
+      pool_local.dead = true;
+      pool_local.id = 0;
+      PoolGlobal& g = pool_global();
+#ifdef CASADI_WITH_THREAD
+      std::lock_guard<std::mutex> lock(g.mtx);
+#endif // CASADI_WITH_THREAD
+      for (size_t c=0; c<SXNodePool::n_class; ++c) {
+        ClassState& s = pool_local.cls[c];
+        if (s.spare) chunk_delete(s.spare);
+        if (s.cur) s.full.push(s.cur);
+        while (s.partial.head) {
+          Chunk* ch = s.partial.head;
+          s.partial.remove(ch);
+          s.full.push(ch);
+        }
+        while (s.full.head) {
+          Chunk* ch = s.full.head;
+          s.full.remove(ch);
+          ch->owner.store(0, std::memory_order_relaxed);
+          ch->list = CHUNK_ABANDONED;
+          g.abandoned[c].push(ch);
+        }
+        s.cur = s.spare = nullptr;
+      }
+    }
+
+  } // namespace
+
+  void* SXNodePool::allocate(size_t sz) {
+    if (sz>max_size) return ::operator new(sz);
+    size_t c = size_class(sz);
+    Chunk* ch = pool_local.cls[c].cur;
+    if (ch && chunk_has_space(ch)) return chunk_pop(ch);
+    return allocate_slow(c);
+  }
+
+  void SXNodePool::deallocate(void* p, size_t sz) {
+    if (p==nullptr) return;
+    if (sz>max_size) return ::operator delete(p);
+    Chunk* ch = chunk_of(p);
+    FreeBlock* b = static_cast<FreeBlock*>(p);
+    BulkRun* r = nullptr;
+    if (pool_local.n_bulk) {
+      // Extend the current run without touching the chunk header
+      r = pool_local.bulk + size_class(sz);
+      if (ch==r->ch) {
+        b->next = r->first;
+        r->first = b;
+        r->n++;
+        return;
+      }
+    }
+    uint64_t id = pool_local.id;
+    if (id!=0 && ch->owner.load(std::memory_order_relaxed)==id) {
+      // Owned by this thread
+      if (r) {
+        // Start a new run
+        if (r->ch) release_owned(r->ch, r->first, r->last, r->n);
+        r->ch = ch;
+        r->first = r->last = b;
+        r->n = 1;
+      } else {
+        release_owned(ch, b, b, 1);
+      }
+    } else {
+      // Owned by another thread, or abandoned
+      FreeBlock* head = ch->remote.load(std::memory_order_relaxed);
+      do {
+        b->next = head;
+      } while (!ch->remote.compare_exchange_weak(head, b, std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    }
+  }
+
+  SXNodePool::BulkRelease::BulkRelease() {
+    pool_local.n_bulk++;
+  }
+
+  SXNodePool::BulkRelease::~BulkRelease() {
+    if (--pool_local.n_bulk==0) release_bulk();
+  }
+
+  SXNodePool::Stats SXNodePool::stats() {
+    PoolGlobal& g = pool_global();
+#ifdef CASADI_WITH_THREAD
+    std::lock_guard<std::mutex> lock(g.mtx);
+#endif // CASADI_WITH_THREAD
+    Stats s;
+    s.n_chunk = g.n_chunk;
+    s.chunk_bytes = s.n_chunk*chunk_size;
+    s.n_abandoned = 0;
+    for (size_t c=0; c<n_class; ++c) {
+      for (Chunk* ch = g.abandoned[c].head; ch; ch = ch->next) s.n_abandoned++;
+    }
+    return s;
+  }
+
+} // namespace casadi
@@ -0,0 +1,108 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010-2014 Joel Andersson, Joris Gillis, Moritz Diehl,
+ *                            K.U. Leuven. All rights reserved.
+ *    Copyright (C) 2011-2014 Greg Horn
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifndef CASADI_SX_NODE_POOL_HPP
+#define CASADI_SX_NODE_POOL_HPP
+
+#include "casadi_common.hpp"
+
+/// \cond INTERNAL
+
+namespace casadi {
+
+  /** \brief Pooled memory for SXNode instances
+
+      Expression graphs consist of millions of small nodes of only a handful
+      of sizes. Instead of going through malloc/free for every node, blocks
+      are handed out from aligned chunks of chunk_size bytes, one size class
+      of size_step bytes per chunk.
+
+      Every chunk is owned by a thread, which allocates from it and releases
+      to it without any locking. Blocks released by another thread are pushed
+      onto a lock-free list of the chunk and are reclaimed by the owner when
+      it runs out of space. A chunk in which all blocks have been released is
+      returned to the operating system as a whole, except for one spare chunk
+      per size class and thread. The chunks of an exiting thread are handed
+      over to a global list, from which other threads adopt them.
+
+      Blocks larger than max_size go through the global operator new.
+  */
+  class CASADI_EXPORT SXNodePool {
+  public:
+    /// Allocate a block of at least sz bytes
+    static void* allocate(size_t sz);
+
+    /// Release a block allocated with allocate(sz)
+    static void deallocate(void* p, size_t sz);
+
+    /** \brief Release blocks in bulk
+
+        While an instance is alive, blocks released by the current thread to
+        chunks it owns are only collected. When the outermost instance goes
+        out of scope, each run of blocks belonging to the same chunk is
+        spliced into the free list of that chunk at once, with a single
+        update of its bookkeeping. Collected blocks are not reused before
+        that. Used when tearing down expression graphs.
+    */
+    class CASADI_EXPORT BulkRelease {
+    public:
+      BulkRelease();
+      ~BulkRelease();
+    private:
+      BulkRelease(const BulkRelease&);
+      BulkRelease& operator=(const BulkRelease&);
+    };
+
+    /// Statistics
+    struct Stats {
+      /// Number of chunks currently allocated
+      size_t n_chunk;
+      /// Memory held in chunks [bytes]
+      size_t chunk_bytes;
+      /// Chunks left behind by exited threads and not yet adopted
+      size_t n_abandoned;
+    };
+
+    /// Get statistics for the whole process
+    static Stats stats();
+
+    /// Granularity of the size classes [bytes]
+    static const size_t size_step = 16;
+
+    /// Largest block served from the pool [bytes]
+    static const size_t max_size = 128;
+
+    /// Number of size classes
+    static const size_t n_class = max_size / size_step;
+
+    /// Size and alignment of a chunk [bytes]
+    static const size_t chunk_size = 64*1024;
+  };
+
+} // namespace casadi
+
+/// \endcond
+
+#endif // CASADI_SX_NODE_POOL_HPP
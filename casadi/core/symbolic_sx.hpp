@@ -66,10 +66,10 @@ public:
     s.pack("SymbolicSX::name", name_);
   }
 
-  static SXNode* deserialize(DeserializingStream& s) {
+  static SXElem deserialize(DeserializingStream& s) {
     std::string name;
     s.unpack("SymbolicSX::name", name);
-    return new SymbolicSX(name);
+    return SXElem::create(new SymbolicSX(name));
   }
 };
 
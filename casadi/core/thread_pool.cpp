@@ -0,0 +1,268 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010-2014 Joel Andersson, Joris Gillis, Moritz Diehl,
+ *                            K.U. Leuven. All rights reserved.
+ *    Copyright (C) 2011-2014 Greg Horn
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+
+#include "thread_pool.hpp"
+#include "global_options.hpp"
+#include "exception.hpp"
+
+#include <chrono>
+
+#if defined(CASADI_WITH_THREAD) && defined(__linux__) && !defined(CASADI_WITH_THREAD_MINGW)
+#include <pthread.h>
+#include <sched.h>
+#define CASADI_WITH_THREAD_AFFINITY
+#endif
+
+using namespace std;
+
+namespace casadi {
+
+  void add_worker_stats(Dict& stats, const std::vector<WorkerStats>& ws) {
+    std::vector<double> t_busy, t_idle;
+    std::vector<casadi_int> n_task, n_steal;
+    for (auto&& w : ws) {
+      t_busy.push_back(w.t_busy);
+      t_idle.push_back(w.t_idle);
+      n_task.push_back(w.n_task);
+      n_steal.push_back(w.n_steal);
+    }
+    stats["worker_t_busy"] = t_busy;
+    stats["worker_t_idle"] = t_idle;
+    stats["worker_n_task"] = n_task;
+    stats["worker_n_steal"] = n_steal;
+  }
+
+  ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  casadi_int ThreadPool::target_size() {
+    if (GlobalOptions::thread_pool_size>0) return GlobalOptions::thread_pool_size;
+#ifdef CASADI_WITH_THREAD
+    // The calling thread takes part in the evaluation
+    casadi_int n = std::thread::hardware_concurrency();
+    return max(n-1, casadi_int(1));
+#else // CASADI_WITH_THREAD
+    return 0;
+#endif // CASADI_WITH_THREAD
+  }
+
+#ifndef CASADI_WITH_THREAD
+
+  ThreadPool::ThreadPool() {
+  }
+
+  ThreadPool::~ThreadPool() {
+  }
+
+  void ThreadPool::run(casadi_int n_task, casadi_int n_slot, casadi_int chunk_size,
+                       const Body& body, std::vector<WorkerStats>* stats) {
+    auto t_start = std::chrono::steady_clock::now();
+    for (casadi_int i=0; i<n_task; ++i) body(i, 0);
+    if (stats) {
+      std::chrono::duration<double> t = std::chrono::steady_clock::now() - t_start;
+      stats->assign(max(n_slot, casadi_int(1)), WorkerStats{0, t.count(), 0, 0});
+      stats->front() = WorkerStats{t.count(), 0, n_task, 0};
+    }
+  }
+
+#else // CASADI_WITH_THREAD
+
+  ThreadPool::ThreadPool() : stop_(false) {
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto&& w : workers_) w.join();
+  }
+
+  void ThreadPool::grow() {
+    casadi_int n = target_size();
+    while (static_cast<casadi_int>(workers_.size())<n) {
+      workers_.emplace_back([this]() { worker_loop(); });
+#ifdef CASADI_WITH_THREAD_AFFINITY
+      if (GlobalOptions::thread_pool_bind) {
+        // Bind worker k to core k+1, the calling thread typically runs on core 0
+        casadi_int n_cpu = std::thread::hardware_concurrency();
+        if (n_cpu>0) {
+          cpu_set_t cpuset;
+          CPU_ZERO(&cpuset);
+          CPU_SET(workers_.size() % n_cpu, &cpuset);
+          pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+        }
+      }
+#endif // CASADI_WITH_THREAD_AFFINITY
+    }
+  }
+
+  void ThreadPool::worker_loop() {
+    while (true) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+        if (stop_ && jobs_.empty()) return;
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+      work(*job.batch, job.slot);
+    }
+  }
+
+  namespace {
+    inline uint64_t pack_range(casadi_int begin, casadi_int end) {
+      return (static_cast<uint64_t>(begin) << 32) | static_cast<uint64_t>(end);
+    }
+    inline casadi_int range_begin(uint64_t r) { return static_cast<casadi_int>(r >> 32);}
+    inline casadi_int range_end(uint64_t r) { return static_cast<casadi_int>(r & 0xffffffff);}
+  } // namespace
+
+  bool ThreadPool::take(Batch& b, casadi_int slot, casadi_int& start, casadi_int& stop) {
+    std::atomic<uint64_t>& r = b.range[slot];
+    uint64_t cur = r.load();
+    while (true) {
+      start = range_begin(cur);
+      casadi_int end = range_end(cur);
+      if (start>=end) return false;
+      stop = min(start+b.chunk_size, end);
+      // Thieves may shrink the range concurrently
+      if (r.compare_exchange_weak(cur, pack_range(stop, end))) return true;
+    }
+  }
+
+  bool ThreadPool::steal(Batch& b, casadi_int slot) {
+    // Visit the other slots, starting with the neighbor
+    for (casadi_int k=1; k<b.n_slot; ++k) {
+      std::atomic<uint64_t>& r = b.range[(slot+k) % b.n_slot];
+      uint64_t cur = r.load();
+      while (true) {
+        casadi_int begin = range_begin(cur), end = range_end(cur);
+        if (begin>=end) break;
+        // Take the back half, rounded up
+        casadi_int mid = begin + (end-begin)/2;
+        if (r.compare_exchange_weak(cur, pack_range(begin, mid))) {
+          // Own range is empty, hence not touched by others
+          b.range[slot].store(pack_range(mid, end));
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void ThreadPool::work(Batch& b, casadi_int slot) {
+    WorkerStats& ws = b.stats[slot];
+    casadi_int start, stop;
+    while (true) {
+      // Claim a chunk, stealing if the own range is exhausted.
+      // The batch may already be completed if this job started late,
+      // in which case b.body must not be touched
+      if (!take(b, slot, start, stop)) {
+        if (!steal(b, slot)) return;
+        ws.n_steal++;
+        continue;
+      }
+      auto t_start = std::chrono::steady_clock::now();
+      for (casadi_int i=start; i<stop; ++i) {
+        try {
+          (*b.body)(i, slot);
+        } catch (...) {
+          casadi_warning("Uncaught exception in thread pool task.");
+        }
+      }
+      std::chrono::duration<double> t = std::chrono::steady_clock::now() - t_start;
+      ws.t_busy += t.count();
+      ws.n_task += stop-start;
+      // Last chunk to complete wakes up the caller
+      if (b.done.fetch_add(stop-start)+stop-start==b.n_task) {
+        { std::lock_guard<std::mutex> lock(b.mtx); }
+        b.cv.notify_all();
+      }
+    }
+  }
+
+  void ThreadPool::run(casadi_int n_task, casadi_int n_slot, casadi_int chunk_size,
+                       const Body& body, std::vector<WorkerStats>* stats) {
+    auto t_start = std::chrono::steady_clock::now();
+    chunk_size = max(chunk_size, casadi_int(1));
+    n_slot = max(min(n_slot, n_task), casadi_int(1));
+    casadi_assert(n_task < (casadi_int(1) << 32), "Too many tasks for thread pool");
+
+    // Quick return if no parallelism
+    if (n_slot==1) {
+      for (casadi_int i=0; i<n_task; ++i) body(i, 0);
+      if (stats) {
+        std::chrono::duration<double> t = std::chrono::steady_clock::now() - t_start;
+        stats->assign(1, WorkerStats{t.count(), 0, n_task, 0});
+      }
+      return;
+    }
+
+    // Shared state, with tasks initially split evenly among the slots
+    auto b = std::make_shared<Batch>(n_slot);
+    b->n_task = n_task;
+    b->n_slot = n_slot;
+    b->chunk_size = chunk_size;
+    b->body = &body;
+    for (casadi_int k=0; k<n_slot; ++k) {
+      b->range[k].store(pack_range(k*n_task/n_slot, (k+1)*n_task/n_slot));
+      b->stats[k] = WorkerStats{0, 0, 0, 0};
+    }
+    b->done = 0;
+
+    // Hand out the other slots to the workers
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      grow();
+      for (casadi_int k=1; k<n_slot; ++k) jobs_.push_back(Job{b, k});
+    }
+    cv_.notify_all();
+
+    // Take part in the evaluation
+    work(*b, 0);
+
+    // Wait for tasks checked out by other workers
+    {
+      std::unique_lock<std::mutex> lock(b->mtx);
+      b->cv.wait(lock, [&b]() { return b->done==b->n_task; });
+    }
+
+    // Collect statistics, slots that did not start are counted as idle
+    if (stats) {
+      std::chrono::duration<double> t = std::chrono::steady_clock::now() - t_start;
+      *stats = b->stats;
+      for (auto&& s : *stats) s.t_idle = max(t.count() - s.t_busy, 0.);
+    }
+  }
+
+#endif // CASADI_WITH_THREAD
+
+} // namespace casadi
@@ -0,0 +1,176 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010-2014 Joel Andersson, Joris Gillis, Moritz Diehl,
+ *                            K.U. Leuven. All rights reserved.
+ *    Copyright (C) 2011-2014 Greg Horn
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+
+#ifndef CASADI_THREAD_POOL_HPP
+#define CASADI_THREAD_POOL_HPP
+
+#include "generic_type.hpp"
+#include <functional>
+
+#ifdef CASADI_WITH_THREAD
+#ifdef CASADI_WITH_THREAD_MINGW
+#include <mingw.thread.h>
+#include <mingw.mutex.h>
+#include <mingw.condition_variable.h>
+#else // CASADI_WITH_THREAD_MINGW
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif // CASADI_WITH_THREAD_MINGW
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#endif // CASADI_WITH_THREAD
+
+/// \cond INTERNAL
+
+namespace casadi {
+
+  /** \brief Statistics of a single worker slot during ThreadPool::run */
+  struct CASADI_EXPORT WorkerStats {
+    /// Wall time spent evaluating tasks [s]
+    double t_busy;
+    /// Wall time spent waiting for other workers or not started [s]
+    double t_idle;
+    /// Number of tasks evaluated
+    casadi_int n_task;
+    /// Number of successful steals from other workers
+    casadi_int n_steal;
+  };
+
+  /// Add per-worker statistics to a stats dictionary
+  CASADI_EXPORT void add_worker_stats(Dict& stats, const std::vector<WorkerStats>& ws);
+
+  /** \brief Persistent, process-wide pool of worker threads
+
+      Worker threads are spawned lazily on first use and are kept alive
+      until the process exits, such that repeated parallel evaluations
+      do not pay for thread creation. The pool grows up to
+      GlobalOptions::thread_pool_size workers, it never shrinks.
+
+      Without CASADI_WITH_THREAD, all work is executed by the calling thread.
+  */
+  class CASADI_EXPORT ThreadPool {
+  public:
+    /// Task body: called with the task index and the slot of the executing worker
+    typedef std::function<void(casadi_int, casadi_int)> Body;
+
+    /// Access the process-wide pool
+    static ThreadPool& instance();
+
+    /// Number of worker threads that the pool will (eventually) hold
+    static casadi_int target_size();
+
+    /** \brief Execute tasks 0, ..., n_task-1 using at most n_slot concurrent workers
+
+        The body is invoked as body(task, slot), where slot lies in [0, n_slot)
+        and is never used by two concurrent invocations. This allows callers to
+        preallocate one work buffer per slot.
+
+        The tasks are initially split into one contiguous range per slot. Each
+        worker takes chunks of chunk_size tasks from the front of its own range
+        and, once that is exhausted, steals the back half of the range of
+        another slot. This balances the load when task costs are uneven.
+
+        The calling thread takes part in the evaluation as slot 0, so nested
+        calls cannot deadlock the pool. Returns when all tasks have completed.
+        The body must not throw. If stats is given, it is resized to n_slot
+        and filled with the statistics of each slot.
+    */
+    void run(casadi_int n_task, casadi_int n_slot, casadi_int chunk_size,
+             const Body& body, std::vector<WorkerStats>* stats=nullptr);
+
+    /// Destructor, joins all worker threads
+    ~ThreadPool();
+
+  private:
+    /// Constructor (use instance())
+    ThreadPool();
+
+#ifdef CASADI_WITH_THREAD
+    /// State shared between the caller and the workers of a single run
+    struct Batch {
+      casadi_int n_task;
+      casadi_int n_slot;
+      casadi_int chunk_size;
+      const Body* body;
+      // Unclaimed tasks [begin, end) of each slot, packed as (begin << 32) | end
+      std::vector<std::atomic<uint64_t>> range;
+      // Statistics of each slot
+      std::vector<WorkerStats> stats;
+      // Number of completed tasks
+      std::atomic<casadi_int> done;
+      // Signals completion to the caller
+      std::mutex mtx;
+      std::condition_variable cv;
+      // Constructor
+      explicit Batch(casadi_int n_slot) : range(n_slot), stats(n_slot) {}
+    };
+
+    /// Claim up to chunk_size tasks from the front of the own range
+    static bool take(Batch& b, casadi_int slot, casadi_int& start, casadi_int& stop);
+
+    /// Move the back half of another slot's range to the own (empty) range
+    static bool steal(Batch& b, casadi_int slot);
+
+    /// Queued job: execute chunks of a batch as a given slot
+    struct Job {
+      std::shared_ptr<Batch> batch;
+      casadi_int slot;
+    };
+
+    /// Execute chunks of a batch until there are none left
+    static void work(Batch& b, casadi_int slot);
+
+    /// Main loop of a worker thread
+    void worker_loop();
+
+    /// Spawn workers until the target size is reached (mtx_ must be held)
+    void grow();
+
+    /// Worker threads
+    std::vector<std::thread> workers_;
+
+    /// Pending jobs
+    std::deque<Job> jobs_;
+
+    /// Protects jobs_, workers_ and stop_
+    std::mutex mtx_;
+
+    /// Signals new jobs or shutdown to the workers
+    std::condition_variable cv_;
+
+    /// Shut down the workers
+    bool stop_;
+#endif // CASADI_WITH_THREAD
+  };
+
+} // namespace casadi
+
+/// \endcond
+
+#endif // CASADI_THREAD_POOL_HPP
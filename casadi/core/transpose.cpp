@@ -214,7 +214,7 @@ namespace casadi {
                             const std::vector<casadi_int>& arg,
                             const std::vector<casadi_int>& res) const {
     g << g.trans(g.work(arg[0], nnz()), dep().sparsity(),
-                 g.work(res[0], nnz()), sparsity(), "iw") <<  ";\n";
+                 g.work(res[0], nnz()), sparsity(), "iw") <<  "\n";
   }
 
   void DenseTranspose::generate(CodeGenerator& g,
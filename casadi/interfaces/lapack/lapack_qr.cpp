@@ -55,7 +55,7 @@ namespace casadi {
   }
 
   const Options LapackQr::options_
-  = {{&FunctionInternal::options_},
+  = {{&FunctionInternal::options_, &LinsolInternal::options_},
      {{"max_nrhs",
        {OT_INT,
         "Maximum number of right-hand-sides that get processed in a single pass [default:10]."}}
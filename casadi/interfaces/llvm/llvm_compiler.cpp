@@ -0,0 +1,327 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010-2014 Joel Andersson, Joris Gillis, Moritz Diehl,
+ *                            K.U. Leuven. All rights reserved.
+ *    Copyright (C) 2011-2014 Greg Horn
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+
+#include "llvm_compiler.hpp"
+#include "casadi/core/casadi_misc.hpp"
+#include "casadi/core/sx_function.hpp"
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <chrono>
+#include <mutex>
+
+using namespace std;
+namespace casadi {
+
+  extern "C"
+  int CASADI_IMPORTER_LLVM_EXPORT
+  casadi_register_importer_llvm(ImporterInternal::Plugin* plugin) {
+    plugin->creator = LlvmCompiler::creator;
+    plugin->name = "llvm";
+    plugin->doc = LlvmCompiler::meta_doc.c_str();
+    plugin->version = CASADI_VERSION;
+    plugin->options = &LlvmCompiler::options_;
+    plugin->exposed.lowers = true;
+    return 0;
+  }
+
+  extern "C"
+  void CASADI_IMPORTER_LLVM_EXPORT casadi_load_importer_llvm() {
+    ImporterInternal::registerPlugin(casadi_register_importer_llvm);
+  }
+
+  namespace {
+    // Throw an LLVM error as a CasADi exception
+    template<typename T>
+    T llvm_check(llvm::Expected<T> e) {
+      if (!e) casadi_error("LLVM: " + llvm::toString(e.takeError()));
+      return std::move(*e);
+    }
+    void llvm_check(llvm::Error e) {
+      if (e) casadi_error("LLVM: " + llvm::toString(std::move(e)));
+    }
+
+    // Evaluate an operation not lowered to native instructions
+    double llvm_fun(int op, double x, double y) {
+      double f;
+      casadi_math<double>::fun(op, x, y, f);
+      return f;
+    }
+
+    // Seconds since an instant
+    double elapsed(const std::chrono::steady_clock::time_point& t0) {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+  } // namespace
+
+  LlvmCompiler::LlvmCompiler(const std::string& name) : ImporterInternal(name) {
+    opt_level_ = 2;
+    t_lower_ = t_compile_ = 0;
+  }
+
+  LlvmCompiler::~LlvmCompiler() {
+  }
+
+  const Options LlvmCompiler::options_
+  = {{&ImporterInternal::options_},
+     {{"opt_level",
+       {OT_INT,
+        "Optimization level of the IR passes and of the native code generation, 0-3. "
+        "Default: 2"}}
+     }
+  };
+
+  void LlvmCompiler::init(const Dict& opts) {
+    // Base class
+    ImporterInternal::init(opts);
+
+    // Read options
+    for (auto&& op : opts) {
+      if (op.first=="opt_level") {
+        opt_level_ = op.second;
+      }
+    }
+    casadi_assert(opt_level_>=0 && opt_level_<=3,
+      "Option 'opt_level' must be 0, 1, 2 or 3, got " + str(opt_level_));
+
+    // Register the native target once per process
+    static std::once_flag native_target;
+    std::call_once(native_target, []() {
+      llvm::InitializeNativeTarget();
+      llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    // Native code generation at the requested optimization level
+    auto jtmb = llvm_check(llvm::orc::JITTargetMachineBuilder::detectHost());
+    jtmb.setCodeGenOptLevel(opt_level_==0 ? llvm::CodeGenOpt::None :
+                            opt_level_==1 ? llvm::CodeGenOpt::Less :
+                            opt_level_==2 ? llvm::CodeGenOpt::Default :
+                            llvm::CodeGenOpt::Aggressive);
+    jit_ = llvm_check(llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(jtmb))
+                      .create());
+
+    // Resolve math library calls against the running process
+    jit_->getMainJITDylib().addGenerator(llvm_check(
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit_->getDataLayout().getGlobalPrefix())));
+  }
+
+  void LlvmCompiler::lower(const Function& f, const std::string& symname) {
+    auto t0 = std::chrono::steady_clock::now();
+    const SXFunction* sxf = dynamic_cast<const SXFunction*>(f.get());
+    casadi_assert(sxf!=nullptr, "The 'llvm' compiler only supports SX functions, got "
+      + f.class_name() + " '" + f.name() + "'. Use e.g. the 'shell' compiler instead.");
+    casadi_assert(!sxf->has_free(), "Cannot compile '" + f.name() + "' since variables "
+      + str(sxf->free_vars_) + " are free.");
+
+    // Module holding the function
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module = std::make_unique<llvm::Module>(symname, *context);
+    module->setDataLayout(jit_->getDataLayout());
+    llvm::IRBuilder<> b(*context);
+
+    // Types
+    llvm::Type* t_real = b.getDoubleTy();
+    llvm::Type* t_int = b.getIntNTy(8*sizeof(casadi_int));
+    llvm::Type* t_real_p = t_real->getPointerTo();
+    llvm::Type* t_real_pp = t_real_p->getPointerTo();
+    llvm::FunctionType* t_fun = llvm::FunctionType::get(b.getInt32Ty(),
+      {t_real_pp, t_real_pp, t_int->getPointerTo(), t_real_p, b.getInt32Ty()}, false);
+
+    // Signature of eval_t: int f(const double** arg, double** res, casadi_int* iw, double* w, int)
+    llvm::Function* fun = llvm::Function::Create(t_fun, llvm::Function::ExternalLinkage,
+                                                 symname, module.get());
+    llvm::Value* arg = fun->getArg(0);
+    llvm::Value* res = fun->getArg(1);
+    b.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", fun));
+
+    // Missing inputs are read from zeros, missing outputs written to a dummy buffer
+    casadi_int max_nnz_in = 1, max_nnz_out = 1;
+    for (casadi_int i=0; i<f.n_in(); ++i) max_nnz_in = std::max(max_nnz_in, f.nnz_in(i));
+    for (casadi_int i=0; i<f.n_out(); ++i) max_nnz_out = std::max(max_nnz_out, f.nnz_out(i));
+    llvm::ArrayType* t_zeros = llvm::ArrayType::get(t_real, max_nnz_in);
+    llvm::Value* zeros = b.CreateBitCast(new llvm::GlobalVariable(*module, t_zeros, true,
+      llvm::GlobalValue::PrivateLinkage, llvm::ConstantAggregateZero::get(t_zeros)), t_real_p);
+    llvm::Value* dummy = b.CreateAlloca(t_real, b.getInt64(max_nnz_out));
+
+    // Input and output pointers, loaded on first use
+    auto io_ptr = [&](llvm::Value* io, casadi_int i, llvm::Value* fallback) {
+      llvm::Value* p = b.CreateLoad(t_real_p, b.CreateConstInBoundsGEP1_64(t_real_p, io, i));
+      return b.CreateSelect(b.CreateIsNull(p), fallback, p);
+    };
+    std::vector<llvm::Value*> in(f.n_in(), nullptr), out(f.n_out(), nullptr);
+
+    // Calls to the math library and to the generic fallback
+    auto call = [&](const std::string& name, const std::vector<llvm::Value*>& x) {
+      std::vector<llvm::Type*> t(x.size(), t_real);
+      llvm::FunctionCallee c = module->getOrInsertFunction(name,
+        llvm::FunctionType::get(t_real, t, false));
+      return b.CreateCall(c, x);
+    };
+    llvm::FunctionType* t_generic = llvm::FunctionType::get(t_real,
+      {b.getInt32Ty(), t_real, t_real}, false);
+    llvm::Value* generic = b.CreateIntToPtr(
+      b.getInt64(reinterpret_cast<uint64_t>(&llvm_fun)), t_generic->getPointerTo());
+
+    // Work vector elements are SSA values
+    std::vector<llvm::Value*> w(sxf->worksize_, nullptr);
+    llvm::Value* zero = llvm::ConstantFP::get(t_real, 0.);
+    llvm::Value* one = llvm::ConstantFP::get(t_real, 1.);
+    auto from_bool = [&](llvm::Value* v) { return b.CreateUIToFP(v, t_real);};
+    for (auto&& e : sxf->algorithm_) {
+      llvm::Value *x = nullptr, *y = nullptr, *r = nullptr;
+      if (e.op!=OP_CONST && e.op!=OP_INPUT && e.op!=OP_OUTPUT) {
+        casadi_int ndep = casadi_math<double>::ndeps(e.op);
+        if (ndep>=1) x = w[e.i1];
+        y = ndep==2 ? w[e.i2] : zero;
+      }
+      switch (e.op) {
+      case OP_CONST: r = llvm::ConstantFP::get(t_real, e.d); break;
+      case OP_INPUT:
+        if (!in[e.i1]) in[e.i1] = io_ptr(arg, e.i1, zeros);
+        r = b.CreateLoad(t_real, b.CreateConstInBoundsGEP1_64(t_real, in[e.i1], e.i2));
+        break;
+      case OP_OUTPUT:
+        if (!out[e.i0]) out[e.i0] = io_ptr(res, e.i0, dummy);
+        b.CreateStore(w[e.i1], b.CreateConstInBoundsGEP1_64(t_real, out[e.i0], e.i2));
+        continue;
+      case OP_ASSIGN: case OP_LIFT: r = x; break;
+      case OP_ADD: r = b.CreateFAdd(x, y); break;
+      case OP_SUB: r = b.CreateFSub(x, y); break;
+      case OP_MUL: r = b.CreateFMul(x, y); break;
+      case OP_DIV: r = b.CreateFDiv(x, y); break;
+      case OP_NEG: r = b.CreateFNeg(x); break;
+      case OP_SQ: r = b.CreateFMul(x, x); break;
+      case OP_TWICE: r = b.CreateFMul(llvm::ConstantFP::get(t_real, 2.), x); break;
+      case OP_INV: r = b.CreateFDiv(one, x); break;
+      case OP_FMOD: r = b.CreateFRem(x, y); break;
+      case OP_LT: r = from_bool(b.CreateFCmpOLT(x, y)); break;
+      case OP_LE: r = from_bool(b.CreateFCmpOLE(x, y)); break;
+      case OP_EQ: r = from_bool(b.CreateFCmpOEQ(x, y)); break;
+      case OP_NE: r = from_bool(b.CreateFCmpUNE(x, y)); break;
+      case OP_NOT: r = from_bool(b.CreateFCmpOEQ(x, zero)); break;
+      case OP_AND:
+        r = from_bool(b.CreateAnd(b.CreateFCmpUNE(x, zero), b.CreateFCmpUNE(y, zero)));
+        break;
+      case OP_OR:
+        r = from_bool(b.CreateOr(b.CreateFCmpUNE(x, zero), b.CreateFCmpUNE(y, zero)));
+        break;
+      case OP_IF_ELSE_ZERO: r = b.CreateSelect(b.CreateFCmpOEQ(x, zero), zero, y); break;
+      case OP_SQRT: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::sqrt, x); break;
+      case OP_FABS: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::fabs, x); break;
+      case OP_FLOOR: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::floor, x); break;
+      case OP_CEIL: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::ceil, x); break;
+      case OP_SIN: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::sin, x); break;
+      case OP_COS: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::cos, x); break;
+      case OP_EXP: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::exp, x); break;
+      case OP_LOG: r = b.CreateUnaryIntrinsic(llvm::Intrinsic::log, x); break;
+      case OP_POW: case OP_CONSTPOW:
+        r = b.CreateBinaryIntrinsic(llvm::Intrinsic::pow, x, y);
+        break;
+      case OP_FMIN: r = b.CreateBinaryIntrinsic(llvm::Intrinsic::minnum, x, y); break;
+      case OP_FMAX: r = b.CreateBinaryIntrinsic(llvm::Intrinsic::maxnum, x, y); break;
+      case OP_COPYSIGN: r = b.CreateBinaryIntrinsic(llvm::Intrinsic::copysign, x, y); break;
+      case OP_TAN: r = call("tan", {x}); break;
+      case OP_ASIN: r = call("asin", {x}); break;
+      case OP_ACOS: r = call("acos", {x}); break;
+      case OP_ATAN: r = call("atan", {x}); break;
+      case OP_SINH: r = call("sinh", {x}); break;
+      case OP_COSH: r = call("cosh", {x}); break;
+      case OP_TANH: r = call("tanh", {x}); break;
+      case OP_ASINH: r = call("asinh", {x}); break;
+      case OP_ACOSH: r = call("acosh", {x}); break;
+      case OP_ATANH: r = call("atanh", {x}); break;
+      case OP_ERF: r = call("erf", {x}); break;
+      case OP_ATAN2: r = call("atan2", {x, y}); break;
+      default:
+        // Any other operation, e.g. sign or erfinv, as in the interpreter
+        r = b.CreateCall(t_generic, generic, {b.getInt32(e.op), x, y});
+      }
+      w[e.i0] = r;
+    }
+    b.CreateRet(b.getInt32(0));
+
+    // Consistency check
+    std::string msg;
+    llvm::raw_string_ostream msg_stream(msg);
+    casadi_assert(!llvm::verifyModule(*module, &msg_stream), "LLVM: " + msg_stream.str());
+
+    // Optimize
+    if (opt_level_>0) {
+      llvm::LoopAnalysisManager lam;
+      llvm::FunctionAnalysisManager fam;
+      llvm::CGSCCAnalysisManager cgam;
+      llvm::ModuleAnalysisManager mam;
+      llvm::PassBuilder pb;
+      pb.registerModuleAnalyses(mam);
+      pb.registerCGSCCAnalyses(cgam);
+      pb.registerFunctionAnalyses(fam);
+      pb.registerLoopAnalyses(lam);
+      pb.crossRegisterProxies(lam, fam, cgam, mam);
+      llvm::OptimizationLevel level = opt_level_==1 ? llvm::OptimizationLevel::O1 :
+        opt_level_==2 ? llvm::OptimizationLevel::O2 : llvm::OptimizationLevel::O3;
+      pb.buildPerModuleDefaultPipeline(level).run(*module, mam);
+    }
+    t_lower_ += elapsed(t0);
+
+    // Add to the JIT and generate native code right away
+    t0 = std::chrono::steady_clock::now();
+    llvm_check(jit_->addIRModule(llvm::orc::ThreadSafeModule(std::move(module),
+                                                              std::move(context))));
+    casadi_assert(get_function(symname)!=nullptr, "Cannot load '" + symname + "'");
+    t_compile_ += elapsed(t0);
+  }
+
+  signal_t LlvmCompiler::get_function(const std::string& symname) {
+    auto sym = jit_->lookup(symname);
+    if (!sym) {
+      llvm::consumeError(sym.takeError());
+      return nullptr;
+    }
+#if LLVM_VERSION_MAJOR >= 15
+    return sym->toPtr<signal_t>();
+#else
+    return reinterpret_cast<signal_t>(sym->getAddress());
+#endif
+  }
+
+  Dict LlvmCompiler::get_stats() const {
+    Dict stats;
+    stats["t_lower"] = t_lower_;
+    stats["t_compile"] = t_compile_;
+    return stats;
+  }
+
+} // namespace casadi
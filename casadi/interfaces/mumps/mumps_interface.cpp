@@ -56,7 +56,7 @@ namespace casadi {
   }
 
   const Options MumpsInterface::options_
-  = {{&ProtoFunction::options_},
+  = {{&LinsolInternal::options_},
      {{"symmetric",
       {OT_BOOL,
        "Symmetric matrix"}},
@@ -25,6 +25,8 @@
 
 #include "linsol_ldl.hpp"
 #include "casadi/core/global_options.hpp"
+#include "casadi/core/sparsity_internal.hpp"
+#include "casadi/core/thread_pool.hpp"
 
 using namespace std;
 namespace casadi {
@@ -55,13 +57,27 @@ namespace casadi {
   }
 
   const Options LinsolLdl::options_
-  = {{&ProtoFunction::options_},
+  = {{&LinsolInternal::options_},
      {{"incomplete",
       {OT_BOOL,
        "Incomplete factorization, without any fill-in"}},
       {"preordering",
        {OT_BOOL,
-       "Approximate minimal degree (AMD) preordering"}}
+       "Use a fill-reducing preordering, chosen with 'ordering' [default: true]"}},
+      {"ordering",
+       {OT_STRING,
+       "Fill-reducing preordering: 'amd' (approximate minimal degree), "
+       "'nd' (nested dissection) or 'none' [default: 'amd']"}},
+      {"supernodal",
+       {OT_BOOL,
+       "Factorize columns with a common sparsity pattern (supernodes) "
+       "as dense blocks. By default, only done when the factorization "
+       "is large enough to benefit"}},
+      {"max_workers",
+       {OT_INT,
+       "Maximum number of concurrent workers, including the calling thread, "
+       "for factorizing and solving independent subtrees of the elimination tree. "
+       "Generated code is always sequential [default: 1]"}}
      }
   };
 
@@ -71,35 +87,155 @@ namespace casadi {
 
     // Default options
     incomplete_ = false;
-    amd_ = true;
+    bool preordering = true;
+    preordering_ = "amd";
+    supernodal_ = true;
+    bool supernodal_auto = true;
+    max_workers_ = 1;
 
     // Read user options
     for (auto&& op : opts) {
       if (op.first=="incomplete") {
         incomplete_ = op.second;
-      } else if (op.first=="amd") {
-        amd_ = op.second;
+      } else if (op.first=="preordering") {
+        preordering = op.second;
+      } else if (op.first=="ordering") {
+        preordering_ = op.second.to_string();
+      } else if (op.first=="supernodal") {
+        supernodal_ = op.second;
+        supernodal_auto = false;
+      } else if (op.first=="max_workers") {
+        max_workers_ = op.second;
       }
     }
 
+    // Fill-reducing preordering
+    if (!preordering) preordering_ = "none";
+    if (preordering_=="amd") {
+      p_ = sp_.amd();
+    } else if (preordering_=="nd") {
+      p_ = sp_.nd();
+    } else {
+      casadi_assert(preordering_=="none", "Unknown ordering '" + preordering_ + "', "
+                    "expected 'amd', 'nd' or 'none'");
+      p_ = range(sp_.size1());
+    }
+
     // Symbolic factorization
+    std::vector<casadi_int> tmp;
+    Sparsity Aperm = sp_.sub(p_, p_, tmp);
     if (incomplete_) {
-      if (amd_) {
-        // Incomplete LDL^T, AMD permutation
-        p_ = sp_.amd();
-        std::vector<casadi_int> tmp;
+      sp_Lt_ = triu(Aperm, false);  // no fill-in
+    } else {
+      sp_Lt_ = Aperm.ldl(tmp, false);
+    }
+
+    // Supernode updates go to shared ancestors, so they are not parallelized
+    casadi_assert(max_workers_>=1, "Option 'max_workers' must be positive");
+    if (max_workers_>1) {
+      casadi_assert(supernodal_auto || !supernodal_,
+        "Options 'supernodal' and 'max_workers' cannot be combined");
+      supernodal_ = false;
+    }
+    if (supernodal_ && supernodal_auto) {
+      // Dense kernels only pay off for factorizations with some 1e5 multiply-adds
+      std::vector<casadi_int> l_count(sp_Lt_.size1(), 0);
+      const casadi_int* lt_row = sp_Lt_.row();
+      for (casadi_int k=0; k<sp_Lt_.nnz(); ++k) l_count[lt_row[k]]++;
+      casadi_int n_madd = 0;
+      for (casadi_int k : l_count) n_madd += k*k;
+      supernodal_ = n_madd >= 100000;
+    }
+    if (incomplete_) supernodal_ = false;
+
+    // Postorder the elimination tree so that chains and subtrees are contiguous
+    casadi_int n = sp_.size1();
+    std::vector<casadi_int> parent;
+    if (supernodal_ || max_workers_>1) {
+      parent = sp_.sub(p_, p_, tmp).etree();
+      std::vector<casadi_int> post(n), iw(3*n);
+      SparsityInternal::postorder(get_ptr(parent), n, get_ptr(post), get_ptr(iw));
+      if (post!=range(n)) {
+        std::vector<casadi_int> p(n);
+        for (casadi_int c=0; c<n; ++c) p[c] = p_[post[c]];
+        p_ = p;
         Sparsity Aperm = sp_.sub(p_, p_, tmp);
-        sp_Lt_ = triu(Aperm, false);  // no fill-in
+        sp_Lt_ = incomplete_ ? triu(Aperm, false) : Aperm.ldl(tmp, false);
+        parent = Aperm.etree();
+      }
+    }
+
+    // Length of the work vectors, the solve uses panels of four right-hand-sides
+    sz_l_ = sp_Lt_.nnz();
+    sz_w_ = 4*n;
+
+    // Detect supernodes
+    sn_.clear();
+    if (supernodal_) {
+      Sparsity L = sp_Lt_.T();
+      const casadi_int *l_colind = L.colind(), *l_row = L.row();
+      std::vector<casadi_int> sn_col(n+1);
+      casadi_int nsn = SparsityInternal::ldl_supernodes(n, get_ptr(parent), l_colind,
+                                                        get_ptr(sn_col));
+      // Only worth it if some columns could be merged
+      if (nsn<n) {
+        std::vector<casadi_int> rptr(nsn+1, 0), nzptr(nsn+1, 0), snof(n), row;
+        for (casadi_int s=0; s<nsn; ++s) {
+          casadi_int last = sn_col[s+1]-1, nc = sn_col[s+1]-sn_col[s];
+          for (casadi_int c=sn_col[s]; c<=last; ++c) snof[c] = s;
+          // Rows below the diagonal block: the sparsity pattern of the last column
+          casadi_int nb = l_colind[last+1]-l_colind[last];
+          row.insert(row.end(), l_row+l_colind[last], l_row+l_colind[last+1]);
+          rptr[s+1] = rptr[s] + nb;
+          nzptr[s+1] = nzptr[s] + nc*(nc+nb);
+          sz_w_ = std::max(sz_w_, nb*(nc+nb));
+        }
+        sz_l_ = nzptr[nsn];
+        // sn = [n, nsn, col[nsn+1], rptr[nsn+1], nzptr[nsn+1], snof[n], row[...]]
+        sn_ = {n, nsn};
+        sn_.insert(sn_.end(), sn_col.begin(), sn_col.begin()+nsn+1);
+        sn_.insert(sn_.end(), rptr.begin(), rptr.end());
+        sn_.insert(sn_.end(), nzptr.begin(), nzptr.end());
+        sn_.insert(sn_.end(), snof.begin(), snof.end());
+        sn_.insert(sn_.end(), row.begin(), row.end());
+      }
+    }
+
+    // Schedule independent subtrees of the elimination tree
+    task_ptr_.clear();
+    task_col_.clear();
+    if (max_workers_>1) {
+      // Cost of each column: the copy of A and the updates of other columns using it.
+      // The subtrees also update the entries in their rows of the top of the tree.
+      const casadi_int *lt_colind = sp_Lt_.colind(), *lt_row = sp_Lt_.row();
+      std::vector<double> cost(n);
+      for (casadi_int c=0; c<n; ++c) cost[c] = sp_.colind()[p_[c]+1] - sp_.colind()[p_[c]];
+      for (casadi_int k=0; k<sp_Lt_.nnz(); ++k) {
+        casadi_int r = lt_row[k];
+        cost[r] += 1 + lt_colind[r+1] - lt_colind[r];
+      }
+      casadi_int nsub = SparsityInternal::etree_partition(n, get_ptr(parent), get_ptr(cost),
+                                                          max_workers_, task_ptr_, task_col_);
+      if (nsub>1) {
+        max_workers_ = std::min(max_workers_, nsub);
+        sz_w_ = 4*max_workers_*n;
       } else {
-        p_ = range(sp_.size1());  // no reordering
-        sp_Lt_ = triu(sp_, false);  // no fill-in
+        // Nothing to parallelize
+        task_ptr_.clear();
+        task_col_.clear();
+        max_workers_ = 1;
       }
-    } else {
-      // Regular LDL^T
-      sp_Lt_ = sp_.ldl(p_, amd_);
     }
   }
 
+  void LinsolLdl::
+  run_subtrees(const std::function<void(const casadi_int*, casadi_int, casadi_int)>& f) const {
+    casadi_int nsub = task_ptr_.size()-1;
+    ThreadPool::instance().run(nsub, max_workers_, 1, [&](casadi_int k, casadi_int slot) {
+      f(get_ptr(task_col_) + task_ptr_[k], task_ptr_[k+1]-task_ptr_[k], slot);
+    });
+  }
+
   int LinsolLdl::init_mem(void* mem) const {
     if (LinsolInternal::init_mem(mem)) return 1;
     auto m = static_cast<LinsolLdlMemory*>(mem);
@@ -107,8 +243,10 @@ namespace casadi {
     // Work vectors
     casadi_int nrow = this->nrow();
     m->d.resize(nrow);
-    m->l.resize(sp_Lt_.nnz());
-    m->w.resize(nrow);
+    m->l.resize(sz_l_);
+    m->w.resize(sz_w_);
+    if (!sn_.empty()) m->iw.resize(2*nrow);
+    if (!task_ptr_.empty()) m->iw.resize(nrow);
 
     return 0;
   }
@@ -119,7 +257,31 @@ namespace casadi {
 
   int LinsolLdl::nfact(void* mem, const double* A) const {
     auto m = static_cast<LinsolLdlMemory*>(mem);
-    casadi_ldl(sp_, A, sp_Lt_, get_ptr(m->l), get_ptr(m->d), get_ptr(p_), get_ptr(m->w));
+    if (!task_ptr_.empty()) {
+      // Independent subtrees in parallel, one work vector per worker, then the top
+      casadi_int n = nrow();
+      double *l = get_ptr(m->l), *d = get_ptr(m->d), *w = get_ptr(m->w);
+      const casadi_int* p = get_ptr(p_);
+      const casadi_int* top = get_ptr(task_col_) + task_ptr_.back();
+      casadi_int ntop = n - task_ptr_.back();
+      casadi_clear(w, sz_w_);
+      // Entries of the top of the tree from A, mark the other columns
+      for (casadi_int i=0; i<ntop; ++i) casadi_ldl_copy(sp_, A, sp_Lt_, l, d, p, w, top[i]);
+      std::fill(m->iw.begin(), m->iw.end(), 1);
+      for (casadi_int i=0; i<ntop; ++i) m->iw[top[i]] = 0;
+      // Subtrees, including their rows of the top of the tree
+      run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+        casadi_ldl_cols(sp_, A, sp_Lt_, l, d, p, w + slot*n, cols, ncols);
+        casadi_ldl_rows(sp_Lt_, l, d, w + slot*n, top, ntop, cols[0], cols[ncols-1]+1);
+      });
+      // Remaining entries of the top of the tree
+      casadi_ldl_top(sp_Lt_, l, d, w, top, ntop, get_ptr(m->iw));
+    } else if (sn_.empty()) {
+      casadi_ldl(sp_, A, sp_Lt_, get_ptr(m->l), get_ptr(m->d), get_ptr(p_), get_ptr(m->w));
+    } else {
+      casadi_ldl_sn(sp_, A, get_ptr(sn_), get_ptr(m->l), get_ptr(m->d), get_ptr(p_),
+                    get_ptr(m->iw), get_ptr(m->w));
+    }
     for (double d : m->d) {
       if (d==0) casadi_warning("LDL factorization has zeros in D");
     }
@@ -128,7 +290,46 @@ namespace casadi {
 
   int LinsolLdl::solve(void* mem, const double* A, double* x, casadi_int nrhs, bool tr) const {
     auto m = static_cast<LinsolLdlMemory*>(mem);
-    casadi_ldl_solve(x, nrhs, sp_Lt_, get_ptr(m->l), get_ptr(m->d), get_ptr(p_), get_ptr(m->w));
+    if (!task_ptr_.empty()) {
+      casadi_int n = nrow();
+      const double *l = get_ptr(m->l), *d = get_ptr(m->d);
+      const casadi_int* p = get_ptr(p_);
+      double* w = get_ptr(m->w);
+      if (nrhs>1) {
+        // Right-hand-sides in parallel, in panels of four if there are enough of them
+        casadi_int nb = nrhs>=4*max_workers_ ? 4 : 1, ntask = (nrhs+nb-1)/nb;
+        ThreadPool::instance().run(ntask, std::min(max_workers_, ntask), 1,
+          [&](casadi_int k, casadi_int slot) {
+            casadi_ldl_solve_panel(x + k*nb*n, std::min(nb, nrhs-k*nb), sp_Lt_, l, d, p,
+                                   w + slot*4*n);
+          });
+      } else {
+        // Multiply by P
+        for (casadi_int i=0; i<n; ++i) w[i] = x[p[i]];
+        // Solve for L: subtrees before the top of the tree
+        const casadi_int* top = get_ptr(task_col_) + task_ptr_.back();
+        casadi_int ntop = n - task_ptr_.back();
+        run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+          casadi_ldl_trs_cols(sp_Lt_, l, w, 1, cols, ncols);
+        });
+        casadi_ldl_trs_cols(sp_Lt_, l, w, 1, top, ntop);
+        // Divide by D
+        for (casadi_int i=0; i<n; ++i) w[i] /= d[i];
+        // Solve for L': top of the tree before the subtrees
+        casadi_ldl_trs_cols(sp_Lt_, l, w, 0, top, ntop);
+        run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+          casadi_ldl_trs_cols(sp_Lt_, l, w, 0, cols, ncols);
+        });
+        // Multiply by P'
+        for (casadi_int i=0; i<n; ++i) x[p[i]] = w[i];
+      }
+    } else if (sn_.empty()) {
+      casadi_ldl_solve_panel(x, nrhs, sp_Lt_, get_ptr(m->l), get_ptr(m->d), get_ptr(p_),
+                             get_ptr(m->w));
+    } else {
+      casadi_ldl_sn_solve_panel(x, nrhs, get_ptr(sn_), get_ptr(m->l), get_ptr(m->d),
+                                get_ptr(p_), get_ptr(m->w));
+    }
     return 0;
   }
 
@@ -154,37 +355,71 @@ namespace casadi {
                           casadi_int nrhs, bool tr) const {
     // Codegen the integer vectors
     string sp = g.sparsity(sp_);
-    string sp_Lt = g.sparsity(sp_Lt_);
     string p = g.constant(p_);
 
     // Place in block to avoid conflicts caused by local variables
     g << "{\n";
     g.comment("FIXME(@jaeandersson): Memory allocation can be avoided");
-    g << "casadi_real lt[" << sp_Lt_.nnz() << "], "
-         "d[" << nrow() << "], "
-         "w[" << nrow() << "];\n";
+    if (sn_.empty()) {
+      string sp_Lt = g.sparsity(sp_Lt_);
+      g << "casadi_real lt[" << sp_Lt_.nnz() << "], "
+           "d[" << nrow() << "], "
+           "w[" << (nrhs>=4 ? 4 : 1)*nrow() << "];\n";
 
-    // Factorize
-    g << g.ldl(sp, A, sp_Lt, "lt", "d", p, "w") << "\n";
+      // Factorize
+      g << g.ldl(sp, A, sp_Lt, "lt", "d", p, "w") << "\n";
 
-    // Solve
-    g << g.ldl_solve(x, nrhs, sp_Lt, "lt", "d", p, "w") << "\n";
+      // Solve
+      if (nrhs>=4) {
+        g << g.ldl_solve_panel(x, nrhs, sp_Lt, "lt", "d", p, "w") << "\n";
+      } else {
+        g << g.ldl_solve(x, nrhs, sp_Lt, "lt", "d", p, "w") << "\n";
+      }
+    } else {
+      string sn = g.constant(sn_);
+      g << "casadi_real l[" << sz_l_ << "], "
+           "d[" << nrow() << "], "
+           "w[" << sz_w_ << "];\n";
+      g << "casadi_int iw[" << 2*nrow() << "];\n";
+
+      // Factorize
+      g << g.ldl_sn(sp, A, sn, "l", "d", p, "iw", "w") << "\n";
+
+      // Solve
+      if (nrhs>=4) {
+        g << g.ldl_sn_solve_panel(x, nrhs, sn, "l", "d", p, "w") << "\n";
+      } else {
+        g << g.ldl_sn_solve(x, nrhs, sn, "l", "d", p, "w") << "\n";
+      }
+    }
 
     // End of block
     g << "}\n";
   }
 
   LinsolLdl::LinsolLdl(DeserializingStream& s) : LinsolInternal(s) {
-    s.version("LinsolLdl", 1);
+    s.version("LinsolLdl", 3);
     s.unpack("LinsolLdl::p", p_);
     s.unpack("LinsolLdl::sp_Lt", sp_Lt_);
+    s.unpack("LinsolLdl::sn", sn_);
+    s.unpack("LinsolLdl::sz_l", sz_l_);
+    s.unpack("LinsolLdl::sz_w", sz_w_);
+    s.unpack("LinsolLdl::task_ptr", task_ptr_);
+    s.unpack("LinsolLdl::task_col", task_col_);
+    s.unpack("LinsolLdl::max_workers", max_workers_);
   }
 
   void LinsolLdl::serialize_body(SerializingStream &s) const {
     LinsolInternal::serialize_body(s);
-    s.version("LinsolLdl", 1);
+    s.version("LinsolLdl", 3);
     s.pack("LinsolLdl::p", p_);
     s.pack("LinsolLdl::sp_Lt", sp_Lt_);
+    s.pack("LinsolLdl::sn", sn_);
+    s.pack("LinsolLdl::sz_l", sz_l_);
+    s.pack("LinsolLdl::sz_w", sz_w_);
+    s.pack("LinsolLdl::task_ptr", task_ptr_);
+    s.pack("LinsolLdl::task_col", task_col_);
+    s.pack("LinsolLdl::max_workers", max_workers_);
   }
 
 } // namespace casadi
@@ -35,10 +35,12 @@
 /// \cond INTERNAL
 #include "casadi/core/linsol_internal.hpp"
 #include <casadi/solvers/casadi_linsol_ldl_export.h>
+#include <functional>
 
 namespace casadi {
   struct CASADI_LINSOL_LDL_EXPORT LinsolLdlMemory : public LinsolMemory {
     std::vector<double> l, d, w;
+    std::vector<casadi_int> iw;
   };
 
   /** \brief \pluginbrief{LinsolInternal,ldl}
@@ -109,11 +111,26 @@ namespace casadi {
     std::vector<casadi_int> p_;
     Sparsity sp_Lt_;
 
+    // Supernodes, empty if the factorization is not supernodal
+    std::vector<casadi_int> sn_;
+
+    // Length of the work vectors
+    casadi_int sz_l_, sz_w_;
+
+    // Independent subtrees of the elimination tree, empty if sequential
+    std::vector<casadi_int> task_ptr_, task_col_;
+
     ///@{
     // Options
-    bool incomplete_, amd_;
+    bool incomplete_, supernodal_;
+    std::string preordering_;
+    casadi_int max_workers_;
     ///@}
 
+    /// Evaluate f(cols, ncols, slot) for each independent subtree, in parallel
+    void run_subtrees(const std::function<void(const casadi_int*, casadi_int, casadi_int)>& f)
+      const;
+
     /** \brief Serialize an object without type information */
     void serialize_body(SerializingStream &s) const override;
 
@@ -25,6 +25,8 @@
 
 #include "linsol_qr.hpp"
 #include "casadi/core/global_options.hpp"
+#include "casadi/core/sparsity_internal.hpp"
+#include "casadi/core/thread_pool.hpp"
 
 using namespace std;
 namespace casadi {
@@ -58,7 +60,16 @@ namespace casadi {
   = {{&LinsolInternal::options_},
      {{"eps",
        {OT_DOUBLE,
-        "Minimum R entry before singularity is declared [1e-12]"}}
+        "Minimum R entry before singularity is declared [1e-12]"}},
+      {"ordering",
+       {OT_STRING,
+        "Fill-reducing column preordering, applied to A'*A: 'amd' (approximate "
+        "minimal degree), 'nd' (nested dissection) or 'none' [default: 'amd']"}},
+      {"max_workers",
+       {OT_INT,
+        "Maximum number of concurrent workers, including the calling thread, "
+        "for factorizing and solving independent subtrees of the column elimination "
+        "tree. Generated code is always sequential [default: 1]"}}
      }
   };
 
@@ -68,14 +79,70 @@ namespace casadi {
 
     // Read options
     eps_ = 1e-12;
+    max_workers_ = 1;
+    std::string preordering = "amd";
     for (auto&& op : opts) {
       if (op.first=="eps") {
         eps_ = op.second;
+      } else if (op.first=="ordering") {
+        preordering = op.second.to_string();
+      } else if (op.first=="max_workers") {
+        max_workers_ = op.second;
       }
     }
+    casadi_assert(max_workers_>=1, "Option 'max_workers' must be positive");
+
+    // Fill-reducing column preordering
+    if (preordering=="amd") {
+      pc_ = mtimes(sp_.T(), sp_).amd();
+    } else if (preordering=="nd") {
+      pc_ = mtimes(sp_.T(), sp_).nd();
+    } else {
+      casadi_assert(preordering=="none", "Unknown ordering '" + preordering + "', "
+                    "expected 'amd', 'nd' or 'none'");
+      pc_ = range(ncol());
+    }
 
     // Symbolic factorization
-    sp_.qr_sparse(sp_v_, sp_r_, prinv_, pc_);
+    std::vector<casadi_int> tmp;
+    sp_.sub(range(nrow()), pc_, tmp).qr_sparse(sp_v_, sp_r_, prinv_, tmp, false);
+
+    // Schedule independent subtrees of the column elimination tree
+    task_ptr_.clear();
+    task_col_.clear();
+    if (max_workers_>1) {
+      casadi_int n = ncol();
+      std::vector<casadi_int> parent = sp_.sub(range(nrow()), pc_, tmp).etree(true);
+      // Cost of each column: the Householder reflections applied and formed
+      const casadi_int *v_colind = sp_v_.colind(), *r_colind = sp_r_.colind(),
+                       *r_row = sp_r_.row();
+      std::vector<double> cost(n);
+      for (casadi_int c=0; c<n; ++c) {
+        cost[c] = 2*(v_colind[c+1] - v_colind[c]);
+        for (casadi_int k=r_colind[c]; k<r_colind[c+1]; ++k) {
+          casadi_int r = r_row[k];
+          if (r<c) cost[c] += 1 + 2*(v_colind[r+1] - v_colind[r]);
+        }
+      }
+      casadi_int nsub = SparsityInternal::etree_partition(n, get_ptr(parent), get_ptr(cost),
+                                                          max_workers_, task_ptr_, task_col_);
+      if (nsub>1) {
+        max_workers_ = std::min(max_workers_, nsub);
+      } else {
+        // Nothing to parallelize
+        task_ptr_.clear();
+        task_col_.clear();
+        max_workers_ = 1;
+      }
+    }
+  }
+
+  void LinsolQr::
+  run_subtrees(const std::function<void(const casadi_int*, casadi_int, casadi_int)>& f) const {
+    casadi_int nsub = task_ptr_.size()-1;
+    ThreadPool::instance().run(nsub, max_workers_, 1, [&](casadi_int k, casadi_int slot) {
+      f(get_ptr(task_col_) + task_ptr_[k], task_ptr_[k+1]-task_ptr_[k], slot);
+    });
   }
 
   int LinsolQr::init_mem(void* mem) const {
@@ -86,7 +153,8 @@ namespace casadi {
     m->v.resize(sp_v_.nnz());
     m->r.resize(sp_r_.nnz());
     m->beta.resize(ncol());
-    m->w.resize(nrow() + ncol());
+    // Work vector, the solve uses panels of four right-hand-sides
+    m->w.resize(4*max_workers_*(nrow() + ncol()));
     return 0;
   }
 
@@ -96,9 +164,23 @@ namespace casadi {
 
   int LinsolQr::nfact(void* mem, const double* A) const {
     auto m = static_cast<LinsolQrMemory*>(mem);
-    casadi_qr(sp_, A, get_ptr(m->w),
-              sp_v_, get_ptr(m->v), sp_r_, get_ptr(m->r),
-              get_ptr(m->beta), get_ptr(prinv_), get_ptr(pc_));
+    if (task_ptr_.empty()) {
+      casadi_qr(sp_, A, get_ptr(m->w),
+                sp_v_, get_ptr(m->v), sp_r_, get_ptr(m->r),
+                get_ptr(m->beta), get_ptr(prinv_), get_ptr(pc_));
+    } else {
+      // Independent subtrees in parallel, one work vector per worker, then the top
+      casadi_int sz_w = nrow() + ncol();
+      double *w = get_ptr(m->w), *v = get_ptr(m->v), *r = get_ptr(m->r),
+             *beta = get_ptr(m->beta);
+      casadi_clear(w, m->w.size());
+      run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+        casadi_qr_cols(sp_, A, w + slot*sz_w, sp_v_, v, sp_r_, r, beta,
+                       get_ptr(prinv_), get_ptr(pc_), cols, ncols);
+      });
+      casadi_qr_cols(sp_, A, w, sp_v_, v, sp_r_, r, beta, get_ptr(prinv_), get_ptr(pc_),
+                     get_ptr(task_col_) + task_ptr_.back(), ncol() - task_ptr_.back());
+    }
     // Check singularity
     double rmin;
     casadi_int irmin, nullity;
@@ -120,9 +202,58 @@ namespace casadi {
 
   int LinsolQr::solve(void* mem, const double* A, double* x, casadi_int nrhs, bool tr) const {
     auto m = static_cast<LinsolQrMemory*>(mem);
-    casadi_qr_solve(x, nrhs, tr,
-                    sp_v_, get_ptr(m->v), sp_r_, get_ptr(m->r),
-                    get_ptr(m->beta), get_ptr(prinv_), get_ptr(pc_), get_ptr(m->w));
+    const double *v = get_ptr(m->v), *r = get_ptr(m->r), *beta = get_ptr(m->beta);
+    const casadi_int *prinv = get_ptr(prinv_), *pc = get_ptr(pc_);
+    double* w = get_ptr(m->w);
+    if (task_ptr_.empty()) {
+      casadi_qr_solve_panel(x, nrhs, tr, sp_v_, v, sp_r_, r, beta, prinv, pc, w);
+    } else if (nrhs>1) {
+      // Right-hand-sides in parallel, in panels of four if there are enough of them
+      casadi_int n = ncol(), sz_w = 4*(nrow() + ncol());
+      casadi_int nb = nrhs>=4*max_workers_ ? 4 : 1, ntask = (nrhs+nb-1)/nb;
+      ThreadPool::instance().run(ntask, std::min(max_workers_, ntask), 1,
+        [&](casadi_int k, casadi_int slot) {
+          casadi_qr_solve_panel(x + k*nb*n, std::min(nb, nrhs-k*nb), tr, sp_v_, v, sp_r_, r,
+                                beta, prinv, pc, w + slot*sz_w);
+        });
+    } else {
+      // Forward sweeps: subtrees before the top of the tree, backward sweeps: vice versa
+      casadi_int n = ncol(), nrow_ext = sp_v_.size1();
+      const casadi_int* top = get_ptr(task_col_) + task_ptr_.back();
+      casadi_int ntop = n - task_ptr_.back();
+      if (tr) {
+        // Multiply by PC
+        for (casadi_int c=0; c<n; ++c) w[c] = x[pc[c]];
+        //  Solve for R'
+        run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+          casadi_qr_trs_cols(sp_r_, r, w, 1, cols, ncols);
+        });
+        casadi_qr_trs_cols(sp_r_, r, w, 1, top, ntop);
+        // Multiply by Q
+        casadi_qr_mv_cols(sp_v_, v, beta, w, 0, top, ntop);
+        run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+          casadi_qr_mv_cols(sp_v_, v, beta, w, 0, cols, ncols);
+        });
+        // Multiply by PR'
+        for (casadi_int c=0; c<n; ++c) x[c] = w[prinv[c]];
+      } else {
+        // Multiply with PR
+        for (casadi_int c=0; c<nrow_ext; ++c) w[c] = 0;
+        for (casadi_int c=0; c<n; ++c) w[prinv[c]] = x[c];
+        // Multiply with Q'
+        run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+          casadi_qr_mv_cols(sp_v_, v, beta, w, 1, cols, ncols);
+        });
+        casadi_qr_mv_cols(sp_v_, v, beta, w, 1, top, ntop);
+        //  Solve for R
+        casadi_qr_trs_cols(sp_r_, r, w, 0, top, ntop);
+        run_subtrees([&](const casadi_int* cols, casadi_int ncols, casadi_int slot) {
+          casadi_qr_trs_cols(sp_r_, r, w, 0, cols, ncols);
+        });
+        // Multiply with PC'
+        for (casadi_int c=0; c<n; ++c) x[pc[c]] = w[c];
+      }
+    }
     return 0;
   }
 
@@ -141,35 +272,45 @@ namespace casadi {
     g << "casadi_real v[" << sp_v_.nnz() << "], "
          "r[" << sp_r_.nnz() << "], "
          "beta[" << ncol() << "], "
-         "w[" << nrow() + ncol() << "];\n";
+         "w[" << (nrhs>=4 ? 4 : 1)*(nrow() + ncol()) << "];\n";
 
     // Factorize
     g << g.qr(sp, A, "w", sp_v, "v", sp_r, "r", "beta", prinv, pc) << "\n";
 
     // Solve
-    g << g.qr_solve(x, nrhs, tr, sp_v, "v", sp_r, "r", "beta", prinv, pc, "w") << "\n";
+    if (nrhs>=4) {
+      g << g.qr_solve_panel(x, nrhs, tr, sp_v, "v", sp_r, "r", "beta", prinv, pc, "w") << "\n";
+    } else {
+      g << g.qr_solve(x, nrhs, tr, sp_v, "v", sp_r, "r", "beta", prinv, pc, "w") << "\n";
+    }
 
     // End of block
     g << "}\n";
   }
 
   LinsolQr::LinsolQr(DeserializingStream& s) : LinsolInternal(s) {
-    s.version("LinsolQr", 1);
+    s.version("LinsolQr", 2);
     s.unpack("LinsolQr::prinv", prinv_);
     s.unpack("LinsolQr::pc", pc_);
     s.unpack("LinsolQr::sp_v", sp_v_);
     s.unpack("LinsolQr::sp_r", sp_r_);
     s.unpack("LinsolQr::eps", eps_);
+    s.unpack("LinsolQr::task_ptr", task_ptr_);
+    s.unpack("LinsolQr::task_col", task_col_);
+    s.unpack("LinsolQr::max_workers", max_workers_);
   }
 
   void LinsolQr::serialize_body(SerializingStream &s) const {
     LinsolInternal::serialize_body(s);
-    s.version("LinsolQr", 1);
+    s.version("LinsolQr", 2);
     s.pack("LinsolQr::prinv", prinv_);
     s.pack("LinsolQr::pc", pc_);
     s.pack("LinsolQr::sp_v", sp_v_);
     s.pack("LinsolQr::sp_r", sp_r_);
     s.pack("LinsolQr::eps", eps_);
+    s.pack("LinsolQr::task_ptr", task_ptr_);
+    s.pack("LinsolQr::task_col", task_col_);
+    s.pack("LinsolQr::max_workers", max_workers_);
   }
 
 } // namespace casadi
@@ -35,6 +35,7 @@
 /// \cond INTERNAL
 #include "casadi/core/linsol_internal.hpp"
 #include <casadi/solvers/casadi_linsol_qr_export.h>
+#include <functional>
 
 namespace casadi {
   struct CASADI_LINSOL_QR_EXPORT LinsolQrMemory : public LinsolMemory {
@@ -104,6 +105,14 @@ namespace casadi {
     Sparsity sp_v_, sp_r_;
     double eps_;
 
+    // Independent subtrees of the column elimination tree, empty if sequential
+    std::vector<casadi_int> task_ptr_, task_col_;
+    casadi_int max_workers_;
+
+    /// Evaluate f(cols, ncols, slot) for each independent subtree, in parallel
+    void run_subtrees(const std::function<void(const casadi_int*, casadi_int, casadi_int)>& f)
+      const;
+
     /** \brief Serialize an object without type information */
     void serialize_body(SerializingStream &s) const override;
 
@@ -27,6 +27,7 @@
 #include "casadi/core/casadi_misc.hpp"
 #include "casadi/core/casadi_meta.hpp"
 #include "casadi/core/casadi_logger.hpp"
+#include "casadi/core/thread_pool.hpp"
 #include <fstream>
 
 // Set default object file suffix
@@ -35,10 +36,165 @@
 #endif // OBJECT_FILE_SUFFIX
 
 #include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cctype>
+#include <iomanip>
+#include <tuple>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <sys/utime.h>
+#else // _WIN32
+#include <dirent.h>
+#include <utime.h>
+#endif // _WIN32
 
 using namespace std;
 namespace casadi {
 
+  namespace {
+    // Process-wide statistics of the library cache
+    std::atomic<casadi_int> cache_hits(0), cache_misses(0), cache_evictions(0);
+
+    // Length of a cache key in hexadecimal digits
+    const size_t cache_key_len = 32;
+
+    // 128-bit content hash, as two independent 64-bit FNV-1a style streams
+    std::string cache_key(const std::string& s) {
+      uint64_t h1 = 14695981039346656037ULL, h2 = 0x9e3779b97f4a7c15ULL;
+      for (unsigned char c : s) {
+        h1 = (h1 ^ c) * 1099511628211ULL;
+        h2 = (h2 ^ c) * 0xff51afd7ed558ccdULL;
+        h2 ^= h2 >> 29;
+      }
+      h1 ^= s.size();
+      h2 ^= s.size();
+      std::stringstream ss;
+      ss << std::hex << std::setfill('0') << std::setw(16) << h1 << std::setw(16) << h2;
+      return ss.str();
+    }
+
+    // Read a file into a string
+    std::string read_file(const std::string& fname) {
+      std::ifstream f(fname, std::ios::binary);
+      casadi_assert(f.good(), "Cannot open '" + fname + "'.");
+      std::stringstream ss;
+      ss << f.rdbuf();
+      return ss.str();
+    }
+
+    // Size and modification time of a file, false if it does not exist
+    bool file_stat(const std::string& fname, casadi_int& size, time_t& mtime) {
+#ifdef _WIN32
+      struct _stat st;
+      if (_stat(fname.c_str(), &st)) return false;
+#else // _WIN32
+      struct stat st;
+      if (stat(fname.c_str(), &st)) return false;
+#endif // _WIN32
+      size = st.st_size;
+      mtime = st.st_mtime;
+      return true;
+    }
+
+    // Mark a cache entry as recently used
+    void touch(const std::string& fname) {
+#ifdef _WIN32
+      _utime(fname.c_str(), nullptr);
+#else // _WIN32
+      utime(fname.c_str(), nullptr);
+#endif // _WIN32
+    }
+
+    // Create a directory unless it exists
+    void make_dir(const std::string& dir) {
+      casadi_int size;
+      time_t mtime;
+      if (file_stat(dir, size, mtime)) return;
+#ifdef _WIN32
+      int flag = _mkdir(dir.c_str());
+#else // _WIN32
+      int flag = mkdir(dir.c_str(), 0777);
+#endif // _WIN32
+      // Another process may have created it in the meantime
+      casadi_assert(flag==0 || file_stat(dir, size, mtime),
+        "Cannot create cache directory '" + dir + "'.");
+    }
+
+    // File names in a directory
+    std::vector<std::string> list_dir(const std::string& dir) {
+      std::vector<std::string> ret;
+#ifdef _WIN32
+      WIN32_FIND_DATAA fd;
+      HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &fd);
+      if (h==INVALID_HANDLE_VALUE) return ret;
+      do {
+        ret.push_back(fd.cFileName);
+      } while (FindNextFileA(h, &fd));
+      FindClose(h);
+#else // _WIN32
+      DIR* d = opendir(dir.c_str());
+      if (d==nullptr) return ret;
+      while (struct dirent* e = readdir(d)) ret.push_back(e->d_name);
+      closedir(d);
+#endif // _WIN32
+      return ret;
+    }
+
+    // Is the file name a complete cache entry (temporaries are not)?
+    bool is_cache_entry(const std::string& fname) {
+      std::string suffix = SHARED_LIBRARY_SUFFIX;
+      if (fname.size()!=cache_key_len+suffix.size()) return false;
+      if (fname.compare(cache_key_len, suffix.size(), suffix)) return false;
+      for (size_t i=0; i<cache_key_len; ++i) {
+        if (!isxdigit(static_cast<unsigned char>(fname[i]))) return false;
+      }
+      return true;
+    }
+
+    // Remove least recently used entries until the cache fits in max_size bytes
+    void cache_evict(const std::string& dir, casadi_int max_size, const std::string& keep) {
+      // Entries by modification time, size and file name
+      std::vector<std::tuple<time_t, casadi_int, std::string> > entries;
+      casadi_int total = 0;
+      for (const std::string& e : list_dir(dir)) {
+        if (!is_cache_entry(e)) continue;
+        casadi_int size;
+        time_t mtime;
+        if (!file_stat(dir + "/" + e, size, mtime)) continue;
+        entries.emplace_back(mtime, size, e);
+        total += size;
+      }
+      if (total<=max_size) return;
+      std::sort(entries.begin(), entries.end());
+      for (auto&& e : entries) {
+        if (total<=max_size) break;
+        if (std::get<2>(e)==keep) continue;
+        // Libraries mapped by other processes remain valid after unlinking on POSIX,
+        // on Windows removal of a loaded library fails and the entry is kept
+        std::string fname = dir + "/" + std::get<2>(e);
+        if (remove(fname.c_str())==0) {
+          total -= std::get<1>(e);
+          cache_evictions++;
+        }
+      }
+    }
+
+    // Load a shared library
+    DL_HANDLE_TYPE open_library(const std::string& bin_name) {
+#ifdef _WIN32
+      DL_HANDLE_TYPE handle = LoadLibrary(TEXT(bin_name.c_str()));
+      SetDllDirectory(NULL);
+#else // _WIN32
+      DL_HANDLE_TYPE handle = dlopen(bin_name.c_str(), RTLD_LAZY);
+#endif // _WIN32
+      return handle;
+    }
+  } // namespace
+
   extern "C"
   int CASADI_IMPORTER_SHELL_EXPORT
   casadi_register_importer_shell(ImporterInternal::Plugin* plugin) {
@@ -58,6 +214,7 @@ namespace casadi {
   ShellCompiler::ShellCompiler(const std::string& name) :
     ImporterInternal(name) {
       handle_ = nullptr;
+      cache_hit_ = false;
   }
 
   ShellCompiler::~ShellCompiler() {
@@ -68,9 +225,13 @@ namespace casadi {
     if (handle_) dlclose(handle_);
 #endif // _WIN32
 
-    if (cleanup_) {
+    // Cache entries outlive the instance, intermediate files are already removed
+    if (cleanup_ && cache_dir_.empty()) {
       if (remove(bin_name_.c_str())) casadi_warning("Failed to remove " + bin_name_);
       if (remove(obj_name_.c_str())) casadi_warning("Failed to remove " + obj_name_);
+      for (const std::string& s : extra_obj_names_) {
+        if (remove(s.c_str())) casadi_warning("Failed to remove " + s);
+      }
       for (const std::string& s : extra_suffixes_) {
         std::string name = base_name_+s;
         remove(name.c_str());
@@ -131,6 +292,21 @@ namespace casadi {
         "This is desired for thread-safety. "
         "This behaviour may defeat caching compiler wrappers. "
         "Default: true"}},
+      {"jobs",
+       {OT_INT,
+        "Maximum number of source files compiled concurrently, when the source lists "
+        "additional files (e.g. functions split by the code generator). "
+        "Default: size of the CasADi thread pool"}},
+      {"cache_dir",
+       {OT_STRING,
+        "Directory of a persistent cache of compiled libraries, keyed by a hash of the "
+        "source, the compiler and the flags. Identical sources load the cached library "
+        "instead of being recompiled. The cache may be shared between processes. "
+        "Default: '' (disabled)"}},
+      {"cache_max_size",
+       {OT_INT,
+        "Maximum total size in bytes of the cache directory. "
+        "Least recently used entries are evicted. Default: 0 (unbounded)"}},
      }
   };
 
@@ -141,6 +317,9 @@ namespace casadi {
     // Default options
 
     cleanup_ = true;
+    cache_dir_ = "";
+    cache_max_size_ = 0;
+    casadi_int jobs = ThreadPool::target_size() + 1;
     bool temp_suffix = true;
     std::string bare_name = "tmp_casadi_compiler_shell";
 
@@ -191,9 +370,70 @@ namespace casadi {
         bare_name = op.second.to_string();
       } else if (op.first=="temp_suffix") {
         temp_suffix = op.second;
+      } else if (op.first=="cache_dir") {
+        cache_dir_ = op.second.to_string();
+      } else if (op.first=="cache_max_size") {
+        cache_max_size_ = op.second;
+      } else if (op.first=="jobs") {
+        jobs = op.second;
+      }
+    }
+
+    // Source files: the main file and any additional files listed in it,
+    // given as suffixes to its name without extension
+    std::vector<std::string> sources = {name_};
+    if (has_meta("source_suffixes")) {
+      std::string base = name_.substr(0, name_.find_last_of('.'));
+      for (auto&& f : text2vector<std::string>(get_meta("source_suffixes"))) {
+        sources.push_back(base + f);
       }
     }
 
+    // Compiler and linker commands, without file names
+    stringstream ccbase;
+    ccbase << compiler;
+    for (auto&& f : compiler_flags) ccbase << " " << f;
+    ccbase << " " << compiler_setup;
+    stringstream ldflags;
+    for (auto&& f : linker_flags) ldflags << " " << f;
+    ldflags << " " << linker_setup;
+
+    // Library in the persistent cache, if any
+    std::string cache_entry, cache_name;
+    if (!cache_dir_.empty()) {
+      make_dir(cache_dir_);
+      // Everything that affects the binary
+      std::string key = cache_key(std::string(CasadiMeta::version()) + "\n"
+        + ccbase.str() + "\n" + compiler_output_flag + "\n"
+        + linker + ldflags.str() + "\n" + linker_output_flag);
+      for (auto&& f : sources) key = cache_key(key + "\n" + read_file(f));
+      cache_entry = key + SHARED_LIBRARY_SUFFIX;
+      cache_name = cache_dir_ + "/" + cache_entry;
+#ifndef _WIN32
+      if (cache_name.at(0)!='/') cache_name = "./" + cache_name;
+#endif // _WIN32
+
+      // Try to load an existing entry, it may have been evicted concurrently
+      casadi_int size;
+      time_t mtime;
+      if (file_stat(cache_name, size, mtime)) {
+        touch(cache_name);
+        handle_ = open_library(cache_name);
+        if (handle_) {
+          if (verbose_) casadi_message("loaded \"" + cache_name + "\" from cache");
+          bin_name_ = cache_name;
+          cache_hit_ = true;
+          cache_hits++;
+          return;
+        }
+      }
+      cache_misses++;
+
+      // Intermediate files next to the entry, so that the final rename is atomic
+      bare_name = cache_dir_ + "/" + key + "_";
+      temp_suffix = true;
+    }
+
     // Name of temporary file
     if (temp_suffix) {
       obj_name_ = temporary_file(bare_name, suffix);
@@ -214,24 +454,37 @@ namespace casadi {
     }
 #endif // _WIN32
 
-    // Construct the compiler command
-    stringstream cccmd;
-    cccmd << compiler;
-    for (vector<string>::const_iterator i=compiler_flags.begin(); i!=compiler_flags.end(); ++i) {
-      cccmd << " " << *i;
+    // Object files of the additional sources
+    for (casadi_int k=1; k<sources.size(); ++k) {
+      extra_obj_names_.push_back(base_name_ + "_" + str(k) + suffix);
+#ifndef _WIN32
+      if (extra_obj_names_.back().at(0)!='/') {
+        extra_obj_names_.back() = "./" + extra_obj_names_.back();
+      }
+#endif // _WIN32
     }
-    cccmd << " " << compiler_setup;
 
-    // C/C++ source file
-    cccmd << " " << name_;
+    // Construct the compiler commands
+    std::vector<std::string> cccmd;
+    for (casadi_int k=0; k<sources.size(); ++k) {
+      stringstream ss;
+      ss << ccbase.str();
 
-    // Temporary object file
-    cccmd << " " + compiler_output_flag << obj_name_;
+      // C/C++ source file
+      ss << " " << sources[k];
+
+      // Temporary object file
+      ss << " " + compiler_output_flag << (k==0 ? obj_name_ : extra_obj_names_[k-1]);
+      cccmd.push_back(ss.str());
+      if (verbose_) casadi_message("calling \"" + cccmd.back() + "\"");
+    }
 
-    // Compile into an object
-    if (verbose_) casadi_message("calling \"" + cccmd.str() + "\"");
-    if (system(cccmd.str().c_str())) {
-      casadi_error("Compilation failed. Tried \"" + cccmd.str() + "\"");
+    // Compile into objects, independent sources in parallel
+    std::vector<int> cc_flag(cccmd.size());
+    ThreadPool::instance().run(cccmd.size(), jobs, 1,
+      [&](casadi_int k, casadi_int slot) { cc_flag[k] = system(cccmd[k].c_str());});
+    for (casadi_int k=0; k<cccmd.size(); ++k) {
+      if (cc_flag[k]) casadi_error("Compilation failed. Tried \"" + cccmd[k] + "\"");
     }
 
     // Link step
@@ -239,13 +492,12 @@ namespace casadi {
     ldcmd << linker;
 
     // Temporary file
-    ldcmd << " " << obj_name_ << " " + linker_output_flag + bin_name_;
+    ldcmd << " " << obj_name_;
+    for (auto&& f : extra_obj_names_) ldcmd << " " << f;
+    ldcmd << " " + linker_output_flag + bin_name_;
 
     // Add flags
-    for (vector<string>::const_iterator i=linker_flags.begin(); i!=linker_flags.end(); ++i) {
-      ldcmd << " " << *i;
-    }
-    ldcmd << " " << linker_setup;
+    ldcmd << ldflags.str();
 
     // Compile into a shared library
     if (verbose_) casadi_message("calling \"" + ldcmd.str() + "\"");
@@ -253,12 +505,28 @@ namespace casadi {
       casadi_error("Linking failed. Tried \"" + ldcmd.str() + "\"");
     }
 
-#ifdef _WIN32
-    handle_ = LoadLibrary(TEXT(bin_name_.c_str()));
-    SetDllDirectory(NULL);
-#else // _WIN32
-    handle_ = dlopen(bin_name_.c_str(), RTLD_LAZY);
-#endif // _WIN32
+    // Publish the library in the cache
+    if (!cache_name.empty()) {
+      remove(obj_name_.c_str());
+      for (const std::string& s : extra_obj_names_) remove(s.c_str());
+      for (const std::string& s : extra_suffixes_) {
+        std::string name = base_name_+s;
+        remove(name.c_str());
+      }
+      // Atomic on POSIX: concurrent readers see either no entry or a complete one
+      if (rename(bin_name_.c_str(), cache_name.c_str())) {
+        // On Windows, fails if another process published the same entry first
+        casadi_int size;
+        time_t mtime;
+        casadi_assert(file_stat(cache_name, size, mtime),
+          "Cannot move \"" + bin_name_ + "\" to \"" + cache_name + "\"");
+        remove(bin_name_.c_str());
+      }
+      bin_name_ = cache_name;
+      if (cache_max_size_>0) cache_evict(cache_dir_, cache_max_size_, cache_entry);
+    }
+
+    handle_ = open_library(bin_name_);
 
 #ifdef _WIN32
     casadi_assert(handle_!=0,
@@ -271,6 +539,15 @@ namespace casadi {
 #endif // _WIN32
   }
 
+  Dict ShellCompiler::get_stats() const {
+    Dict stats;
+    stats["cache_hit"] = cache_hit_;
+    stats["cache_hits"] = static_cast<casadi_int>(cache_hits);
+    stats["cache_misses"] = static_cast<casadi_int>(cache_misses);
+    stats["cache_evictions"] = static_cast<casadi_int>(cache_evictions);
+    return stats;
+  }
+
   signal_t ShellCompiler::get_function(const std::string& symname) {
 #ifdef _WIN32
     return (signal_t)GetProcAddress(handle_, TEXT(symname.c_str()));
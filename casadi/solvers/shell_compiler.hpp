@@ -81,6 +81,9 @@ namespace casadi {
 
     /// Get a function pointer for numerical evaluation
     signal_t get_function(const std::string& symname) override;
+
+    /// Get cache statistics
+    Dict get_stats() const override;
   protected:
     std::string base_name_;
 
@@ -90,12 +93,24 @@ namespace casadi {
     /// Temporary file
     std::string obj_name_;
 
+    /// Temporary object files of additional sources
+    std::vector<std::string> extra_obj_names_;
+
     /// Extra files
     std::vector<std::string> extra_suffixes_;
 
     /// Cleanup temporary files when unloading
     bool cleanup_;
 
+    /// Directory of the persistent library cache, empty if disabled
+    std::string cache_dir_;
+
+    /// Maximum total size of the cache directory in bytes, nonpositive if unbounded
+    casadi_int cache_max_size_;
+
+    /// Was the library loaded from the cache?
+    bool cache_hit_;
+
     // Shared library handle
     typedef DL_HANDLE_TYPE handle_t;
     handle_t handle_;
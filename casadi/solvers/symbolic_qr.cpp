@@ -58,7 +58,7 @@ namespace casadi {
   }
 
   const Options SymbolicQr::options_
-  = {{&FunctionInternal::options_},
+  = {{&FunctionInternal::options_, &LinsolInternal::options_},
     {{"fopts",
       {OT_DICT,
        "Options to be passed to generated function objects"}}
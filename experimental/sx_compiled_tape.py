@@ -0,0 +1,49 @@
+#
+#     This file is part of CasADi.
+#
+#     CasADi -- A symbolic framework for dynamic optimization.
+#     Copyright (C) 2010-2014 Joel Andersson, Joris Gillis, Moritz Diehl,
+#                             K.U. Leuven. All rights reserved.
+#     Copyright (C) 2011-2014 Greg Horn
+#
+#     CasADi is free software; you can redistribute it and/or
+#     modify it under the terms of the GNU Lesser General Public
+#     License as published by the Free Software Foundation; either
+#     version 3 of the License, or (at your option) any later version.
+#
+#     CasADi is distributed in the hope that it will be useful,
+#     but WITHOUT ANY WARRANTY; without even the implied warranty of
+#     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+#     Lesser General Public License for more details.
+#
+#     You should have received a copy of the GNU Lesser General Public
+#     License along with CasADi; if not, write to the Free Software
+#     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+#
+#
+# -*- coding: utf-8 -*-
+from casadi import *
+import time
+
+# Compares the default SXFunction virtual machine with the "compiled_tape" evaluation mode
+
+n = 20000
+x = SX.sym('x', n)
+a = SX.sym('a')
+s = 0
+r = []
+for i in range(n-2):
+  s = s + x[i]*x[i+1] - sin(x[i+2])*a
+  r.append(s*s + 2*x[i])
+r = vertcat(*r)
+
+# Evaluate in a loop, without Python overhead
+N = 500
+x0 = DM.rand(n)
+for compiled_tape in [False, True]:
+  f = Function('f', [x, a], [r], {"compiled_tape": compiled_tape})
+  fm = f.map(N, "serial")
+  t0 = time.time()
+  fm(repmat(x0, 1, N), 0.7)
+  t = (time.time()-t0)/N
+  print("compiled_tape=%s: %d instructions, %g us per call" % (compiled_tape, f.n_instructions(), t*1e6))
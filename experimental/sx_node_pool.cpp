@@ -0,0 +1,73 @@
+/*
+ *    This file is part of CasADi.
+ *
+ *    CasADi -- A symbolic framework for dynamic optimization.
+ *    Copyright (C) 2010-2014 Joel Andersson, Joris Gillis, Moritz Diehl,
+ *                            K.U. Leuven. All rights reserved.
+ *    Copyright (C) 2011-2014 Greg Horn
+ *
+ *    CasADi is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 3 of the License, or (at your option) any later version.
+ *
+ *    CasADi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with CasADi; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <casadi/casadi.hpp>
+#include <casadi/core/sx_node_pool.hpp>
+
+#include <chrono>
+#include <iostream>
+
+using namespace casadi;
+using namespace std;
+
+// Throughput of SX graph construction and destruction, served by SXNodePool
+
+// Build a graph with roughly 6*n*n_rep nodes
+SX build(const SX& x, casadi_int n_rep) {
+  const vector<SXElem>& xe = x.nonzeros();
+  casadi_int n = xe.size();
+  vector<SXElem> r;
+  SXElem s = 0;
+  for (casadi_int k=0; k<n_rep; ++k) {
+    for (casadi_int i=0; i+2<n; ++i) {
+      s = s + xe[i]*xe[i+1] - sin(xe[i+2])*(k+1.5);
+    }
+    r.push_back(s*s);
+  }
+  return r;
+}
+
+int main() {
+  SX x = SX::sym("x", 1000);
+  casadi_int n_rep = 200;
+  casadi_int N = 5;
+  for (casadi_int k=0; k<N; ++k) {
+    casadi_int n_node;
+    double t_build, t_free;
+    {
+      auto t0 = chrono::steady_clock::now();
+      SX r = build(x, n_rep);
+      t_build = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+      n_node = Function("f", {x}, {r}).n_nodes();
+      t0 = chrono::steady_clock::now();
+      r = SX();
+      t_free = chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+    }
+    cout << n_node << " nodes, build: " << n_node/t_build*1e-6 << " Mnodes/s, "
+         << "free: " << n_node/t_free*1e-6 << " Mnodes/s" << endl;
+  }
+  SXNodePool::Stats s = SXNodePool::stats();
+  cout << "chunks: " << s.n_chunk << " (" << s.chunk_bytes/1024 << " kB)" << endl;
+  return 0;
+}
@@ -3247,6 +3247,14 @@ DECL void casadi_shared(const std::vector< M >& ex,
                                const std::string& v_suffix="") {
   shared(ex, OUTPUT1, OUTPUT2, OUTPUT3, v_prefix, v_suffix);
 }
+
+DECL M casadi_cse(const M& e) {
+  return cse(e);
+}
+
+DECL std::vector< M > casadi_cse(const std::vector< M >& e) {
+  return cse(e);
+}
 DECL M casadi_blockcat(const std::vector< std::vector< M > > &v) {
  return blockcat(v);
 }
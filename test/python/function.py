@@ -626,6 +626,58 @@ class Functiontests(casadiTestCase):
     self.checkfunction_light(fun.map(4,"thread",2),fun.map(4),inputs=[hcat(X_[:4]),hcat(Y_[:4]),hcat(Z_[:4]),hcat(V_[:4])])
     self.checkfunction_light(fun.map(4,"thread",5),fun.map(4),inputs=[hcat(X_[:4]),hcat(Y_[:4]),hcat(Z_[:4]),hcat(V_[:4])])
 
+  def test_map_thread_pool(self):
+    x = SX.sym("x")
+    y = SX.sym("y",2)
+
+    fun = Function("f",[x,y],[sin(y*x).T,x**2])
+
+    n = 10
+    X_ = DM(np.random.random((1,n)))
+    Y_ = DM(np.random.random((2,n)))
+
+    for opts in [{}, {"max_workers":1}, {"max_workers":3}, {"max_workers":3,"chunk_size":4}, {"chunk_size":1}]:
+      F = fun.map(n,"thread",opts)
+      self.checkfunction_light(F,fun.map(n),inputs=[X_,Y_])
+      # Repeated evaluation reuses the pool
+      self.checkfunction_light(F,fun.map(n),inputs=[X_,Y_])
+
+    # Per-worker statistics
+    F = fun.map(n,"thread",{"max_workers":3})
+    F(X_,Y_)
+    stats = F.stats()
+    self.assertEqual(len(stats["worker_t_busy"]),3)
+    self.assertEqual(len(stats["worker_t_idle"]),3)
+    self.assertEqual(sum(stats["worker_n_task"]),n)
+
+  def test_map_batch(self):
+    x = SX.sym("x")
+    y = SX.sym("y",2)
+    z = SX.sym("z",Sparsity.upper(2))
+
+    fun = Function("f",[x,y,z],[sin(y*x).T,x**2+z[0,1]*y[1],fmax(z,x)])
+    xm = MX.sym("x")
+    ym = MX.sym("y",2)
+    zm = MX.sym("z",Sparsity.upper(2))
+    funmx = Function("f",[xm,ym,zm],fun(xm,ym,zm))
+
+    # Batched evaluation in blocks, including a partial last block
+    for n in [1, 7, 16, 37]:
+      X_ = DM(np.random.random((1,n)))
+      Y_ = DM(np.random.random((2,n)))
+      Z_ = repmat(DM(Sparsity.upper(2),np.random.random(3)),1,n)
+      self.checkfunction_light(fun.map(n),funmx.map(n),inputs=[X_,Y_,Z_])
+      F = Function.deserialize(fun.map(n).serialize())
+      self.checkfunction_light(F,funmx.map(n),inputs=[X_,Y_,Z_])
+
+    # Evaluation options of f are not bypassed: each point is dumped
+    f = Function("fbatch",[x,y,z],fun(x,y,z),{"dump_in":True,"dump_format":"txt"})
+    f.map(3)(X_[:,:3],Y_[:,:3],Z_[:,:3])
+    for i in range(3):
+      self.checkarray(DM.from_file("fbatch.%06d.in.i0.txt" % i),X_[:,i])
+    ft = Function("f",[x,y,z],fun(x,y,z),{"compiled_tape":True})
+    self.checkfunction_light(ft.map(7),funmx.map(7),inputs=[X_[:,:7],Y_[:,:7],Z_[:,:7]])
+
   @memory_heavy()
   def test_mapsum(self):
     x = SX.sym("x")
@@ -728,6 +780,30 @@ class Functiontests(casadiTestCase):
 
             self.check_serialize(F,inputs=inputs)
 
+  def test_mapsum_parallel_deterministic(self):
+    x = SX.sym("x")
+    p = SX.sym("p",2)
+
+    fun = Function("f",[x,p],[sin(x*p)/3,x*p[0]])
+
+    n = 100
+    np.random.seed(0)
+    X_ = DM(np.random.random((1,n)))
+    P_ = DM(np.random.random((2,1)))
+
+    Fref = fun.map("map","serial",n,[1],[0])
+    ref = Fref(X_,P_)
+    res = []
+    for parallelization, opts in [("thread",{"max_workers":1}),("thread",{"max_workers":3}),("thread",{}),("openmp",{})]:
+      F = fun.map("map",parallelization,n,[1],[0],opts)
+      self.checkfunction_light(F,Fref,inputs=[X_,P_])
+      res.append(F(X_,P_))
+      self.check_codegen(F,inputs=[X_,P_])
+    # Bitwise identical, regardless of the number of workers
+    for r in res[1:]:
+      for a,b in zip(r,res[0]):
+        self.assertTrue(np.all(np.array(a)==np.array(b)))
+
   def test_repmatnode(self):
     x = MX.sym("x",2)
 
@@ -1892,6 +1968,51 @@ class Functiontests(casadiTestCase):
     self.check_codegen(f,inputs=[np.random.random((3,3))])
     self.check_codegen(f,inputs=[np.random.random((3,3))], opts={"avoid_stack": True})
 
+  def test_codegen_split(self):
+    x = SX.sym("x",3,3)
+    f = Function('f',[x],[det(x),inv(x)])
+    np.random.seed(0)
+    x0 = np.random.random((3,3))
+    self.check_codegen(f,inputs=[x0], opts={"split_size": 10})
+    self.check_codegen(f,inputs=[x0], opts={"split_size": 10, "avoid_stack": True})
+
+  def test_codegen_loop_rolling(self):
+    x = SX.sym("x",2)
+    u = SX.sym("u")
+    F = Function('F',[x,u],[vertcat(x[0]+0.1*x[1],x[1]+0.1*(u-sin(x[0])))])
+    X = MX.sym("X",2)
+    U = MX.sym("U",1,30)
+    Y = F.mapaccum(30)(X,U)
+    G = Function('G',[X,U],[sin(Y)*sum1(X)+cos(X[0])*X[1]])
+    # Straight-line code only, straight-line code around rolled loops
+    for f in [F.expand(), G.expand(), F.mapaccum(30).expand(), F.map(30).expand()]:
+      inputs = [DM.rand(f.sparsity_in(i)) for i in range(f.n_in())]
+      self.check_codegen(f,inputs=inputs, opts={"loop_rolling": True})
+      self.check_codegen(f,inputs=inputs, opts={"loop_rolling": True, "split_size": 50})
+
+  def test_codegen_batch(self):
+    x = SX.sym("x",3)
+    u = SX.sym("u")
+    F = Function('F',[x,u],[vertcat(sin(x[0])*u+x[1],fmin(x[2],u)/(1+x[0]**2)),x[0]*u])
+    for n in [1, 16, 37]:
+      f = F.map(n)
+      inputs = [DM.rand(f.sparsity_in(i)) for i in range(f.n_in())]
+      self.check_codegen(f,inputs=inputs, opts={"with_batch": True})
+
+  @requiresPlugin(Importer,"shell")
+  def test_jit_split(self):
+    x = SX.sym("x",3,3)
+    f = Function('f',[x],[det(x),inv(x)])
+    x0 = np.random.random((3,3))
+    for avoid_stack in [False, True]:
+      fj = Function('f',[x],[det(x),inv(x)],{"jit":True,"compiler":"shell",
+        "jit_codegen_options":{"split_size":10,"split_files":3,"avoid_stack":avoid_stack}})
+      self.checkfunction_light(f,fj,inputs=[x0])
+      # The code generation options survive serialization
+      fs = Function.deserialize(fj.serialize())
+      self.assertEqual(fs.serialize(),fj.serialize())
+      self.checkfunction_light(f,fs,inputs=[x0])
+
 
   def test_serialize(self):
     for opts in [{"debug":True},{}]:
@@ -2072,6 +2193,120 @@ class Functiontests(casadiTestCase):
         self.assertTrue("[[-1e-07]," in out[0] or "[[-1e-007]," in out[0] )
         self.assertTrue("[[1e-07]," in out[0] or "[[1e-007]," in out[0] )
 
+  @requiresPlugin(Importer,"shell")
+  def test_jit_cache(self):
+    import tempfile
+    cache_dir = tempfile.mkdtemp()
+    x = MX.sym("x")
+    for c, hit in [(2,False),(2,True),(3,False)]:
+      f = Function('f',[x],[c*x**2])
+      f.generate('f_cache.c')
+      imp = Importer('f_cache.c','shell',{"cache_dir":cache_dir,"cache_max_size":1})
+      F = external('f',imp)
+      self.checkarray(F(3),c*9)
+      self.assertEqual(imp.stats()["cache_hit"],hit)
+    # Only the most recent entry survives the size bound
+    self.assertEqual(len(os.listdir(cache_dir)),1)
+
+  @requiresPlugin(Importer,"llvm")
+  def test_jit_llvm(self):
+    x = SX.sym("x",3)
+    y = SX.sym("y")
+    e = vertcat(sin(x[0])*y,x[1]/y,fmin(x[2],y),sign(x[0]),erfinv(0.3*x[1]),
+                if_else(x[0]>y,x[1],x[2]),atan2(x[0],y),fmod(x[1],y),x[2]**y)
+    f = Function('f',[x,y],[e,x[0]*y])
+    for opt_level in [0,2]:
+      fj = Function('f',[x,y],[e,x[0]*y],{"jit":True,"compiler":"llvm",
+                                        "jit_options":{"opt_level":opt_level}})
+      self.checkfunction_light(f,fj,inputs=[DM([0.7,-1.3,0.4]),1.7])
+    with self.assertInException("only supports SX"):
+      x = MX.sym("x")
+      Function('f',[x],[2*x],{"jit":True,"compiler":"llvm"})
+
+  @requiresPlugin(Importer,"shell")
+  def test_jit_tiered(self):
+    import time
+    x = SX.sym("x",3)
+    f = Function('f',[x],[sin(x)*x[0]+2])
+    fj = Function('f',[x],[sin(x)*x[0]+2],{"jit":True,"compiler":"shell",
+                                           "jit_tiered":True,"jit_threshold":3})
+    x0 = DM([0.7,-1.3,0.4])
+    self.assertEqual(fj.stats()["jit_tier"],"interpreted")
+
+    # Buffer created before tiering up
+    m = fj.checkout()
+    fj.release(m)
+    [buf,trigger] = fj.buffer()
+    a = np.array([0.7,-1.3,0.4])
+    b = np.zeros(3)
+    buf.set_arg(0, memoryview(a))
+    buf.set_res(0, memoryview(b))
+    trigger()
+    self.checkarray(b,f(x0))
+
+    for i in range(3):
+      self.checkarray(fj(x0),f(x0))
+    self.assertEqual(fj.stats()["jit_tier"],"interpreted")
+    t0 = time.time()
+    while fj.stats()["jit_tier"]!="compiled":
+      self.checkarray(fj(x0),f(x0))
+      self.assertTrue(fj.stats()["jit_tier"]!="failed")
+      self.assertTrue(time.time()-t0<60)
+      time.sleep(0.01)
+    self.checkarray(fj(x0),f(x0))
+    self.assertTrue(fj.stats()["n_call_interpreted"]>=4)
+
+    # The buffer keeps its interpreter memory and returns it
+    b[:] = 0
+    trigger()
+    self.assertEqual(buf.ret(), 0)
+    self.checkarray(b,f(x0))
+    del buf, trigger
+    self.assertEqual(fj.checkout(),m)
+
+    # Tiering survives serialization
+    fs = Function.deserialize(fj.serialize())
+    self.assertEqual(fs.stats()["jit_tier"],"interpreted")
+    self.checkarray(fs(x0),f(x0))
+
+  def test_checkout(self):
+    x = MX.sym("x")
+    f = Function('f',[x],[x**2])
+    m = [f.checkout() for i in range(40)]
+    self.assertEqual(len(set(m)),40)
+    f.release(m[3])
+    f.release(m[20])
+    self.assertEqual(f.checkout(),m[20])
+    self.assertEqual(f.checkout(),m[3])
+    self.assertTrue(f.checkout() not in m)
+    for e in m: f.release(e)
+    self.checkarray(f(3),9)
+
+  def test_call_reuse(self):
+    x = MX.sym("x",2)
+    y = MX.sym("y",Sparsity.lower(2))
+    f = Function('f',[x,y],[mtimes(y,x),sin(x)],["x","y"],["r","s"])
+    for X in [[1,2],[3,-1],[0.5,0.25]]:
+      Y = DM(Sparsity.lower(2),[X[0],2,X[1]])
+      ref = f(X,Y)
+
+      res = {"r": DM.zeros(2), "s": DM.zeros(2)}
+      for i in range(3):
+        f.call({"x": DM(X), "y": Y},res)
+        self.checkarray(res["r"],ref[0])
+        self.checkarray(res["s"],ref[1])
+
+      # Missing inputs default to zero
+      f.call({"x": DM(X)},res)
+      self.checkarray(res["r"],DM.zeros(2))
+      self.checkarray(res["s"],ref[1])
+
+      # Sparsity mismatch falls back to the generic path
+      res = {"r": DM.zeros(2)}
+      f.call({"x": DM(X), "y": densify(Y)},res)
+      self.checkarray(res["r"],ref[0])
+      self.checkarray(res["s"],ref[1])
+
   @requires_nlpsol("ipopt")
   @requiresPlugin(Importer,"shell")
   def test_inherit_jit_options(self):
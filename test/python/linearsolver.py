@@ -460,6 +460,162 @@ class LinearSolverTests(casadiTestCase):
 
         self.checkarray(mtimes(A_,f_out),b,digits=digits)
 
+  def test_ldl_supernodal(self):
+    numpy.random.seed(1)
+    # Dense blocks along a horizon, coupled by regularized constraints
+    N, nx, nu = 6, 3, 2
+    nz = nx+nu
+    H = diagcat(*[DM(numpy.random.rand(nz,nz)) for k in range(N)])
+    G = DM.zeros(0,N*nz)
+    for k in range(N-1):
+      Gk = DM.zeros(nx,N*nz)
+      Gk[:,k*nz:(k+1)*nz] = DM(numpy.random.rand(nx,nz))
+      Gk[:,(k+1)*nz:(k+1)*nz+nx] = -DM.eye(nx)
+      G = vertcat(G,Gk)
+    A = blockcat([[H+H.T+2*nz*DM.eye(N*nz),G.T],[G,-DM.eye(G.shape[0])]])
+    A = sparsify(A)
+    b = DM(numpy.random.rand(A.shape[0],3))
+
+    ref = solve(A,b,"ldl",{"supernodal":False})
+    self.checkarray(mtimes(A,ref),b)
+
+    self.checkarray(solve(A,b,"ldl",{"supernodal":True}),ref)
+
+    As = MX.sym("A",A.sparsity())
+    bs = MX.sym("b",b.sparsity())
+    f = Function("f",[As,bs],[solve(As,bs,"ldl",{"supernodal":True})])
+    self.checkarray(f(A,b),ref)
+    self.check_serialize(f,inputs=[A,b])
+    self.check_codegen(f,inputs=[A,b])
+
+  def test_max_workers(self):
+    numpy.random.seed(1)
+    # Independent dense blocks coupled by a border: a wide elimination tree
+    nb, bs, m = 6, 4, 2
+    B = [DM(numpy.random.rand(bs,bs)) for k in range(nb)]
+    D = diagcat(*[b+b.T+2*bs*DM.eye(bs) for b in B])
+    C = DM(numpy.random.rand(m,nb*bs))
+    A = blockcat([[D,C.T],[C,-DM.eye(m)]])
+    A = sparsify(A)
+    b = DM(numpy.random.rand(A.shape[0],3))
+
+    for Solver in ["ldl", "qr"]:
+      ref = solve(A,b,Solver,{"max_workers":1})
+      self.checkarray(mtimes(A,ref),b)
+      self.checkarray(solve(A,b,Solver,{"max_workers":4}),ref)
+      self.checkarray(solve(A,b[:,0],Solver,{"max_workers":4}),ref[:,0])
+
+      As = MX.sym("A",A.sparsity())
+      bs_ = MX.sym("b",b[:,0].sparsity())
+      f = Function("f",[As,bs_],[solve(As,bs_,Solver,{"max_workers":4}),
+                                  solve(As.T,bs_,Solver,{"max_workers":4})])
+      self.checkarray(f(A,b[:,0])[0],ref[:,0])
+      self.checkarray(mtimes(A.T,f(A,b[:,0])[1]),b[:,0])
+      self.check_serialize(f,inputs=[A,b[:,0]])
+      self.check_codegen(f,inputs=[A,b[:,0]])
+
+  def test_preordering(self):
+    # 2D grid Laplacian: nested dissection and amd give different orderings
+    m = 12
+    T = DM(numpy.diag([4.0]*m)-numpy.diag([1.0]*(m-1),1)-numpy.diag([1.0]*(m-1),-1))
+    A = sparsify(kron(DM.eye(m),T)-kron(DM(numpy.diag([1.0]*(m-1),1)+numpy.diag([1.0]*(m-1),-1)),DM.eye(m)))
+    b = DM(numpy.random.rand(A.shape[0],2))
+
+    p = A.sparsity().nd()
+    self.assertEqual(sorted(p),list(range(A.shape[0])))
+
+    for Solver in ["ldl", "qr"]:
+      ref = solve(A,b,Solver,{"ordering":"amd"})
+      self.checkarray(mtimes(A,ref),b)
+      for pre in ["nd", "none"]:
+        self.checkarray(solve(A,b,Solver,{"ordering":pre}),ref)
+      if Solver=="ldl":
+        for pre in [True, False]:
+          self.checkarray(solve(A,b,Solver,{"preordering":pre}),ref)
+
+      As = MX.sym("A",A.sparsity())
+      bs = MX.sym("b",b[:,0].sparsity())
+      f = Function("f",[As,bs],[solve(As,bs,Solver,{"ordering":"nd"})])
+      self.checkarray(f(A,b[:,0]),ref[:,0])
+      self.check_serialize(f,inputs=[A,b[:,0]])
+      self.check_codegen(f,inputs=[A,b[:,0]])
+
+  def test_preordering_components(self):
+    # Many connected components: diagonal and block-diagonal patterns
+    for sp in [Sparsity.diag(40000), diagcat(*[Sparsity.dense(3,3)]*20000),
+               diagcat(*[Sparsity.banded(100,1)]*200)]:
+      p = sp.nd()
+      self.assertEqual(sorted(p),list(range(sp.size1())))
+
+    A = DM(diagcat(*[Sparsity.banded(3,1)]*20000),1)+3*DM.eye(60000)
+    b = DM.ones(60000,1)
+    for Solver in ["ldl", "qr"]:
+      self.checkarray(mtimes(A,solve(A,b,Solver,{"ordering":"nd"})),b)
+
+  def test_nrhs_panel(self):
+    numpy.random.seed(1)
+    n = 12
+    R = DM(numpy.random.rand(n,n)*(numpy.random.rand(n,n)>0.7))
+    b = DM(numpy.random.rand(n,11))
+
+    for Solver, options in [("ldl",{"supernodal":False}), ("ldl",{"supernodal":True}),
+                            ("qr",{})]:
+      A = sparsify(R+R.T+2*n*DM.eye(n)) if Solver=="ldl" else sparsify(R+2*n*DM.eye(n))
+      F = Linsol("F",Solver,A.sparsity(),options)
+      # Panels of four right-hand-sides, followed by the remaining ones
+      for nrhs in [4, 7, 11]:
+        for tr in [False, True]:
+          As = MX.sym("A",A.sparsity())
+          bs = MX.sym("b",n,nrhs)
+          f = Function("f",[As,bs],[F.solve(As,bs,tr)])
+          x = f(A,b[:,:nrhs])
+          self.checkarray(mtimes(A.T if tr else A,x),b[:,:nrhs])
+          for k in range(nrhs):
+            self.checkarray(x[:,k],f(A,horzcat(b[:,k],DM.zeros(n,nrhs-1)))[:,0])
+          self.check_codegen(f,inputs=[A,b[:,:nrhs]])
+
+  def test_refactor_tol(self):
+    numpy.random.seed(1)
+    n = 12
+    R = DM(numpy.random.rand(n,n)*(numpy.random.rand(n,n)>0.7))
+    P = DM(numpy.random.rand(n,n))
+    b = DM(numpy.random.rand(n,2))
+
+    for Solver in ["ldl", "qr"]:
+      A = sparsify(R+R.T+2*n*DM.eye(n)) if Solver=="ldl" else sparsify(R+2*n*DM.eye(n))
+      dA = DM(A.sparsity(),1)*(P+P.T)
+      F = Linsol("F",Solver,A.sparsity(),{"refactor_tol":1e-2})
+      # Identical matrix: the factorization is reused as is
+      for k in range(2):
+        self.checkarray(mtimes(A,F.solve(A,b)),b)
+      # Small change: old factorization with iterative refinement
+      A2 = A+1e-5*dA
+      self.checkarray(mtimes(A2,F.solve(A2,b)),b,digits=12)
+      stats = F.stats()
+      self.assertEqual(stats["n_nfact"],1)
+      self.assertEqual(stats["n_reuse"],2)
+      self.assertTrue(stats["n_refine"]>0)
+      # Large change: refactorize
+      A3 = A+0.5*dA
+      self.checkarray(mtimes(A3,F.solve(A3,b)),b)
+      self.assertEqual(F.stats()["n_nfact"],2)
+
+      # Loose tolerance: the refinement stagnates, the matrix is refactorized
+      F = Linsol("F",Solver,A.sparsity(),{"refactor_tol":100.,"max_refine":1})
+      F.solve(A,b)
+      A4 = A+30*dA
+      self.checkarray(mtimes(A4,F.solve(A4,b)),b,digits=12)
+      stats = F.stats()
+      self.assertEqual(stats["n_reuse"],1)
+      self.assertEqual(stats["n_nfact"],2)
+
+      # Reuse disabled by default
+      F = Linsol("F",Solver,A.sparsity())
+      for k in range(2):
+        self.checkarray(mtimes(A,F.solve(A,b)),b)
+      self.assertEqual(F.stats()["n_nfact"],2)
+      self.assertEqual(F.stats()["n_reuse"],0)
+
   def test_dimmismatch(self):
     A = DM.eye(5)
     b = DM.ones((4,1))
@@ -2895,6 +2895,45 @@ class MXtests(casadiTestCase):
     i = DM([[0,3],[1,2]])
     self.checkarray(i,A[i].mapping())
 
+  def test_cse(self):
+    x = MX.sym("x",2)
+    y = MX.sym("y",2)
+    e = vertcat(sin(x*y)+mtimes(x.T,y), sin(y*x)*2, 3*(x+y), mtimes(x.T,y))
+    e2 = cse(e)
+    f = Function('f',[x,y],[e])
+    f2 = Function('f',[x,y],[e2])
+    self.checkfunction(f,f2,inputs=[vertcat(1.1,0.3),vertcat(1.3,-0.7)])
+    self.assertTrue(f2.n_instructions()<f.n_instructions())
+
+    f3 = Function('f',[x,y],[e],{"cse":True})
+    self.assertEqual(f3.n_instructions(),f2.n_instructions())
+    self.checkfunction(f,f3,inputs=[vertcat(1.1,0.3),vertcat(1.3,-0.7)])
+
+  def test_mtimes_dense(self):
+    np.random.seed(0)
+    # Sizes covering the unrolled, inner product and blocked kernels
+    for n,m,p in [(1,1,1),(2,3,2),(4,4,4),(5,3,7),(12,12,12),(13,5,9),(20,20,20),(35,33,31)]:
+      A = MX.sym("A",n,m)
+      B = MX.sym("B",m,p)
+      C = MX.sym("C",n,p)
+      f = Function('f',[A,B,C],[mtimes(A,B)+C])
+      A_ = np.random.random((n,m))
+      B_ = np.random.random((m,p))
+      C_ = np.random.random((n,p))
+      self.checkarray(f(A_,B_,C_),mtimes(DM(A_),DM(B_))+C_,digits=10)
+      self.checkfunction_light(f,f.expand(),inputs=[A_,B_,C_])
+      self.check_codegen(f,inputs=[A_,B_,C_])
+
+  def test_sparse_unroll(self):
+    A = MX.sym("A",DM(Sparsity.banded(6,1),1)[:,:4].sparsity())
+    B = MX.sym("B",DM(Sparsity.lower(4),1)[:,:3].sparsity())
+    C = MX.sym("C",Sparsity.diag(6,3)+Sparsity.triplet(6,3,[5,0],[0,2]))
+    f = Function('f',[A,B,C],[mac(A,B,C),A.T,project(A,DM(Sparsity.lower(6),1)[:,:4].sparsity()),
+                              mtimes(A.T,A),densify(C)])
+    inputs = [DM(x.sparsity(),np.random.random(x.nnz())) for x in [A,B,C]]
+    for sparse_unroll in [0,3,1000]:
+      self.check_codegen(f,inputs=inputs,opts={"sparse_unroll":sparse_unroll})
+
     
 if __name__ == '__main__':
     unittest.main()
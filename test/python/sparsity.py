@@ -490,6 +490,47 @@ class Sparsitytests(casadiTestCase):
     sp2 = hessian(H,x)[0].sparsity()
     self.assertTrue(sp==sp2)
 
+  def test_jacsparsity_lanes(self):
+    x = SX.sym("x",1000)
+    e = vertcat(*[sin(x[i])*x[(7*i)%1000] for i in range(0,1000,13)])
+
+    lanes = GlobalOptions.getSparsityLanes()
+    try:
+      for ad_weight_sp in [0, 1]:
+        ref = None
+        for n in [1, 3, 4, 8]:
+          GlobalOptions.setSparsityLanes(n)
+          f = Function('f',[x],[e],{"ad_weight_sp":ad_weight_sp})
+          sp = f.sparsity_jac(0, 0)
+          if ref is None: ref = sp
+          self.assertTrue(sp==ref)
+        self.assertTrue(ref==jacobian(e,x).sparsity())
+    finally:
+      GlobalOptions.setSparsityLanes(lanes)
+
+  def test_jacsparsity_threads(self):
+    x = SX.sym("x",2000)
+    e = vertcat(*[sin(x[i])*x[(7919*i)%2000]+x[(i+1)%2000] for i in range(2000)])
+
+    threads = GlobalOptions.getSparsityThreads()
+    hierarchical = GlobalOptions.getHierarchicalSparsity()
+    try:
+      for h in [True, False]:
+        GlobalOptions.setHierarchicalSparsity(h)
+        ref = None
+        for n in [1, 2, 4]:
+          GlobalOptions.setSparsityThreads(n)
+          f = Function('f',[x],[e])
+          sp = f.sparsity_jac(0, 0)
+          sps = f.sparsity_jac(0, 0, False, True)
+          if ref is None: ref = (sp, sps)
+          self.assertTrue(sp==ref[0])
+          self.assertTrue(sps==ref[1])
+        self.assertTrue(ref[0]==jacobian(e,x).sparsity())
+    finally:
+      GlobalOptions.setSparsityThreads(threads)
+      GlobalOptions.setHierarchicalSparsity(hierarchical)
+
 
   def test_rowcol(self):
     n = 3
@@ -555,6 +596,15 @@ class Sparsitytests(casadiTestCase):
       else:
         self.checkarray(DM(a,1),DM(b,1))
 
+  def test_cache(self):
+    # Equal patterns share the same internal object while alive
+    a = Sparsity.lower(7)
+    b = Sparsity.triplet(7,7,[i for j in range(7) for i in range(j,7)],[j for j in range(7) for i in range(j,7)])
+    self.assertEqual(a.__hash__(),b.__hash__())
+    del a, b
+    c = Sparsity.lower(7)
+    self.assertTrue(c==Sparsity.lower(7))
+
   def test_is_subset(self):
 
       pairs = [ (Sparsity.lower(3), Sparsity.dense(3,3)),
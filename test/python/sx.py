@@ -1426,6 +1426,39 @@ class SXtests(casadiTestCase):
     with self.assertInException("since variables [x] are free"):
       evalf(x)
 
+  def test_compiled_tape(self):
+    x = SX.sym("x",4)
+    p = SX.sym("p")
+    e = vertcat(x[0]*x[1]+p, x[2]*x[3]-x[0], sin(x[0])*p+x[3]*x[1],
+                fmax(x[1],p)/x[2], x[0]**2+2*x[3], 3.7*x[1]-x[2]*p)
+    for live_variables in [True, False]:
+      f = Function('f',[x,p],[e,x[0]*p],{"live_variables":live_variables})
+      f2 = Function('f',[x,p],[e,x[0]*p],{"live_variables":live_variables,"compiled_tape":True})
+      self.checkfunction(f,f2,inputs=[vertcat(1.1,1.3,-0.7,2.1),0.3])
+      self.checkfunction(f,Function.deserialize(f2.serialize()),inputs=[vertcat(1.1,1.3,-0.7,2.1),0.3])
+
+  def test_cse(self):
+    x = SX.sym("x")
+    y = SX.sym("y")
+    e = vertcat(sin(x*y)+cos(y+x), sin(y*x)*2, 3*(x+y), 3*(y+x))
+    e2 = cse(e)
+    f = Function('f',[x,y],[e])
+    f2 = Function('f',[x,y],[e2])
+    self.checkfunction(f,f2,inputs=[1.1,1.3])
+    self.assertTrue(f2.n_instructions()<f.n_instructions())
+
+    f3 = Function('f',[x,y],[e],{"cse":True})
+    self.assertEqual(f3.n_instructions(),f2.n_instructions())
+    self.checkfunction(f,f3,inputs=[1.1,1.3])
+
+  def test_constant_cache(self):
+    x = SX.sym("x")
+    self.assertTrue(is_equal(SX(3.7),SX(3.7)))
+    self.assertTrue(is_equal(SX(12),SX(12)))
+    f = Function('f',[x],[x*3.7+12*x+2*sin(x)-x**-1])
+    f2 = Function.deserialize(f.serialize())
+    self.checkfunction(f,f2,inputs=[1.1])
+
 
 
 